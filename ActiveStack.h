@@ -0,0 +1,72 @@
+#ifndef ACTIVE_STACK_H
+#define ACTIVE_STACK_H
+
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+// Base of the objects one of which is current on each thread, like the arena of the compilation
+// running there. activate() makes this one current on the calling thread until deactivate() there
+// ends its latest activation. Activations may end in any order, and those left end with the object.
+// Worker threads activate what they share with the thread that started them
+template <class Type>
+class ActiveStack
+{
+private:
+	static thread_local Type* top;
+	static thread_local vector<Type*> stack;
+	void drop(typename vector<Type*>::iterator from, typename vector<Type*>::iterator to)
+	{
+		stack.erase(from, to);
+		top = stack.empty() ? 0 : stack.back();
+	}
+protected:
+	~ActiveStack()
+	{
+		if (top) // nothing is active, the stack may already be gone at thread exit
+			drop(remove(stack.begin(), stack.end(), static_cast<Type*>(this)), stack.end());
+	}
+public:
+	void activate()
+	{
+		stack.push_back(static_cast<Type*>(this));
+		top = stack.back();
+	}
+	void deactivate()
+	{
+		typename vector<Type*>::reverse_iterator it = find(stack.rbegin(), stack.rend(), static_cast<Type*>(this));
+		if (it != stack.rend())
+			drop(it.base() - 1, it.base());
+	}
+	static Type* active() { return top; }
+	// For what a compilation must have made active, there being none to fall back on
+	static Type& running()
+	{
+		if (!top)
+			throw exception("No compilation is running on this thread");
+		return *top;
+	}
+};
+
+template <class Type>
+thread_local Type* ActiveStack<Type>::top = 0;
+
+template <class Type>
+thread_local vector<Type*> ActiveStack<Type>::stack;
+
+// Keeps object active on the calling thread while the scope lasts
+template <class Type>
+class ActiveScope
+{
+private:
+	Type& object;
+	ActiveScope(const ActiveScope&);
+	ActiveScope& operator = (const ActiveScope&);
+public:
+	ActiveScope(Type& o): object(o) { object.activate(); }
+	~ActiveScope() { object.deactivate(); }
+};
+
+#endif
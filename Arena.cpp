@@ -0,0 +1,48 @@
+#include "Arena.h"
+
+static const size_t firstBlockSize = 64 * 1024;
+static const size_t maxBlockSize = 1024 * 1024;
+
+Arena::Arena(): block(0), used(0), blockSize(firstBlockSize), allocations(0), bytes(0) {}
+
+Arena::~Arena()
+{
+	release();
+}
+
+// Blocks double in size up to maxBlockSize; large objects get a block of their own
+void* Arena::allocate(size_t size, size_t align)
+{
+	allocations++;
+	bytes += size;
+	if (size > maxBlockSize / 4)
+	{
+		blocks.push_back(new char[size]);
+		return blocks.back();
+	}
+	size_t start = (used + align - 1) & ~(align - 1);
+	if (!block || start + size > blockSize)
+	{
+		if (block && blockSize < maxBlockSize)
+			blockSize *= 2;
+		block = new char[blockSize];
+		blocks.push_back(block);
+		start = 0;
+	}
+	used = start + size;
+	return block + start;
+}
+
+// Destroys everything in reverse order of creation
+void Arena::release()
+{
+	for (size_t i = destructors.size(); i > 0; i--)
+		destructors[i - 1].destroy(destructors[i - 1].object);
+	destructors.clear();
+	for (size_t i = 0; i < blocks.size(); i++)
+		delete[] blocks[i];
+	blocks.clear();
+	block = 0;
+	used = 0;
+	blockSize = firstBlockSize;
+}
@@ -0,0 +1,61 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "ActiveStack.h"
+
+using namespace std;
+
+// Bump allocator for the AST, statements and symbols of one compilation. Objects are never
+// freed one by one: the destructors run and the blocks go back in one shot when the arena dies.
+// The Parser owns one and makes it active on its thread, so create<T>() finds it from any node
+class Arena : public ActiveStack<Arena>
+{
+private:
+	typedef struct {
+		void (*destroy)(void* object);
+		void* object;
+	} DestructorT;
+	vector<char*> blocks;
+	char* block; // the one being filled
+	size_t used;
+	size_t blockSize;
+	vector<DestructorT> destructors;
+	long long allocations;
+	size_t bytes;
+	template <class Type>
+	static void destroy(void* object) { ((Type*) object)->~Type(); }
+	Arena(const Arena&);
+	Arena& operator = (const Arena&);
+public:
+	Arena();
+	~Arena();
+	void* allocate(size_t size, size_t align);
+	template <class Type, class... Args>
+	Type* create(Args&&... args)
+	{
+		Type* object = new (allocate(sizeof(Type), alignof(Type))) Type(forward<Args>(args)...);
+		if (!is_trivially_destructible<Type>::value)
+		{
+			DestructorT destructor = { &destroy<Type>, object };
+			destructors.push_back(destructor);
+		}
+		return object;
+	}
+	void release();
+	long long allocationsCount() const { return allocations; }
+	size_t allocatedBytes() const { return bytes; }
+	static Arena& current() { return running(); }
+};
+
+// Object of the compilation running on this thread
+template <class Type, class... Args>
+Type* create(Args&&... args)
+{
+	return Arena::current().create<Type>(forward<Args>(args)...);
+}
+
+#endif
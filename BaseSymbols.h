@@ -4,18 +4,45 @@
 #include <string>
 #include <map>
 #include "Commands.h"
+#include "Interner.h"
+#include "Arena.h"
 
 using namespace std;
 
 class TypeSym;
+class IRBuilder;
+
+static const int frameLinkSize = 8; // saved ebp and return address, between ebp and the arguments
+
+// Next multiple of align, a power of two
+inline int alignUp(int size, int align)
+{
+	return (size + align - 1) & ~(align - 1);
+}
+
+// Types come last, so TypeSym::classof is a single comparison
+typedef enum {
+	symVar,
+	symScalar,
+	symPointer,
+	symArray,
+	symConst,
+	symFunc,
+	symStruct,
+	symAlias,
+} SymbolKindT;
 
 class Symbol
 {
 public:
+	SymbolKindT kind;
 	int offset;
 	string name;
-	Symbol(const string& n): name(n), offset(0) {}	
+	NameIdT id;
+	Symbol(const string& n): name(n), id(Interner::current().intern(n)), offset(0) {}	
 	virtual int byteSize() const { return 0; }
+	virtual int alignment() const { return 1; }
+	int stackSize() const { return alignUp(byteSize(), 4); } // pushed and passed in whole dwords
 	virtual TypeSym* getType() { return 0; }
 	virtual void print(int deep) const;
 	virtual void generate(AsmCode& code) const {}
@@ -25,6 +52,7 @@ class TypeSym : public Symbol
 {
 public:
 	TypeSym(const string& n): Symbol(n) {}
+	static bool classof(const Symbol* sym) { return sym->kind >= symScalar; }
 	virtual string typeName() const;
 	bool operator == (const string& o) const;
 	virtual TypeSym* nextType() const { return 0; }
@@ -40,27 +68,32 @@ public:
 
 class ScalarSym : public TypeSym
 {
+private:
+	int size;
 public:
-	ScalarSym(const string& n): TypeSym(n) {}
+	ScalarSym(const string& n, int bytes): TypeSym(n), size(bytes) { kind = symScalar; }
+	static bool classof(const Symbol* sym) { return sym->kind == symScalar; }
 	bool canConvertTo(TypeSym* to);
 	bool isLvalue() const { return true; }
 	bool isModifiableLvalue() const { return true; }
-	int byteSize() const;
+	int byteSize() const { return size; }
+	int alignment() const { return size ? size : 1; }
 };
 
 class PointerSym : public TypeSym 
 {
 public:	
 	TypeSym* type;
-	PointerSym(TypeSym* t): TypeSym(""), type(t) {}
+	PointerSym(TypeSym* t): TypeSym(""), type(t) { kind = symPointer; }
+	static bool classof(const Symbol* sym) { return sym->kind == symPointer; }
 	string typeName() const;
 	TypeSym* nextType() const { return type; }
 	void setNextType(TypeSym* t) { type = t; }
 	bool isModifiableLvalue() const { return true; }
 	bool isLvalue() const { return true; }
 	bool canConvertTo(TypeSym* to);
-	bool operator == (TypeSym* o) const;
 	int byteSize() const { return 4; }
+	int alignment() const { return 4; }
 };
 
 class ArraySym : public TypeSym
@@ -71,29 +104,34 @@ private:
 public:
 	friend class Parser;
 	friend class VarSym;
-	friend class BinaryOpNode;
-	ArraySym(TypeSym* t, int s): TypeSym(""), type(t), size(s) {}
+	friend class TypeChecker;
+	friend class TypeTable;
+	ArraySym(TypeSym* t, int s): TypeSym(""), type(t), size(s) { kind = symArray; }
+	static bool classof(const Symbol* sym) { return sym->kind == symArray; }
 	string typeName() const;
 	TypeSym* nextType() const { return type; }
 	void setNextType(TypeSym* t) { type = t; }
 	bool isLvalue() const { return true; }
-	bool operator == (TypeSym* t) const;
 	bool canConvertTo(TypeSym* t);
 	void generate(AsmCode& code) const;
 	int byteSize() const { return type->byteSize() * size; }
-	PointerSym* convertToPointer() const { return new PointerSym(type); }
+	int alignment() const { return type->alignment(); }
+	PointerSym* convertToPointer() const;
 };
 
 class VarSym : public Symbol
 {
 public:	
 	bool global;
+	bool addressTaken; // by a unary &, so the variable cannot live in a virtual register
 	TypeSym* type;
-	VarSym(const string& n, TypeSym* t): Symbol(n), type(t), global(true) {} 
+	VarSym(const string& n, TypeSym* t): Symbol(n), type(t), global(true), addressTaken(false) { kind = symVar; }
+	static bool classof(const Symbol* sym) { return sym->kind == symVar; }
 	void print(int deep) const;
 	TypeSym* getType() { return type; }
 	void generate(AsmCode& code) const;
 	int byteSize() const { return type->byteSize(); }
+	int alignment() const { return type->alignment(); }
 };
 
 class ConstTypeSym : public TypeSym
@@ -101,65 +139,84 @@ class ConstTypeSym : public TypeSym
 private:
 	TypeSym* type;
 public:
-	ConstTypeSym(TypeSym* t): TypeSym(""), type(t) {}
+	friend class TypeTable;
+	ConstTypeSym(TypeSym* t): TypeSym(""), type(t) { kind = symConst; }
+	static bool classof(const Symbol* sym) { return sym->kind == symConst; }
 	string typeName() const;
 	bool isStruct() { return type->isStruct(); }
 	int byteSize() const { return type->byteSize(); }
+	int alignment() const { return type->alignment(); }
 };
 
 class SymInterface
 {
 public:
-	virtual Symbol* find(const string& name) const = 0;
+	virtual Symbol* find(NameIdT name) const = 0;
 	virtual void add(Symbol* s) = 0;
 	virtual void print(int deep) const = 0;
 };
 
+// Lays its symbols out as they are added, so its size, alignment and their offsets are read,
+// not computed. The subclasses place them in a frame, an argument list or a struct
 class SymTable : public SymInterface
 {
 protected:
-	vector<string> names;
 	vector<Symbol*> symbols;
-	map<string, int> index;
+	map<NameIdT, int> index;
+	int bytes;
+	int align;
+	int position(NameIdT name, int count) const;
+	virtual void place(Symbol* s) {}
 public:		
-	int offset;
+	int offset; // where the next symbol goes
 	int shift;
 	friend class FuncSym;
 	friend class FuncCallNode;
-	SymTable(int tableShift = 0): names(0), symbols(0), offset(0), shift(tableShift) {}
-	Symbol* find(const string& name) const;
-	virtual void add(Symbol* s);
+	SymTable(int tableShift = 0): symbols(0), bytes(0), align(1), offset(0), shift(tableShift) {}
+	Symbol* find(NameIdT name) const { return find(name, symbols.size()); }
+	Symbol* find(NameIdT name, int count) const;
+	Symbol* find(const string& name) const { return find(Interner::current().intern(name)); }
+	void add(Symbol* s);
+	void truncate(int count);
 	void print(int deep = 0) const;
+	void printLayout(int deep = 0) const;
 	void generateGlobals(AsmCode& code) const;
-	void generateCode(AsmCode& code) const;
-	void calculateSize();
+	vector<VarSym*> functions() const;
+	bool exists(NameIdT name) { return find(name) != 0; }
 	bool exists(const string& name);
 	bool operator == (SymTable* o) const;
 	bool operator != (SymTable* o) const { return !(*this == o); }
 	int size() const;
-	int byteSize() const;
+	int byteSize() const { return bytes; }
+	int alignment() const { return align; }
 	Symbol* operator[] (int idx) { return symbols[idx]; }
 };
 
+// Variables of a block, downwards from shift bytes below ebp
 class SymTableForLocals : public SymTable
 {
+protected:
+	void place(Symbol* s);
 public:
 	SymTableForLocals(int off = 0): SymTable(off) {}
-	void add(Symbol* s);
 };
 
+// Parameters in dword slots upwards from the first argument
 class SymTableForParams : public SymTable
 {
+protected:
+	void place(Symbol* s);
 public:
-	SymTableForParams(): SymTable() { offset = 4; }
-	void add(Symbol* s);
+	SymTableForParams(): SymTable() {}
 };
 
 class SymTableForFields : public SymTable
 {
+protected:
+	void place(Symbol* s);
 public:
 	SymTableForFields(): SymTable() {}
-	void add(Symbol* s);
+	void pack();
 };
 
 class Statement 
@@ -167,6 +224,7 @@ class Statement
 public:
 	virtual void print(int deep) const = 0;
 	virtual void generate(AsmCode& code) const = 0;
+	virtual void lower(IRBuilder& builder) const = 0;
 };
 
 class Block : public Statement
@@ -181,6 +239,7 @@ public:
 	void AddStatement(Statement* stmt) { statements.push_back(stmt); }
 	void print(int deep) const; 
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 	int size() const { return statements.size(); }
 };
 
@@ -194,8 +253,12 @@ private:
 public:
 	friend class Parser;
 	friend class FuncCallNode;
+	friend class TypeChecker;
 	friend class ReturnStatement;
-	FuncSym(TypeSym* v): TypeSym(""), val(v), params(0), body(0), endLabel(0) {} 
+	friend class TypeTable;
+	friend class IRBuilder;
+	FuncSym(TypeSym* v): TypeSym(""), val(v), params(0), body(0), endLabel(0) { kind = symFunc; }
+	static bool classof(const Symbol* sym) { return sym->kind == symFunc; }
 	string typeName() const;
 	void print(int deep) const;	
 	void setNextType(TypeSym* t) { val = t; }	
@@ -215,12 +278,13 @@ private:
 public:
 	friend class Parser;
 	friend class SymTable;
-	StructSym(const string& name, SymTable* f): TypeSym(name), fields(f) {}
+	StructSym(const string& name, SymTable* f): TypeSym(name), fields(f) { kind = symStruct; }
+	static bool classof(const Symbol* sym) { return sym->kind == symStruct; }
 	void print(int deep) const;
 	bool isStruct() { return true; }	
 	bool canConvertTo(TypeSym* to);
 	int byteSize() const { return fields ? fields->byteSize() : 0; }
-	int getShiftForBase() const;
+	int alignment() const { return fields ? fields->alignment() : 1; }
 	string typeName() const;
 	TypeSym* nextType() const { return (*fields)[0]->getType(); }
 };
@@ -229,11 +293,13 @@ class AliasSym : public TypeSym
 {
 public:
 	TypeSym* type;
-	AliasSym(const string& name, TypeSym* t): TypeSym(name), type(t) {}
+	AliasSym(const string& name, TypeSym* t): TypeSym(name), type(t) { kind = symAlias; }
+	static bool classof(const Symbol* sym) { return sym->kind == symAlias; }
 	void print(int deep) const;
 	string typeName() const;
 	TypeSym* getType() { return type; }
 	int byteSize() const { return type->byteSize(); }
+	int alignment() const { return type->alignment(); }
 };
 
 extern ScalarSym* intType;
@@ -241,8 +307,11 @@ extern ScalarSym* floatType;
 extern ScalarSym* charType;
 extern ScalarSym* voidType;
 extern PointerSym* stringType;
+extern SymTable* predefinedTypes;
 extern map<TypeSym*, int> typePriority;
 extern map<OperationsT, TypeSym*> operationTypeOperands;
 extern map<OperationsT, TypeSym*> operationReturningType;
+int priorityOf(TypeSym* type);
+TypeSym* typeOfOperation(const map<OperationsT, TypeSym*>& types, OperationsT op);
 
 #endif
\ No newline at end of file
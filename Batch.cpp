@@ -0,0 +1,137 @@
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include "Batch.h"
+#include "Scanner.h"
+#include "Parser.h"
+
+using namespace std;
+
+BatchCompiler::BatchCompiler(const vector<string>& inputs, const string& includePath): files(inputs),
+	results(inputs.size()), includePath(includePath), names(&Interner::shared()), steals(0), threadsCount(0), seconds(0)
+{
+}
+
+// One file name per line
+void BatchCompiler::readResponseFile(const string& path, vector<string>& inputs)
+{
+	ifstream in(path);
+	if (!in)
+		throw exception("Cannot open file");
+	string line;
+	while (getline(in, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty())
+			inputs.push_back(line);
+	}
+}
+
+void BatchCompiler::run(int threads)
+{
+	threadsCount = max(1, min(threads, (int) files.size()));
+	queues.clear();
+	for (int i = 0; i < threadsCount; i++)
+		queues.emplace_back();
+	for (int i = 0; i < files.size(); i++)
+		queues[(long long) i * threadsCount / files.size()].files.push_back(i);
+	steals = 0;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<thread> pool;
+	for (int i = 0; i < threadsCount; i++)
+		pool.push_back(thread(&BatchCompiler::work, this, i));
+	for (int i = 0; i < threadsCount; i++)
+		pool[i].join();
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// No files are added once the workers run, so all queues empty means the batch is done
+bool BatchCompiler::take(int worker, int& file)
+{
+	{
+		BatchQueueT& own = queues[worker];
+		lock_guard<mutex> guard(own.lock);
+		if (!own.files.empty())
+		{
+			file = own.files.back();
+			own.files.pop_back();
+			return true;
+		}
+	}
+	for (int i = 1; i < threadsCount; i++)
+	{
+		BatchQueueT& victim = queues[(worker + i) % threadsCount];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.files.empty())
+		{
+			file = victim.files.front();
+			victim.files.pop_front();
+			steals++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void BatchCompiler::work(int worker)
+{
+	ActiveScope<Interner> batchNames(names);
+	ActiveScope<SourceMap> batchSources(sources);
+	int file;
+	while (take(worker, file))
+		compile(file);
+}
+
+void BatchCompiler::compile(int file)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	try {
+		Preprocessor preprocessor(&headers);
+		if (!includePath.empty())
+			preprocessor.addIncludePath(includePath);
+		Scanner scanner(files[file].c_str(), preprocessor);
+		CodeGenerator generator(files[file] + ".asm");
+		Parser parser(scanner, generator);
+		parser.parse();
+		parser.generateCode();
+		parser.optimize();
+		parser.fflush();
+	} catch (exception& e) {
+		results[file].error = e.what();
+	}
+	results[file].seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Errors in input order, then the throughput and the nearest-rank percentiles of the per-file times
+void BatchCompiler::report(ostream& out) const
+{
+	int failed = 0;
+	vector<double> latencies;
+	for (int i = 0; i < files.size(); i++)
+	{
+		if (!results[i].error.empty())
+		{
+			out << files[i] << ": " << results[i].error << endl;
+			failed++;
+		}
+		latencies.push_back(results[i].seconds * 1000);
+	}
+	sort(latencies.begin(), latencies.end());
+	out << "files: " << files.size() << ", failed: " << failed << ", " << threadsCount << " threads, "
+		<< steals << " steals" << endl;
+	out << "time: " << seconds << " s, throughput: " << (seconds > 0 ? files.size() / seconds : 0) << " files/s" << endl;
+	if (latencies.empty())
+		return;
+	const double percentiles[] = { 50, 90, 99 };
+	out << "latency:";
+	for (int i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+	{
+		int rank = max((int) ceil(percentiles[i] / 100 * latencies.size()), 1);
+		out << " p" << percentiles[i] << " " << latencies[rank - 1] << " ms,";
+	}
+	out << " max " << latencies.back() << " ms" << endl;
+}
@@ -0,0 +1,54 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include "Preprocessor.h"
+#include "Interner.h"
+#include "SourceMap.h"
+
+using namespace std;
+
+typedef struct {
+	string error; // empty if the file compiled
+	double seconds;
+} BatchResultT;
+
+// Files left to a worker: it takes them from the back, the others steal from the front
+typedef struct {
+	deque<int> files;
+	mutex lock;
+} BatchQueueT;
+
+// Compiles many translation units in one process. Every worker starts with a run of the files
+// and steals from the others once its own are done. Besides the predefined types and the lexer
+// tables, the compilations share only what the run owns: the names, the source texts and the
+// headers; all of it goes with the run. Each file is optimized and its asm written next to it
+class BatchCompiler
+{
+private:
+	vector<string> files;
+	vector<BatchResultT> results;
+	deque<BatchQueueT> queues;
+	string includePath;
+	Interner names;
+	SourceMap sources;
+	HeaderCache headers;
+	atomic<int> steals;
+	int threadsCount;
+	double seconds;
+	bool take(int worker, int& file);
+	void work(int worker);
+	void compile(int file);
+public:
+	BatchCompiler(const vector<string>& inputs, const string& includePath = "");
+	static void readResponseFile(const string& path, vector<string>& inputs);
+	void run(int threads);
+	void report(ostream& out) const;
+};
+
+#endif
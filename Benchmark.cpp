@@ -0,0 +1,490 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "Benchmark.h"
+#include "Scanner.h"
+#include "Parser.h"
+#include "Preprocessor.h"
+
+using namespace std;
+
+static const char* corpusWords[] = { "int", "char", "float", "while", "for", "if", "else", "return", "struct",
+	"counter", "index", "buffer_size", "node", "next_node", "value", "result", "tmp", "i", "j", "printf",
+	"sizeof", "typedef", "const", "length", "offset", "table_entry", "hash_value", "do", "break", "continue" };
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void generateIdentifierCorpus(ostream& out, long long bytes)
+{
+	const int wordsCount = sizeof(corpusWords) / sizeof(corpusWords[0]);
+	srand(1);
+	long long written = 0;
+	while (written < bytes)
+	{
+		string line;
+		int words = 4 + rand() % 8;
+		for (int i = 0; i < words; i++)
+		{
+			line += corpusWords[rand() % wordsCount];
+			if (rand() % 3 == 0)
+				line += to_string(rand() % 100);
+			line += i + 1 < words ? (rand() % 2 ? " " : ", ") : ";\n";
+		}
+		out << line;
+		written += line.length();
+	}
+}
+
+static string commentLine()
+{
+	string line(rand() % 2 ? "i = i + 1; /* " : "// ");
+	int words = 6 + rand() % 10;
+	for (int i = 0; i < words; i++)
+		line += corpusWords[rand() % (sizeof(corpusWords) / sizeof(corpusWords[0]))] + string(" ");
+	return line + (line[0] == 'i' ? "*/\n" : "\n");
+}
+
+static string numberLine()
+{
+	string line;
+	int numbers = 4 + rand() % 8;
+	for (int i = 0; i < numbers; i++)
+	{
+		int kind = rand() % 3;
+		if (kind == 0)
+			line += to_string(rand() % 100000);
+		else if (kind == 1)
+			line += to_string(rand() % 1000) + "." + to_string(rand() % 1000);
+		else
+			line += to_string(rand() % 10) + "." + to_string(rand() % 100) + "e" + (rand() % 2 ? "-" : "+") + to_string(rand() % 30);
+		line += i + 1 < numbers ? ", " : ";\n";
+	}
+	return line;
+}
+
+static string stringLine()
+{
+	const char* pieces[] = { "hello", " world", "\\n", "%d", "\\t", " value = ", "\\\\", "buffer", " " };
+	string line("s = \"");
+	int count = 4 + rand() % 12;
+	for (int i = 0; i < count; i++)
+		line += pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+	return line + "\";\n";
+}
+
+// One entry of a message table: a char and a string full of escapes of every kind
+static string stringTableLine()
+{
+	const char* pieces[] = { "name", "\\x41\\x42", "\\101", "\\0", "\\\"quoted\\\"", "\\r\\n", "\\t", "%s = %d", "\\\\", 
+		"\\x7f", " ", "\\'" };
+	const char* chars[] = { "'a'", "'\\n'", "'\\x41'", "'\\0'", "'\\''", "'\\177'" };
+	string line("\t{ ");
+	line += chars[rand() % (sizeof(chars) / sizeof(chars[0]))];
+	line += ", \"";
+	int count = 2 + rand() % 8;
+	for (int i = 0; i < count; i++)
+		line += pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+	return line + "\" },\n";
+}
+
+void generateCorpus(ostream& out, CorpusKindT kind, long long bytes)
+{
+	if (kind == IDENTIFIER_CORPUS)
+	{
+		generateIdentifierCorpus(out, bytes);
+		return;
+	}
+	srand(1);
+	long long written = 0;
+	while (written < bytes)
+	{
+		string line = kind == COMMENT_CORPUS ? commentLine() : kind == NUMBER_CORPUS ? numberLine() : 
+			kind == STRING_CORPUS ? stringLine() : stringTableLine();
+		out << line;
+		written += line.length();
+	}
+}
+
+// Lookup the scanner used before the perfect hash: a fresh keyword vector and a linear scan per identifier
+static int linearKeywordIndex(const string& word)
+{
+	char a[][10] = { "break", "char", "const", "continue", "do", "else", "float", "for",
+		"if", "int", "return", "struct", "sizeof", "typedef", "void",  "while" };
+	vector<string> keywords;
+	for (int i = 0; i < 16; i++)
+		keywords.push_back(string(a[i]));
+	int keyword = -1;
+	for (int i = 0; i < keywords.size(); i++)
+		if (keywords[i] == word)
+			keyword = i;
+	return keyword;
+}
+
+void benchKeywordLookup(long long bytes)
+{
+	string filename("bench_identifiers.c");
+	{
+		ofstream out(filename.c_str());
+		generateIdentifierCorpus(out, bytes);
+	}
+	vector<string> words;
+	long long tokens = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Scanner scanner(filename.c_str());
+	while (scanner.hasNext())
+	{
+		Token* token = scanner.next();
+		tokens++;
+		if (*token == IDENTIFIER || *token == KEYWORD)
+			words.push_back(token->text());
+	}
+	double lexTime = secondsSince(start);
+
+	long long hits = 0;
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < words.size(); i++)
+		hits += linearKeywordIndex(words[i]) != -1;
+	double linearTime = secondsSince(start);
+
+	long long hashHits = 0;
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < words.size(); i++)
+	{
+		int word = Scanner::reservedWordIndex(words[i]);
+		hashHits += word != -1 && word <= WHILE;
+	}
+	double hashTime = secondsSince(start);
+	remove(filename.c_str());
+
+	cout << "identifier-heavy corpus: " << bytes << " bytes, " << tokens << " tokens, "
+		<< words.size() << " words, " << hits << " keywords" << endl;
+	cout << "scanner: " << (long long) (tokens / lexTime) << " tokens/sec" << endl;
+	cout << "linear keyword lookup: " << linearTime * 1e9 / words.size() << " ns/word" << endl;
+	cout << "perfect hash lookup: " << hashTime * 1e9 / words.size() << " ns/word" << endl;
+	if (hits != hashHits)
+		cout << "keyword counts differ: " << hits << " vs " << hashHits << endl;
+}
+
+// Decoding the scanner used before the escape table: a fresh map for every escape
+static char mapEscapingChar(const string& key)
+{
+	map<string, char> table;
+	table["\\n"] = '\n';
+	table["\\t"] = '\t';
+	table["\\\\"] = '\\';
+	table["\'"] = '\'';
+	return table[key];
+}
+
+static string mapStrVal(const string& val)
+{
+	string res;
+	for (int i = 1; i < val.length() - 1; i++)
+	{
+		char c = val[i];
+		if (val[i] == '\\')
+		{
+			string key;
+			key.push_back(val[i]);
+			key.push_back(val[i + 1]);
+			c = mapEscapingChar(key);
+			i++;
+		}
+		res.push_back(c);
+	}
+	return res;
+}
+
+void benchLiterals(long long bytes)
+{
+	string filename("bench_literals.c");
+	{
+		ofstream out(filename.c_str());
+		generateCorpus(out, STRING_TABLE_CORPUS, bytes);
+	}
+	vector<string> literals;
+	long long tokens = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Scanner scanner(filename.c_str());
+	while (scanner.hasNext())
+	{
+		Token* token = scanner.next();
+		tokens++;
+		if (*token == STRING)
+			literals.push_back(token->text());
+	}
+	double lexTime = secondsSince(start);
+	remove(filename.c_str());
+
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < literals.size(); i++)
+		mapStrVal(literals[i]);
+	double mapTime = secondsSince(start);
+
+	vector<char> buffer;
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < literals.size(); i++)
+	{
+		buffer.resize(literals[i].length());
+		decodeLiteral(literals[i].data() + 1, literals[i].data() + literals[i].length() - 1, &buffer[0]);
+	}
+	double tableTime = secondsSince(start);
+
+	LiteralPool pool;
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < literals.size(); i++)
+		pool.add(literals[i].data() + 1, literals[i].data() + literals[i].length() - 1);
+	double poolTime = secondsSince(start);
+
+	cout << "string table corpus: " << bytes << " bytes, " << tokens << " tokens, " << literals.size() << " string literals" << endl;
+	cout << "scanner: " << (long long) (bytes / lexTime) << " bytes/sec, " << (long long) (tokens / lexTime) << " tokens/sec" << endl;
+	cout << "map per escape: " << mapTime * 1e9 / literals.size() << " ns/literal" << endl;
+	cout << "escape table: " << tableTime * 1e9 / literals.size() << " ns/literal" << endl;
+	cout << "escape table into the literal pool: " << poolTime * 1e9 / literals.size() << " ns/literal" << endl;
+}
+
+// Lexes one corpus of every kind and prints the timings as JSON; tokens are
+// dropped as they go, so the input size is only bounded by memory for the text
+void benchLexer(long long bytes)
+{
+	const char* kindNames[] = { "identifiers", "comments", "numbers", "strings", "string_table" };
+	string filename("bench_lexer.c");
+	cout << "{\n\t\"benchmark\": \"lexer\",\n\t\"bytes\": " << bytes << ",\n\t\"corpora\": [\n";
+	for (int kind = 0; kind < CORPUS_KINDS_COUNT; kind++)
+	{
+		{
+			ofstream out(filename.c_str());
+			generateCorpus(out, (CorpusKindT) kind, bytes);
+		}
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		Scanner scanner(filename.c_str());
+		double loadTime = secondsSince(start);
+		long long tokens = 0;
+		start = chrono::steady_clock::now();
+		while (scanner.hasNext())
+		{
+			scanner.next();
+			if (++tokens % 65536 == 0)
+				scanner.dropTokens();
+		}
+		double lexTime = secondsSince(start);
+		long long size = scanner.sourceSize();
+		remove(filename.c_str());
+
+		char line[500];
+		sprintf(line, "\t\t{ \"corpus\": \"%s\", \"bytes\": %lld, \"tokens\": %lld, \"load_seconds\": %.6f, "
+			"\"lex_seconds\": %.6f, \"tokens_per_sec\": %.0f, \"bytes_per_sec\": %.0f }%s\n", kindNames[kind], size, tokens, 
+			loadTime, lexTime, tokens / lexTime, size / lexTime, kind + 1 < CORPUS_KINDS_COUNT ? "," : "");
+		cout << line;
+	}
+	cout << "\t]\n}" << endl;
+}
+
+static double timePreprocess(const vector<string>& units, bool cached, long long& tokens)
+{
+	HeaderCache headers;
+	tokens = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < units.size(); i++)
+	{
+		Preprocessor preprocessor(cached ? &headers : 0);
+		Scanner scanner(units[i].c_str(), preprocessor);
+		while (scanner.hasNext())
+		{
+			scanner.next();
+			tokens++;
+		}
+	}
+	return secondsSince(start);
+}
+
+// Translation units that share one guarded header, preprocessed with the header
+// cache shared by all of them and with a cache each
+void benchPreprocessor(long long units)
+{
+	string header("bench_shared.h");
+	{
+		ofstream out(header.c_str());
+		out << "#ifndef BENCH_SHARED_H\n#define BENCH_SHARED_H\n#define SQUARE(x) ((x) * (x))\n";
+		generateIdentifierCorpus(out, 256 * 1024);
+		out << "#endif\n";
+	}
+	vector<string> names;
+	for (int i = 0; i < units; i++)
+	{
+		names.push_back("bench_unit" + to_string(i) + ".c");
+		ofstream out(names.back().c_str());
+		out << "#include \"" << header << "\"\n#include \"" << header << "\"\n";
+		out << "int unit" << i << "() { return SQUARE(" << i << "); }\n";
+	}
+	long long tokens, cachedTokens;
+	double uncachedTime = timePreprocess(names, false, tokens);
+	double cachedTime = timePreprocess(names, true, cachedTokens);
+	for (int i = 0; i < names.size(); i++)
+		remove(names[i].c_str());
+	remove(header.c_str());
+
+	cout << "translation units: " << units << ", " << tokens << " tokens after preprocessing" << endl;
+	cout << "header re-read for every unit: " << uncachedTime << " s" << endl;
+	cout << "header cached: " << cachedTime << " s" << endl;
+	cout << "speedup: " << uncachedTime / cachedTime << "x" << endl;
+	if (tokens != cachedTokens)
+		cout << "token counts differ: " << tokens << " vs " << cachedTokens << endl;
+}
+
+// Many short functions over shared globals, the shape parseParallel splits
+static void generateFunctionsCorpus(ostream& out, long long functions)
+{
+	const char* statements[] = { "\talpha = beta + gamma * (pt.x - alpha) / 3;\n", "\tdelta = delta * 2.5 + pt.y;\n",
+		"\tif (alpha > beta) { beta = beta + 1; } else { alpha = alpha - 1; }\n", 
+		"\twhile (counter < 10) { counter = counter + 1; }\n", "\tprintf(\"%d\\n\", alpha);\n" };
+	const int statementsCount = sizeof(statements) / sizeof(statements[0]);
+	out << "struct P { int x; int y; };\nint alpha; int beta; int gamma; int counter; float delta; struct P pt;\n";
+	srand(1);
+	for (long long i = 0; i < functions; i++)
+	{
+		out << "int f" << i << "(int a) {\n\tint local; local = a;\n";
+		for (int j = 0; j < 20; j++)
+			out << statements[rand() % statementsCount];
+		out << "\treturn local;\n}\n";
+	}
+	out << "int main() {\n\treturn f0(1);\n}\n";
+}
+
+static double timeFunctionsParse(const string& filename, int threads)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	Preprocessor preprocessor;
+	Scanner scanner(filename.c_str(), preprocessor);
+	CodeGenerator generator(filename + ".asm");
+	Parser parser(scanner, generator);
+	if (threads)
+		parser.parseParallel(threads);
+	else
+		parser.parse();
+	return secondsSince(start);
+}
+
+void benchParallelParse(long long functions)
+{
+	string filename("bench_functions.c");
+	{
+		ofstream out(filename.c_str());
+		generateFunctionsCorpus(out, functions);
+	}
+	int threads = max(thread::hardware_concurrency(), 1u);
+	double serialTime = timeFunctionsParse(filename, 0), parallelTime = timeFunctionsParse(filename, threads);
+	for (int i = 0; i < 2; i++)
+	{
+		serialTime = min(serialTime, timeFunctionsParse(filename, 0));
+		parallelTime = min(parallelTime, timeFunctionsParse(filename, threads));
+	}
+	remove(filename.c_str());
+
+	cout << "functions: " << functions << ", " << threads << " threads" << endl;
+	cout << "serial parse: " << serialTime << " s" << endl;
+	cout << "bodies in parallel: " << parallelTime << " s" << endl;
+	cout << "speedup: " << serialTime / parallelTime << "x" << endl;
+}
+
+// Parses first and times generating and optimizing the code only
+static double timeFunctionsCodegen(const string& filename, int threads)
+{
+	Preprocessor preprocessor;
+	Scanner scanner(filename.c_str(), preprocessor);
+	CodeGenerator generator(filename + ".asm");
+	Parser parser(scanner, generator);
+	parser.parse();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	parser.generateCode(threads);
+	parser.optimize(threads);
+	return secondsSince(start);
+}
+
+void benchParallelCodegen(long long functions)
+{
+	string filename("bench_functions.c");
+	{
+		ofstream out(filename.c_str());
+		generateFunctionsCorpus(out, functions);
+	}
+	int threads = max(thread::hardware_concurrency(), 1u);
+	double serialTime = timeFunctionsCodegen(filename, 1), parallelTime = timeFunctionsCodegen(filename, threads);
+	for (int i = 0; i < 2; i++)
+	{
+		serialTime = min(serialTime, timeFunctionsCodegen(filename, 1));
+		parallelTime = min(parallelTime, timeFunctionsCodegen(filename, threads));
+	}
+	remove(filename.c_str());
+
+	cout << "functions: " << functions << ", " << threads << " threads" << endl;
+	cout << "serial code generation: " << serialTime << " s" << endl;
+	cout << "functions in parallel: " << parallelTime << " s" << endl;
+	cout << "speedup: " << serialTime / parallelTime << "x" << endl;
+}
+
+// Loops over arrays of a struct of fields ints, copying elements by assignment, as an argument and
+// as a return value
+static void generateStructCopyCorpus(ostream& out, int fields)
+{
+	out << "struct S {";
+	for (int i = 0; i < fields; i++)
+		out << " int f" << i << ";";
+	out << " };\nstruct S src[64], dst[64];\n"
+		"struct S pass(struct S s) {\n\treturn s;\n}\n"
+		"int main() {\n\tint i; int n;\n"
+		"\tfor (n = 0; n < 1000; ++n)\n\t\tfor (i = 0; i < 64; ++i) {\n"
+		"\t\t\tdst[i] = src[i];\n\t\t\tsrc[63 - i] = pass(dst[i]);\n\t\t}\n"
+		"\treturn 0;\n}\n";
+}
+
+static int countInstructions(const string& asmFile)
+{
+	ifstream in(asmFile.c_str());
+	string line;
+	int count = 0;
+	while (getline(in, line))
+		if (!line.empty() && line[0] == '\t')
+			count++;
+	return count;
+}
+
+// Code size and generation time of the copy loops as the struct grows up to fields ints:
+// the copies stay a few instructions however many dwords they move
+void benchStructCopy(long long fields)
+{
+	for (long long size = 1; size <= fields; size *= 2)
+	{
+		string filename("bench_struct_copy" + to_string(size) + ".c");
+		{
+			ofstream out(filename.c_str());
+			generateStructCopyCorpus(out, size);
+		}
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		{
+			Preprocessor preprocessor;
+			Scanner scanner(filename.c_str(), preprocessor);
+			CodeGenerator generator(filename + ".asm");
+			Parser parser(scanner, generator);
+			parser.parse();
+			parser.generateCode();
+			parser.optimize();
+			parser.fflush();
+		}
+		double time = secondsSince(start);
+		cout << "struct of " << size * 4 << " bytes: " << countInstructions(filename + ".asm") << " instructions, " 
+			<< time << " s" << endl;
+		remove(filename.c_str());
+		remove((filename + ".asm").c_str());
+	}
+}
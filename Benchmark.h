@@ -0,0 +1,28 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+typedef enum {
+	IDENTIFIER_CORPUS,
+	COMMENT_CORPUS,
+	NUMBER_CORPUS,
+	STRING_CORPUS,
+	STRING_TABLE_CORPUS,
+	CORPUS_KINDS_COUNT
+} CorpusKindT;
+
+void generateIdentifierCorpus(ostream& out, long long bytes);
+void generateCorpus(ostream& out, CorpusKindT kind, long long bytes);
+void benchLexer(long long bytes);
+void benchKeywordLookup(long long bytes);
+void benchLiterals(long long bytes);
+void benchPreprocessor(long long units);
+void benchParallelParse(long long functions);
+void benchParallelCodegen(long long functions);
+void benchStructCopy(long long fields);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CASTING_H
+#define CASTING_H
+
+#include <cassert>
+
+// Checked casts over the kind tag a class hierarchy keeps in its base; To::classof(base)
+// decides membership, so none of them need RTTI. isa and dyn_cast accept null
+
+template <class To, class From>
+inline bool isa(const From* value)
+{
+	return value && To::classof(value);
+}
+
+template <class To, class From>
+inline To* cast(From* value)
+{
+	assert(isa<To>(value));
+	return static_cast<To*>(value);
+}
+
+template <class To, class From>
+inline const To* cast(const From* value)
+{
+	assert(isa<To>(value));
+	return static_cast<const To*>(value);
+}
+
+template <class To, class From>
+inline To* dyn_cast(From* value)
+{
+	return isa<To>(value) ? static_cast<To*>(value) : nullptr;
+}
+
+template <class To, class From>
+inline const To* dyn_cast(const From* value)
+{
+	return isa<To>(value) ? static_cast<const To*>(value) : nullptr;
+}
+
+#endif
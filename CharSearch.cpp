@@ -0,0 +1,133 @@
+#include "CharSearch.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CHAR_SEARCH_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define TARGET_AVX2
+static int firstSetBit(unsigned mask)
+{
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return (int) idx;
+}
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+static int firstSetBit(unsigned mask)
+{
+	return __builtin_ctz(mask);
+}
+#endif
+
+const char* findStopCharScalar(const char* begin, const char* end, const char* stops)
+{
+	char a = stops[0], b = stops[1], c = stops[2], d = stops[3];
+	for (; begin < end; begin++)
+	{
+		char ch = *begin;
+		if (ch == a || ch == b || ch == c || ch == d)
+			return begin;
+	}
+	return end;
+}
+
+#ifdef CHAR_SEARCH_X86
+
+const char* findStopCharSSE2(const char* begin, const char* end, const char* stops)
+{
+	__m128i a = _mm_set1_epi8(stops[0]), b = _mm_set1_epi8(stops[1]);
+	__m128i c = _mm_set1_epi8(stops[2]), d = _mm_set1_epi8(stops[3]);
+	for (; end - begin >= 16; begin += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*) begin);
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, a), _mm_cmpeq_epi8(chunk, b)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, c), _mm_cmpeq_epi8(chunk, d)));
+		unsigned mask = (unsigned) _mm_movemask_epi8(hits);
+		if (mask)
+			return begin + firstSetBit(mask);
+	}
+	return findStopCharScalar(begin, end, stops);
+}
+
+TARGET_AVX2 const char* findStopCharAVX2(const char* begin, const char* end, const char* stops)
+{
+	__m256i a = _mm256_set1_epi8(stops[0]), b = _mm256_set1_epi8(stops[1]);
+	__m256i c = _mm256_set1_epi8(stops[2]), d = _mm256_set1_epi8(stops[3]);
+	for (; end - begin >= 32; begin += 32)
+	{
+		__m256i chunk = _mm256_loadu_si256((const __m256i*) begin);
+		__m256i hits = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, a), _mm256_cmpeq_epi8(chunk, b)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, c), _mm256_cmpeq_epi8(chunk, d)));
+		unsigned mask = (unsigned) _mm256_movemask_epi8(hits);
+		if (mask)
+			return begin + firstSetBit(mask);
+	}
+	return findStopCharSSE2(begin, end, stops);
+}
+
+#ifdef _MSC_VER
+static bool cpuHasSSE2()
+{
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+}
+
+static bool cpuHasAVX2()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5));
+}
+#else
+static bool cpuHasSSE2()
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool cpuHasAVX2()
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+FindStopCharT selectFindStopChar()
+{
+	if (cpuHasAVX2())
+		return findStopCharAVX2;
+	if (cpuHasSSE2())
+		return findStopCharSSE2;
+	return findStopCharScalar;
+}
+
+#else
+
+const char* findStopCharSSE2(const char* begin, const char* end, const char* stops)
+{
+	return findStopCharScalar(begin, end, stops);
+}
+
+const char* findStopCharAVX2(const char* begin, const char* end, const char* stops)
+{
+	return findStopCharScalar(begin, end, stops);
+}
+
+FindStopCharT selectFindStopChar()
+{
+	return findStopCharScalar;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef CHAR_SEARCH_H
+#define CHAR_SEARCH_H
+
+// Search for the first of four stop characters; returns end if there is none.
+// Unused slots of stops repeat one of the real characters.
+typedef const char* (*FindStopCharT)(const char* begin, const char* end, const char* stops);
+
+const char* findStopCharScalar(const char* begin, const char* end, const char* stops);
+const char* findStopCharSSE2(const char* begin, const char* end, const char* stops);
+const char* findStopCharAVX2(const char* begin, const char* end, const char* stops);
+FindStopCharT selectFindStopChar();
+
+#endif
@@ -7,25 +7,42 @@ using namespace std;
 
 bool AsmArgRegister::operator==(AsmArg* o) const
 {
-	AsmArgRegister* tmp = dynamic_cast<AsmArgRegister*>(o);
-	return tmp && tmp->reg == reg && !dynamic_cast<AsmArgIndirect*>(o);
+	AsmArgRegister* tmp = dyn_cast<AsmArgRegister>(o);
+	return tmp && tmp->reg == reg && !isa<AsmArgIndirect>(o);
+}
+
+// al, bl, cl and ax are parts of the registers they are named after
+bool AsmArgRegister::usesRegister(AsmRegistersT r) const
+{
+	switch (reg)
+	{
+	case AL:
+	case AX:
+		return r == reg || r == EAX;
+	case BL:
+		return r == reg || r == EBX;
+	case CL:
+		return r == reg || r == ECX;
+	default:
+		return r == reg;
+	}
 }
 
 bool AsmArgIndirect::operator==(AsmArg* o) const
 {
-	AsmArgIndirect* tmp = dynamic_cast<AsmArgIndirect*>(o);
-	return tmp && tmp->reg == reg && tmp->offset == offset;
+	AsmArgIndirect* tmp = dyn_cast<AsmArgIndirect>(o);
+	return tmp && tmp->reg == reg && tmp->offset == offset && tmp->size == size;
 }
 
 bool AsmArgMemory::operator==(AsmArg* o) const
 {
-	AsmArgMemory* tmp = dynamic_cast<AsmArgMemory*>(o);
+	AsmArgMemory* tmp = dyn_cast<AsmArgMemory>(o);
 	return tmp && tmp->varName == varName;
 }
 
 bool AsmArgLabel::operator==(AsmArg* o) const
 {
-	AsmArgLabel* tmp = dynamic_cast<AsmArgLabel*>(o);
+	AsmArgLabel* tmp = dyn_cast<AsmArgLabel>(o);
 	return tmp && tmp->name == name;
 }
 
@@ -49,9 +66,9 @@ AsmArgDup* makeArgDup(int count)
 	return new AsmArgDup(count);
 }
 
-AsmArgIndirect* makeIndirectArg(AsmRegistersT reg, int offset)
+AsmArgIndirect* makeIndirectArg(AsmRegistersT reg, int offset, int size)
 {
-	return new AsmArgIndirect(reg, offset);
+	return new AsmArgIndirect(reg, offset, size);
 }
 
 AsmArgLabel* makeLabel(const string& name)
@@ -103,6 +120,10 @@ string AsmArgRegister::regName() const
 		return "bl";
 	case AX:
 		return "ax";
+	case ESI:
+		return "esi";
+	case EDI:
+		return "edi";
 	default:
 		throw exception("Illegal register value");
 	}
@@ -186,6 +207,14 @@ string AsmCmd::cmdName() const
 		return "setl";
 	case cmdSETLE:
 		return "setle";
+	case cmdSETA:
+		return "seta";
+	case cmdSETB:
+		return "setb";
+	case cmdSETAE:
+		return "setae";
+	case cmdSETBE:
+		return "setbe";
 	case cmdFADDP:
 		return "faddp";
 	case cmdFDIVP:
@@ -212,6 +241,10 @@ string AsmCmd::cmdName() const
 		return "fnstsw";
 	case cmdSAHF:
 		return "sahf";
+	case cmdREPMOVSD:
+		return "rep movsd";
+	case cmdMOVSX:
+		return "movsx";
 	default:
 		throw exception("Illegal command");
 	}
@@ -222,17 +255,29 @@ string AsmCmd::generate() const
 	return cmdName();
 }
 
+// rep movsd copies ecx dwords from [esi] to [edi]
+bool AsmCmd::operateWith(AsmArg* arg) const
+{
+	return opCode == cmdREPMOVSD && (arg->isMemoryLocation() || arg->usesRegister(ECX) 
+		|| arg->usesRegister(ESI) || arg->usesRegister(EDI));
+}
+
+bool AsmCmd::usesRegister(AsmRegistersT reg) const
+{
+	return opCode == cmdREPMOVSD && (reg == ECX || reg == ESI || reg == EDI);
+}
+
 string AsmCmd1::generate() const
 {
 	return cmdName() + 
-		(dynamic_cast<AsmArgImmediate*>(arg) && opCode != cmdRET ? " dword ptr " : " ") 
+		(isa<AsmArgImmediate>(arg) && opCode != cmdRET ? " dword ptr " : " ") 
 		+ arg->generate();
 }
 
 bool AsmCmd1::operateWith(AsmArg* a) const
 {
-	AsmArgIndirect* ind = dynamic_cast<AsmArgIndirect*>(a);
-	AsmArgRegister* reg = dynamic_cast<AsmArgRegister*>(arg);
+	AsmArgIndirect* ind = dyn_cast<AsmArgIndirect>(a);
+	AsmArgRegister* reg = dyn_cast<AsmArgRegister>(arg);
 	if (ind && reg)
 		return ind->usesRegister(reg->reg);
 	else
@@ -259,9 +304,9 @@ bool AsmCmd2::changeStack() const
 
 bool AsmCmd2::operateWith(AsmArg* a) const
 {
-	AsmArgIndirect* ind = dynamic_cast<AsmArgIndirect*>(a);
-	AsmArgRegister* reg1 = dynamic_cast<AsmArgRegister*>(arg1);
-	AsmArgRegister* reg2 = dynamic_cast<AsmArgRegister*>(arg2);
+	AsmArgIndirect* ind = dyn_cast<AsmArgIndirect>(a);
+	AsmArgRegister* reg1 = dyn_cast<AsmArgRegister>(arg1);
+	AsmArgRegister* reg2 = dyn_cast<AsmArgRegister>(arg2);
 	if (ind && (reg1 || reg2))
 		return (reg1 ? ind->usesRegister(reg1->reg) : 0) || (reg2 ? ind->usesRegister(reg2->reg) : 0);
 	else
@@ -334,7 +379,7 @@ AsmCode& AsmCode::add(OperationsT func, AsmArgMemory* format, AsmArg* arg)
 void AsmCode::fflush(ofstream& out) const
 {
 	for (int i = 0; i < commands.size(); i++)
-		out << (dynamic_cast<AsmLabel*>(commands[i]) ? "" : "\t") << commands[i]->generate() << endl;
+		out << (isa<AsmLabel>(commands[i]) ? "" : "\t") << commands[i]->generate() << endl;
 }
 
 void AsmCode::deleteRange(int l, int r) 
@@ -368,6 +413,8 @@ void CodeGenerator::generate()
 		   ".data\n";
 	data.fflush(out);
 	out << ".code\n";
+	for (int i = 0; i < functions.size(); i++)
+		functions[i].fflush(out);
 	code.fflush(out);
 	out << "end start";
 }
\ No newline at end of file
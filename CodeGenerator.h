@@ -12,6 +12,7 @@ class CodeGenerator
 private:
 	string filename;
 	AsmCode data;
+	vector<AsmCode> functions; // one per defined function, written in declaration order
 	AsmCode code;
 public:
 	friend class Parser;
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include "Tokens.h"
+#include "Casting.h"
 
 using namespace std;
 
@@ -45,6 +46,10 @@ typedef enum {
 	cmdSETLE,
 	cmdSETE,
 	cmdSETNE,
+	cmdSETA,
+	cmdSETB,
+	cmdSETAE,
+	cmdSETBE,
 	cmdFDIVP,
 	cmdFADDP,
 	cmdFMULP,
@@ -58,6 +63,8 @@ typedef enum {
 	cmdFCOMPP,
 	cmdFNSTSW,
 	cmdSAHF,
+	cmdREPMOVSD,
+	cmdMOVSX,
 } AsmCommandsT;
 
 typedef enum {
@@ -71,11 +78,25 @@ typedef enum {
 	AL,
 	BL,
 	AX,
+	ESI,
+	EDI,
 } AsmRegistersT;
 
+typedef enum {
+	argImmediate,
+	argString,
+	argRegister,
+	argIndirect,
+	argMemory,
+	argLabel,
+	argDup,
+	argFloat,
+} AsmArgKindT;
+
 class AsmArg
 {
 public:
+	AsmArgKindT kind;
 	virtual string generate() const = 0;
 	virtual bool operator == (int val) const { return false; }
 	virtual bool operator == (AsmRegistersT reg) const { return false; }
@@ -94,7 +115,8 @@ class AsmArgImmediate : public AsmArg
 {
 public:
 	int value;
-	AsmArgImmediate(int v): value(v) {}
+	AsmArgImmediate(int v): value(v) { kind = argImmediate; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argImmediate; }
 	string generate() const { return to_string(value); }
 	bool operator == (int val) const { return value == val; }
 	bool isImmediate() const { return true; }
@@ -105,7 +127,8 @@ class AsmArgString : public AsmArg
 private:
 	string value;
 public:
-	AsmArgString(const string& str): value(str) {}
+	AsmArgString(const string& str): value(str) { kind = argString; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argString; }
 	string generate() const { return value; }
 };
 
@@ -115,21 +138,25 @@ protected:
 	string regName() const;
 public:
 	AsmRegistersT reg;
-	AsmArgRegister(AsmRegistersT r): reg(r) {}
+	AsmArgRegister(AsmRegistersT r): reg(r) { kind = argRegister; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argRegister || arg->kind == argIndirect; }
 	string generate() const { return regName(); }
 	bool operator == (AsmArg* o) const;
-	bool usesRegister(AsmRegistersT r) const { return reg == r; }
+	bool usesRegister(AsmRegistersT r) const;
 	virtual bool operator == (AsmRegistersT r) const { return r == reg; }
 	bool isRegister() const { return true; }
 };
 
+// A dword at reg + offset, or a byte when size is 1
 class AsmArgIndirect : public AsmArgRegister
 {
 private:
 	int offset;
+	int size;
 public:
-	AsmArgIndirect(AsmRegistersT r, int shift = 0): AsmArgRegister(r), offset(shift) {}
-	string generate() const { return "dword ptr [" + regName() + " + " + to_string(offset) + "]"; }
+	AsmArgIndirect(AsmRegistersT r, int shift = 0, int bytes = 4): AsmArgRegister(r), offset(shift), size(bytes) { kind = argIndirect; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argIndirect; }
+	string generate() const { return (size == 1 ? "byte" : "dword") + string(" ptr [") + regName() + " + " + to_string(offset) + "]"; }
 	bool operator == (AsmArg* o) const;
 	bool operator == (AsmRegistersT r) const { return false; }
 	bool usesRegister(AsmRegistersT r) const { return r == reg; }
@@ -139,11 +166,12 @@ public:
 class AsmArgMemory : public AsmArg
 {
 private:
-	string varName;
+	NameIdT varName;
 	bool lvalue;
 public:
-	AsmArgMemory(const string& name, bool lv = false): varName(name), lvalue(lv) {}
-	string generate() const { return (lvalue ? "offset " : "") + varName; }
+	AsmArgMemory(const string& name, bool lv = false): varName(Interner::current().intern(name)), lvalue(lv) { kind = argMemory; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argMemory; }
+	string generate() const { return (lvalue ? "offset " : "") + Interner::current().spelling(varName); }
 	bool operator == (AsmArg* o) const;
 	bool isMemoryLocation() const { return true; }
 	bool isOffset() const { return lvalue; }
@@ -153,11 +181,13 @@ public:
 class AsmArgLabel : public AsmArg
 {
 private:
-	string name;
+	NameIdT name;
 public:
 	friend class AsmLabel;
-	AsmArgLabel(const string& n): name(n) {}
-	string generate() const { return name; }
+	AsmArgLabel(const string& n): name(Interner::current().intern(n)) { kind = argLabel; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argLabel; }
+	string generate() const { return Interner::current().spelling(name); }
+	NameIdT labelName() const { return name; }
 	bool operator == (AsmArg* o) const;
 };
 
@@ -166,7 +196,8 @@ class AsmArgDup : public AsmArg
 private:
 	int count;
 public:
-	AsmArgDup(int c): count(c) {}
+	AsmArgDup(int c): count(c) { kind = argDup; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argDup; }
 	string generate() const { return to_string(count) + " dup(0)"; }
 };
 
@@ -175,13 +206,23 @@ class AsmArgFloat : public AsmArg
 private:
 	float val;
 public:
-	AsmArgFloat(float v): val(v) {}
+	AsmArgFloat(float v): val(v) { kind = argFloat; }
+	static bool classof(const AsmArg* arg) { return arg->kind == argFloat; }
 	string generate() const { return to_string(val); }
 };
 
+typedef enum {
+	insLabel,
+	insCmd,
+	insCmd1,
+	insCmd2,
+	insIOCmd,
+} AsmInstructionKindT;
+
 class AsmInstruction 
 {
 public:
+	AsmInstructionKindT kind;
 	virtual string generate() const = 0;
 	virtual bool changeStack() const { return false; }
 	virtual bool operateWith(AsmArg* arg) const { return false; }
@@ -195,8 +236,9 @@ class AsmLabel : public AsmInstruction
 {
 public:
 	AsmArgLabel* label;
-	AsmLabel(AsmArgLabel* l): label(l) {}
-	bool operator == (string s) { return label->name == s; }
+	AsmLabel(AsmArgLabel* l): label(l) { kind = insLabel; }
+	static bool classof(const AsmInstruction* ins) { return ins->kind == insLabel; }
+	bool operator == (NameIdT name) { return label->name == name; }
 	virtual string generate() const { return label->generate() + ":"; }
 };
 
@@ -206,9 +248,12 @@ protected:
 	AsmCommandsT opCode;
 	string cmdName() const;
 public:
-	AsmCmd() {}
-	AsmCmd(AsmCommandsT opcode): opCode(opcode) {}
+	AsmCmd() { kind = insCmd; }
+	AsmCmd(AsmCommandsT opcode): opCode(opcode) { kind = insCmd; }
+	static bool classof(const AsmInstruction* ins) { return ins->kind >= insCmd; }
 	virtual string generate() const;
+	bool operateWith(AsmArg* arg) const;
+	bool usesRegister(AsmRegistersT reg) const;
 	bool operator == (AsmCommandsT cmd) { return opCode == cmd; }
 };
 
@@ -217,7 +262,8 @@ class AsmCmd1 : public AsmCmd
 private:
 	AsmArg *arg;
 public:
-	AsmCmd1(AsmCommandsT opcode, AsmArg* a): AsmCmd(opcode), arg(a) {}
+	AsmCmd1(AsmCommandsT opcode, AsmArg* a): AsmCmd(opcode), arg(a) { kind = insCmd1; }
+	static bool classof(const AsmInstruction* ins) { return ins->kind == insCmd1; }
 	string generate() const;
 	AsmArg* argument() { return arg; }
 	bool changeStack() const { return opCode == cmdPUSH || opCode == cmdPOP || opCode == cmdRET || opCode == cmdCALL; }
@@ -231,7 +277,8 @@ class AsmCmd2 : public AsmCmd
 private:
 	AsmArg *arg1, *arg2;
 public:
-	AsmCmd2(AsmCommandsT opcode, AsmArg* a1, AsmArg* a2): AsmCmd(opcode), arg1(a1), arg2(a2) {}
+	AsmCmd2(AsmCommandsT opcode, AsmArg* a1, AsmArg* a2): AsmCmd(opcode), arg1(a1), arg2(a2) { kind = insCmd2; }
+	static bool classof(const AsmInstruction* ins) { return ins->kind == insCmd2; }
 	string generate() const;
 	AsmArg* firstArg() { return arg1; }
 	AsmArg* secondArg() { return arg2; }
@@ -247,7 +294,8 @@ private:
 	AsmArgMemory* format;
 	AsmArg* arg;
 public:
-	AsmIOCmd(OperationsT m, AsmArgMemory* f, AsmArg* a): AsmCmd(cmdINVOKE), mode(m), format(f), arg(a) {}
+	AsmIOCmd(OperationsT m, AsmArgMemory* f, AsmArg* a): AsmCmd(cmdINVOKE), mode(m), format(f), arg(a) { kind = insIOCmd; }
+	static bool classof(const AsmInstruction* ins) { return ins->kind == insIOCmd; }
 	string generate() const;
 	bool changeStack() const { return true; }
 };
@@ -256,7 +304,7 @@ AsmArgRegister* makeArg(AsmRegistersT reg);
 AsmArgImmediate* makeArg(int val);
 AsmArgDup* makeArgDup(int count);
 AsmArgMemory* makeArgMemory(const string& varName, bool lv = false);
-AsmArgIndirect* makeIndirectArg(AsmRegistersT reg, int offset = 0);
+AsmArgIndirect* makeIndirectArg(AsmRegistersT reg, int offset = 0, int size = 4);
 AsmArgLabel* makeLabel(const string& name);
 AsmArgString* makeString(const string& name);
 AsmArgFloat* makeFloat(float val);
@@ -265,9 +313,15 @@ class AsmCode
 {
 private:
 	vector<AsmInstruction*> commands;
+	string labelsPrefix;
+	int labelsCount;
 public:
-	AsmCode(): commands(0) {}
+	AsmCode(): commands(0), labelsCount(0) {}
 	int size() const { return commands.size(); }
+	// Keys of the labels a function's statements make: unique in the program and the same
+	// however and wherever the functions are generated
+	void startLabels(const string& prefix) { labelsPrefix = prefix; labelsCount = 0; }
+	string labelKey() { return labelsPrefix + to_string(labelsCount++); }
 	void fflush(ofstream& out) const;
 	void replace(int index, AsmCmd* cmd) { delete commands[index]; commands[index] = cmd; }
 	void deleteRange(int l, int r);
@@ -1,9 +1,22 @@
 #include "Exceptions.h"
+#include "SourceMap.h"
 
 using namespace std;
 
+CompilerException::CompilerException(const char* msg, const Token* at): exception(msg), line(0), col(0), position(0), origin(0)
+{
+	if (!at)
+		return;
+	text = SourceMap::current().textOf(at->source);
+	position = at->source + at->length;
+	origin = at->offset;
+}
+
 string CompilerException::message() const
 {
+	int line = this->line, col = this->col;
+	if (text)
+		SourceMap::current().locate(position, origin, line, col);
 	string msg;
 	msg += exception::what();
 	msg += "\n";
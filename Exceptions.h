@@ -3,17 +3,25 @@
 
 #include <exception>
 #include <string>
+#include <memory>
+#include "Tokens.h"
 
 using namespace std;
 
+// Thrown at a token, the exception keeps the token's text alive and
+// resolves its line and column only when the message is built
 class CompilerException : public exception
 {
 protected:
 	int line;
 	int col;
+	shared_ptr<string> text;
+	const char* position;
+	unsigned origin;
 	string message() const;
 public:	
-	CompilerException(const char* msg, int l, int c): exception(msg), line(l), col(c) {}
+	CompilerException(const char* msg, int l, int c): exception(msg), line(l), col(c), position(0), origin(0) {}
+	CompilerException(const char* msg, const Token* at);
 	const char* what() const;
 };
 
@@ -21,12 +29,19 @@ class ScannerException : public CompilerException
 {
 public:
 	ScannerException(const char* msg, int l, int c): CompilerException(msg, l, c) {}
+	ScannerException(const char* msg, const Token* at): CompilerException(msg, at) {}
+};
+
+class PreprocessorException : public CompilerException
+{
+public:
+	PreprocessorException(const char* msg, const Token* at): CompilerException(msg, at) {}
 };
 
 class ParserException : public CompilerException
 {
 public:
-	ParserException(const char* msg, int l, int c): CompilerException(msg, l, c) {}
+	ParserException(const char* msg, const Token* at): CompilerException(msg, at) {}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,655 @@
+#include <set>
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include "IR.h"
+
+using namespace std;
+
+const char* irOpName(IROpcodeT op)
+{
+	static const char* names[] = { "undef", "const", "fconst", "param", "addr", "frame", "load", "store", "copy",
+		"add", "sub", "mul", "div", "mod", "and", "or", "xor", "shl", "shr",
+		"eq", "ne", "lt", "le", "gt", "ge", "neg", "not",
+		"fadd", "fsub", "fmul", "fdiv", "feq", "fne", "flt", "fle", "fgt", "fge", "fneg", "itof", "ftoi",
+		"call", "printf", "scanf", "phi", "jmp", "br", "ret" };
+	return names[op];
+}
+
+bool definesValue(IROpcodeT op)
+{
+	return op != irStore && op != irCopy && op != irCall && op < irJump;
+}
+
+static void printValue(ostream& out, int value)
+{
+	out << '%' << value;
+}
+
+// The struct arguments of a call, and the result it is copied to, print with their size
+static void printArgs(ostream& out, const IRInstr* instr, int count)
+{
+	out << '(';
+	for (int i = 0; i < count; i++)
+	{
+		if (i)
+			out << ", ";
+		printValue(out, instr->args[i]);
+		if (instr->sizes[i])
+			out << ':' << instr->sizes[i];
+	}
+	out << ')';
+}
+
+void IRInstr::print(ostream& out) const
+{
+	out << '\t';
+	if (result >= 0)
+	{
+		printValue(out, result);
+		out << " = ";
+	}
+	out << irOpName(op);
+	switch (op)
+	{
+	case irInt:
+		out << ' ' << imm;
+		break;
+	case irParam:
+		out << ' ' << var->name;
+		break;
+	case irFloat:
+		out << ' ' << name;
+		break;
+	case irAddress:
+		out << ' ' << (var ? var->name : name);
+		break;
+	case irFrame:
+		out << ' ' << imm;
+		break;
+	case irCall:
+		out << ' ' << name;
+		printArgs(out, this, args.size() - (imm != 0));
+		if (imm)
+		{
+			out << " to ";
+			printValue(out, args.back());
+			out << ':' << imm;
+		}
+		break;
+	case irPrintf:
+	case irScanf:
+		out << ' ' << name;
+		printArgs(out, this, args.size());
+		break;
+	case irPhi:
+		for (int i = 0; i < args.size(); i++)
+		{
+			out << (i ? ", [" : " [");
+			printValue(out, args[i]);
+			out << ", " << targets[i]->name() << ']';
+		}
+		break;
+	default:
+		for (int i = 0; i < args.size(); i++)
+		{
+			out << (i ? ", " : " ");
+			printValue(out, args[i]);
+		}
+		if (op == irCopy || (op == irReturn && imm))
+			out << ", " << imm;
+		if ((op == irLoad || op == irStore) && imm)
+			out << ", byte";
+		for (int i = 0; i < targets.size(); i++)
+			out << (i || args.size() ? ", " : " ") << targets[i]->name();
+	}
+	out << endl;
+}
+
+IRBlock::~IRBlock()
+{
+	for (int i = 0; i < instrs.size(); i++)
+		delete instrs[i];
+}
+
+IRInstr* IRBlock::terminator() const
+{
+	return instrs.empty() || !instrs.back()->isTerminator() ? 0 : instrs.back();
+}
+
+void IRBlock::print(ostream& out) const
+{
+	out << name() << ':';
+	for (int i = 0; i < preds.size(); i++)
+		out << (i ? ", " : "\t; preds ") << preds[i]->name();
+	out << endl;
+	for (int i = 0; i < instrs.size(); i++)
+		instrs[i]->print(out);
+}
+
+IRFunction::~IRFunction()
+{
+	for (int i = 0; i < blocks.size(); i++)
+		delete blocks[i];
+}
+
+int IRFunction::newValue(IRValueKindT kind)
+{
+	values.push_back(kind);
+	return values.size() - 1;
+}
+
+IRBlock* IRFunction::newBlock()
+{
+	blocks.push_back(new IRBlock(blocks.size()));
+	return blocks.back();
+}
+
+// Float registers are listed after the blocks, as they do not show in every instruction
+void IRFunction::print(ostream& out) const
+{
+	out << "function " << name << endl;
+	for (int i = 0; i < blocks.size(); i++)
+		blocks[i]->print(out);
+	bool floats = false;
+	for (int i = 0; i < values.size(); i++)
+		if (values[i] == irValueFloat)
+		{
+			out << (floats ? ", " : "float ");
+			printValue(out, i);
+			floats = true;
+		}
+	if (floats)
+		out << endl;
+	out << endl;
+}
+
+// Checks the invariants every pass may rely on, throwing on the first one broken: blocks end in
+// one terminator and keep their phis first, preds match the edges, each register is defined
+// once before it is used along every path, and operands are of the kinds their operations take
+class IRVerifier
+{
+private:
+	const IRFunction& func;
+	vector<int> defBlock;
+	vector<int> defIndex;
+	vector<int> idom;
+	vector<int> order; // reverse postorder number of each block
+	void fail(const IRBlock* block, const string& msg) const;
+	void checkBlock(const IRBlock* block);
+	void checkEdges(const IRBlock* block) const;
+	void checkOperands(const IRBlock* block, const IRInstr* instr) const;
+	void checkKind(const IRBlock* block, int value, IRValueKindT kind) const;
+	void computeDominators();
+	bool dominates(int a, int b) const;
+	void checkUses(const IRBlock* block) const;
+public:
+	IRVerifier(const IRFunction& f): func(f), defBlock(f.values.size(), -1), defIndex(f.values.size(), -1) {}
+	void run();
+};
+
+void IRVerifier::fail(const IRBlock* block, const string& msg) const
+{
+	string text = "Invalid IR of " + func.name + (block ? ", " + block->name() : "") + ": " + msg;
+	throw exception(text.c_str());
+}
+
+void IRVerifier::run()
+{
+	if (func.blocks.empty())
+		fail(0, "no blocks");
+	if (!func.blocks[0]->preds.empty())
+		fail(func.blocks[0], "the entry has predecessors");
+	for (int i = 0; i < func.blocks.size(); i++)
+	{
+		if (func.blocks[i]->index != i)
+			fail(func.blocks[i], "numbered out of order");
+		checkBlock(func.blocks[i]);
+	}
+	for (int i = 0; i < func.values.size(); i++)
+		if (defBlock[i] < 0)
+			fail(0, "%" + to_string(i) + " is never defined");
+	for (int i = 0; i < func.blocks.size(); i++)
+		checkEdges(func.blocks[i]);
+	computeDominators();
+	for (int i = 0; i < func.blocks.size(); i++)
+		checkUses(func.blocks[i]);
+}
+
+void IRVerifier::checkBlock(const IRBlock* block)
+{
+	if (!block->terminator())
+		fail(block, "does not end in a terminator");
+	bool phis = true;
+	for (int i = 0; i < block->instrs.size(); i++)
+	{
+		const IRInstr* instr = block->instrs[i];
+		if (instr->isTerminator() && i + 1 < block->instrs.size())
+			fail(block, string(irOpName(instr->op)) + " before the end");
+		if (instr->op == irPhi && !phis)
+			fail(block, "phi after other instructions");
+		phis = phis && instr->op == irPhi;
+		int result = instr->result;
+		if (result >= 0)
+		{
+			if (result >= func.values.size())
+				fail(block, "%" + to_string(result) + " is not a register");
+			if (defBlock[result] >= 0)
+				fail(block, "%" + to_string(result) + " is defined twice");
+			defBlock[result] = block->index;
+			defIndex[result] = i;
+		}
+		checkOperands(block, instr);
+	}
+}
+
+void IRVerifier::checkKind(const IRBlock* block, int value, IRValueKindT kind) const
+{
+	if (value < 0 || value >= func.values.size())
+		fail(block, "%" + to_string(value) + " is not a register");
+	if (func.values[value] != kind)
+		fail(block, "%" + to_string(value) + " is not " + (kind == irValueInt ? "an int" : "a float"));
+}
+
+void IRVerifier::checkOperands(const IRBlock* block, const IRInstr* instr) const
+{
+	IROpcodeT op = instr->op;
+	string name = irOpName(op);
+	int argsCount = -1; // any
+	int targetsCount = 0;
+	IRValueKindT argKind = irValueInt;
+	bool typedArgs = true;
+	if (definesValue(op) != (instr->result >= 0) && op != irCall)
+		fail(block, name + (definesValue(op) ? " without a result" : " with a result"));
+	switch (op)
+	{
+	case irUndef:
+	case irInt:
+	case irFloat:
+	case irAddress:
+	case irFrame:
+	case irParam:
+		argsCount = 0;
+		if ((op == irParam && !instr->var) || (op == irAddress && !instr->var && instr->name.empty()))
+			fail(block, name + " of nothing");
+		if (op == irFrame && instr->imm <= 0)
+			fail(block, "frame of no bytes");
+		if (op == irFloat)
+			checkKind(block, instr->result, irValueFloat);
+		else if (op == irAddress || op == irFrame || op == irInt)
+			checkKind(block, instr->result, irValueInt);
+		break;
+	case irLoad:
+	case irNeg:
+	case irNot:
+	case irIntToFloat:
+		argsCount = 1;
+		break;
+	case irStore:
+		argsCount = 2;
+		checkKind(block, instr->args[0], irValueInt);
+		typedArgs = false;
+		break;
+	case irCopy:
+		argsCount = 2;
+		if (instr->imm <= 0)
+			fail(block, "copy of no bytes");
+		break;
+	case irFNeg:
+	case irFloatToInt:
+		argsCount = 1;
+		argKind = irValueFloat;
+		break;
+	case irCall:
+	case irPrintf:
+	case irScanf:
+		if (instr->sizes.size() != instr->args.size())
+			fail(block, name + " without the size of every argument");
+		for (int i = 0; i < instr->args.size(); i++)
+			if (instr->sizes[i])
+				checkKind(block, instr->args[i], irValueInt);
+		if (op == irCall && instr->imm && (instr->result >= 0 || instr->args.empty() || instr->sizes.back() != instr->imm))
+			fail(block, "call with a struct result that is not copied to its last argument");
+		if (op != irCall && instr->result >= 0)
+			checkKind(block, instr->result, irValueInt);
+		typedArgs = false;
+		break;
+	case irPhi:
+		if (instr->args.size() != instr->targets.size())
+			fail(block, "phi without a block for every argument");
+		argKind = func.values[instr->result];
+		break;
+	case irJump:
+		argsCount = 0;
+		targetsCount = 1;
+		break;
+	case irBranch:
+		argsCount = 1;
+		targetsCount = 2;
+		if (instr->targets.size() == 2 && instr->targets[0] == instr->targets[1])
+			fail(block, "br to the same block twice");
+		break;
+	case irReturn:
+		if (instr->args.size() > 1 || (instr->imm && instr->args.empty()))
+			fail(block, "ret of more than one value");
+		typedArgs = instr->imm != 0;
+		break;
+	default:
+		argsCount = 2;
+		if (op >= irFAdd && op <= irFGe)
+			argKind = irValueFloat;
+		checkKind(block, instr->result, op >= irFAdd && op <= irFDiv ? irValueFloat : irValueInt);
+	}
+	if (argsCount >= 0 && instr->args.size() != argsCount)
+		fail(block, name + " of " + to_string(instr->args.size()) + " operands");
+	if (op != irPhi && instr->targets.size() != targetsCount)
+		fail(block, name + " to " + to_string(instr->targets.size()) + " blocks");
+	for (int i = 0; i < instr->targets.size(); i++)
+	{
+		int index = instr->targets[i]->index;
+		if (index < 0 || index >= func.blocks.size() || func.blocks[index] != instr->targets[i])
+			fail(block, name + " to a block of another function");
+	}
+	if (op == irIntToFloat)
+		checkKind(block, instr->result, irValueFloat);
+	if (op == irNeg || op == irNot || op == irFloatToInt)
+		checkKind(block, instr->result, irValueInt);
+	if (op == irFNeg)
+		checkKind(block, instr->result, irValueFloat);
+	if (typedArgs && op != irLoad)
+		for (int i = 0; i < instr->args.size(); i++)
+			checkKind(block, instr->args[i], argKind);
+	if (op == irLoad)
+		checkKind(block, instr->args[0], irValueInt);
+}
+
+// The preds of a block are the blocks whose terminators go to it, each once, and its phis take
+// one argument from each of them
+void IRVerifier::checkEdges(const IRBlock* block) const
+{
+	multiset<const IRBlock*> incoming;
+	for (int i = 0; i < func.blocks.size(); i++)
+	{
+		const IRInstr* last = func.blocks[i]->terminator();
+		for (int j = 0; j < last->targets.size(); j++)
+			if (last->targets[j] == block)
+				incoming.insert(func.blocks[i]);
+	}
+	multiset<const IRBlock*> preds(block->preds.begin(), block->preds.end());
+	if (incoming != preds)
+		fail(block, "preds do not match the edges to it");
+	for (int i = 0; i < block->instrs.size() && block->instrs[i]->op == irPhi; i++)
+	{
+		const IRInstr* phi = block->instrs[i];
+		set<const IRBlock*> from(phi->targets.begin(), phi->targets.end());
+		if (phi->targets.size() != preds.size() || from != set<const IRBlock*>(preds.begin(), preds.end()))
+			fail(block, "phi of %" + to_string(phi->result) + " does not take one argument from each pred");
+	}
+}
+
+// Cooper, Harvey and Kennedy's iteration over the blocks in reverse postorder
+void IRVerifier::computeDominators()
+{
+	int count = func.blocks.size();
+	vector<int> postorder;
+	vector<bool> seen(count, false);
+	vector<pair<int, int> > path(1, make_pair(0, 0)); // block and the next successor to visit
+	seen[0] = true;
+	while (!path.empty())
+	{
+		const IRInstr* last = func.blocks[path.back().first]->terminator();
+		if (path.back().second < last->targets.size())
+		{
+			int next = last->targets[path.back().second++]->index;
+			if (!seen[next])
+			{
+				seen[next] = true;
+				path.push_back(make_pair(next, 0));
+			}
+		} else {
+			postorder.push_back(path.back().first);
+			path.pop_back();
+		}
+	}
+	for (int i = 0; i < count; i++)
+		if (!seen[i])
+			fail(func.blocks[i], "unreachable");
+	order.assign(count, 0);
+	for (int i = 0; i < count; i++)
+		order[postorder[i]] = count - 1 - i;
+	idom.assign(count, -1);
+	idom[0] = 0;
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int i = count - 1; i >= 0; i--)
+		{
+			int b = postorder[i];
+			if (b == 0)
+				continue;
+			int dom = -1;
+			const vector<IRBlock*>& preds = func.blocks[b]->preds;
+			for (int j = 0; j < preds.size(); j++)
+			{
+				int p = preds[j]->index;
+				if (idom[p] < 0)
+					continue;
+				if (dom < 0)
+				{
+					dom = p;
+					continue;
+				}
+				while (p != dom)
+				{
+					while (order[p] > order[dom])
+						p = idom[p];
+					while (order[dom] > order[p])
+						dom = idom[dom];
+				}
+			}
+			if (idom[b] != dom)
+			{
+				idom[b] = dom;
+				changed = true;
+			}
+		}
+	}
+}
+
+bool IRVerifier::dominates(int a, int b) const
+{
+	while (b != a && b != 0)
+		b = idom[b];
+	return b == a;
+}
+
+// A phi uses its argument at the end of the block it comes from
+void IRVerifier::checkUses(const IRBlock* block) const
+{
+	for (int i = 0; i < block->instrs.size(); i++)
+	{
+		const IRInstr* instr = block->instrs[i];
+		for (int j = 0; j < instr->args.size(); j++)
+		{
+			int value = instr->args[j];
+			int from = instr->op == irPhi ? instr->targets[j]->index : block->index;
+			bool defined = defBlock[value] == from ? instr->op == irPhi || defIndex[value] < i
+				: dominates(defBlock[value], from);
+			if (!defined)
+				fail(block, "%" + to_string(value) + " is used where its definition does not dominate");
+		}
+	}
+}
+
+void IRFunction::verify() const
+{
+	IRVerifier(*this).run();
+}
+
+IRReader::~IRReader()
+{
+	for (int i = 0; i < params.size(); i++)
+		delete params[i];
+}
+
+void IRReader::fail(const string& msg) const
+{
+	string text = "IR line " + to_string(lineNumber) + ": " + msg;
+	throw exception(text.c_str());
+}
+
+bool IRReader::readLine()
+{
+	if (!getline(in, line))
+		return false;
+	lineNumber++;
+	if (!line.empty() && line.back() == '\r')
+		line.pop_back();
+	return true;
+}
+
+// The words of the line with the punctuation the printer puts between them dropped
+static vector<string> splitWords(const string& line)
+{
+	string text = line;
+	for (int i = 0; i < text.size(); i++)
+		if (strchr(",()[]:", text[i]))
+			text[i] = ' ';
+	istringstream stream(text);
+	vector<string> words;
+	string word;
+	while (stream >> word)
+		words.push_back(word);
+	return words;
+}
+
+static bool isNumber(const string& word)
+{
+	return isdigit(word[0]) || (word[0] == '-' && word.size() > 1 && isdigit(word[1]));
+}
+
+IRBlock* IRReader::block(const string& word)
+{
+	if (word.size() < 2 || word[0] != 'b' || !isdigit(word[1]))
+		fail("'" + word + "' is not a block");
+	int index = stoi(word.substr(1));
+	IRBlock*& b = blocks[index];
+	if (!b)
+		b = new IRBlock(index);
+	return b;
+}
+
+int IRReader::value(const string& word)
+{
+	if (word.size() < 2 || word[0] != '%' || !isdigit(word[1]))
+		fail("'" + word + "' is not a register");
+	int v = stoi(word.substr(1));
+	lastValue = max(lastValue, v);
+	return v;
+}
+
+void IRReader::readInstr(IRBlock* b, const vector<string>& words)
+{
+	int result = -1;
+	int at = 0;
+	if (words.size() > 2 && words[1] == "=")
+	{
+		result = value(words[0]);
+		at = 2;
+	}
+	int op = 0;
+	while (op <= irReturn && words[at] != irOpName((IROpcodeT) op))
+		op++;
+	if (op > irReturn)
+		fail("unknown operation " + words[at]);
+	IRInstr* instr = new IRInstr((IROpcodeT) op, result);
+	b->instrs.push_back(instr);
+	at++;
+	if (op <= irFrame && op != irUndef)
+	{
+		if (at + 1 != words.size())
+			fail(words[at - 1] + " takes one operand");
+		if (op == irInt || op == irFrame)
+			instr->imm = stoi(words[at]);
+		else if (op == irParam) {
+			params.push_back(new VarSym(words[at], 0));
+			instr->var = params.back();
+		} else
+			instr->name = words[at];
+		return;
+	}
+	if (op == irCall || op == irPrintf || op == irScanf)
+	{
+		if (at == words.size())
+			fail(words[at - 1] + " of nothing");
+		instr->name = words[at++];
+	}
+	for (; at < words.size(); at++)
+	{
+		const string& word = words[at];
+		if (word[0] == '%') {
+			instr->args.push_back(value(word));
+			if (op >= irCall && op <= irScanf)
+				instr->sizes.push_back(0);
+		} else if (op >= irCall && op <= irScanf && isNumber(word) && !instr->args.empty())
+			instr->sizes.back() = stoi(word);
+		else if (op == irCall && word == "to" && at + 2 < words.size()) {
+			instr->args.push_back(value(words[++at]));
+			instr->imm = stoi(words[++at]);
+			instr->sizes.push_back(instr->imm);
+		} else if (isNumber(word))
+			instr->imm = stoi(word);
+		else if (word == "byte")
+			instr->imm = 1;
+		else
+			instr->targets.push_back(block(word));
+	}
+}
+
+// The next function up to the blank line after it, 0 at the end of the input
+IRFunction* IRReader::next()
+{
+	do
+		if (!readLine())
+			return 0;
+	while (line.empty());
+	vector<string> words = splitWords(line);
+	if (words.size() != 2 || words[0] != "function")
+		fail("function expected");
+	func = new IRFunction(words[1]);
+	blocks.clear();
+	lastValue = -1;
+	vector<int> floats;
+	IRBlock* current = 0;
+	while (readLine() && !line.empty())
+	{
+		words = splitWords(line);
+		if (words.empty())
+			continue;
+		if (line[0] == '\t') {
+			if (!current)
+				fail("an instruction outside any block");
+			readInstr(current, words);
+		} else if (words[0] == "float") {
+			for (int i = 1; i < words.size(); i++)
+				floats.push_back(value(words[i]));
+		} else {
+			current = block(words[0]);
+			if (find(func->blocks.begin(), func->blocks.end(), current) != func->blocks.end())
+				fail(words[0] + " is defined twice");
+			func->blocks.push_back(current);
+			for (int i = 1; i < words.size(); i++)
+				if (words[i] != ";" && words[i] != "preds")
+					current->preds.push_back(block(words[i]));
+		}
+	}
+	// blocks gone to but not written down end up last, empty
+	for (map<int, IRBlock*>::iterator it = blocks.begin(); it != blocks.end(); it++)
+		if (find(func->blocks.begin(), func->blocks.end(), it->second) == func->blocks.end())
+			func->blocks.push_back(it->second);
+	func->values.assign(lastValue + 1, irValueInt);
+	for (int i = 0; i < floats.size(); i++)
+		func->values[floats[i]] = irValueFloat;
+	return func;
+}
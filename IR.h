@@ -0,0 +1,149 @@
+#ifndef IR_H
+#define IR_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <istream>
+#include <map>
+#include "BaseSymbols.h"
+
+using namespace std;
+
+// Operations of the three-address code. Each defines at most one virtual register, its result;
+// a value is a dword: an int, a pointer or the bits of a float. A struct stands for its address
+typedef enum {
+	irUndef, // a variable read before any assignment
+	irInt, // imm
+	irFloat, // the float constant named name
+	irParam, // parameter var
+	irAddress, // of var, or of the data named name when var is 0
+	irFrame, // of imm bytes of the frame kept for this instruction
+	irLoad, // dword at args[0], or the byte there sign extended when imm is 1
+	irStore, // args[1] to the dword at args[0], or its low byte when imm is 1
+	irCopy, // imm bytes from args[1] to args[0]
+	irAdd,
+	irSub,
+	irMul,
+	irDiv,
+	irMod,
+	irAnd,
+	irOr,
+	irXor,
+	irShl,
+	irShr,
+	irEq,
+	irNe,
+	irLt,
+	irLe,
+	irGt,
+	irGe,
+	irNeg,
+	irNot,
+	irFAdd,
+	irFSub,
+	irFMul,
+	irFDiv,
+	irFEq,
+	irFNe,
+	irFLt,
+	irFLe,
+	irFGt,
+	irFGe,
+	irFNeg,
+	irIntToFloat,
+	irFloatToInt,
+	// of name; a struct argument goes by address with its size in sizes, and a struct result
+	// of imm bytes is copied to the address in the last argument
+	irCall,
+	irPrintf, // with the format named name
+	irScanf,
+	irPhi, // args[i] when control came from targets[i]
+	irJump, // to targets[0]
+	irBranch, // to targets[0] if args[0] is not 0, else to targets[1]
+	irReturn, // args[0], the address of a struct of imm bytes when imm is not 0
+} IROpcodeT;
+
+// Kind of a virtual register, which picks the instructions over it
+typedef enum {
+	irValueInt,
+	irValueFloat,
+} IRValueKindT;
+
+class IRBlock;
+
+class IRInstr
+{
+public:
+	IROpcodeT op;
+	int result; // -1 if none
+	vector<int> args;
+	vector<IRBlock*> targets;
+	vector<int> sizes;
+	int imm;
+	string name;
+	VarSym* var;
+	IRInstr(IROpcodeT o, int r = -1): op(o), result(r), imm(0), var(0) {}
+	bool isTerminator() const { return op >= irJump; }
+	void print(ostream& out) const;
+};
+
+class IRBlock
+{
+public:
+	int index;
+	vector<IRInstr*> instrs; // phis first, a terminator last
+	vector<IRBlock*> preds;
+	IRBlock(int i): index(i) {}
+	~IRBlock();
+	IRInstr* terminator() const;
+	string name() const { return "b" + to_string(index); }
+	void print(ostream& out) const;
+};
+
+// One function in SSA form: every virtual register is assigned once, by an instruction that
+// dominates its uses. Variables held in registers are merged by phis; the rest stay in the
+// frame that the symbol tables laid out, below which lowering keeps the registers
+class IRFunction
+{
+public:
+	string name;
+	vector<IRBlock*> blocks; // the entry first
+	vector<IRValueKindT> values; // of each virtual register
+	int frameBytes; // below ebp taken by the variables of the body
+	int returnSlot; // offset from ebp of the result the caller reserved
+	IRFunction(const string& n): name(n), frameBytes(0), returnSlot(0) {}
+	~IRFunction();
+	int newValue(IRValueKindT kind);
+	IRBlock* newBlock();
+	void print(ostream& out) const;
+	void verify() const;
+};
+
+// Reads back what IRFunction::print writes, so the verifier can be given IR the builder never makes.
+// A parameter gets a VarSym of no type that lives as long as the reader
+class IRReader
+{
+private:
+	istream& in;
+	int lineNumber;
+	string line;
+	vector<VarSym*> params;
+	IRFunction* func;
+	map<int, IRBlock*> blocks;
+	int lastValue;
+	bool readLine();
+	void fail(const string& msg) const;
+	IRBlock* block(const string& word);
+	int value(const string& word);
+	void readInstr(IRBlock* b, const vector<string>& words);
+public:
+	IRReader(istream& input): in(input), lineNumber(0), func(0) {}
+	~IRReader();
+	IRFunction* next();
+};
+
+const char* irOpName(IROpcodeT op);
+bool definesValue(IROpcodeT op);
+
+#endif
@@ -0,0 +1,939 @@
+#include <algorithm>
+#include <cassert>
+#include "IRBuilder.h"
+#include "Exceptions.h"
+
+using namespace std;
+
+static TypeSym* resolved(TypeSym* type)
+{
+	while (type && isa<AliasSym>(type))
+		type = cast<AliasSym>(type)->type;
+	return type;
+}
+
+static bool isFloat(TypeSym* type)
+{
+	return resolved(type) == floatType;
+}
+
+// Stands for its address rather than its contents
+static bool isAggregate(TypeSym* type)
+{
+	type = resolved(type);
+	return type && (isa<ArraySym>(type) || type->isStruct());
+}
+
+static IRValueKindT kindOfType(TypeSym* type)
+{
+	return isFloat(type) ? irValueFloat : irValueInt;
+}
+
+// Type pointed at by a pointer or an array operand of + and -, 0 for other types
+static TypeSym* pointee(TypeSym* type)
+{
+	type = resolved(type);
+	return isa<PointerSym>(type) || isa<ArraySym>(type) ? type->nextType() : 0;
+}
+
+static IROpcodeT arithmeticOp(OperationsT op, bool floating)
+{
+	switch (op)
+	{
+	case PLUS:
+	case PLUS_ASSIGN:
+	case INC:
+		return floating ? irFAdd : irAdd;
+	case MINUS:
+	case MINUS_ASSIGN:
+	case DEC:
+		return floating ? irFSub : irSub;
+	case MULT:
+	case MULT_ASSIGN:
+		return floating ? irFMul : irMul;
+	case DIV:
+	case DIV_ASSIGN:
+		return floating ? irFDiv : irDiv;
+	case EQUAL:
+		return floating ? irFEq : irEq;
+	case NOT_EQUAL:
+		return floating ? irFNe : irNe;
+	case LESS:
+		return floating ? irFLt : irLt;
+	case LESS_OR_EQUAL:
+		return floating ? irFLe : irLe;
+	case GREATER:
+		return floating ? irFGt : irGt;
+	case GREATER_OR_EQUAL:
+		return floating ? irFGe : irGe;
+	}
+	if (!floating)
+		switch (op)
+		{
+		case MOD:
+		case MOD_ASSIGN:
+			return irMod;
+		case BITWISE_AND:
+		case AND_ASSIGN:
+			return irAnd;
+		case BITWISE_OR:
+		case OR_ASSIGN:
+			return irOr;
+		case BITWISE_XOR:
+		case XOR_ASSIGN:
+			return irXor;
+		case BITWISE_SHIFT_LEFT:
+		case BITWISE_SHIFT_LEFT_ASSIGN:
+			return irShl;
+		case BITWISE_SHIFT_RIGHT:
+		case BITWISE_SHIFT_RIGHT_ASSIGN:
+			return irShr;
+		}
+	assert(!"the TypeChecker lets no other operation through");
+	return irAdd;
+}
+
+static bool isComparison(IROpcodeT op)
+{
+	return (op >= irEq && op <= irGe) || (op >= irFEq && op <= irFGe);
+}
+
+bool IRBuilder::inRegister(VarSym* var)
+{
+	TypeSym* type = resolved(var->type);
+	return !var->global && !var->addressTaken && (isa<ScalarSym>(type) || isa<PointerSym>(type));
+}
+
+IRFunction* IRBuilder::build(const FuncSym* f, const string& name)
+{
+	func = new IRFunction(name);
+	function = f;
+	definitions.clear();
+	incompletePhis.clear();
+	sealedBlocks.clear();
+	replaced.clear();
+	cycles.clear();
+	func->returnSlot = frameLinkSize + f->params->byteSize();
+	enter(newBlock());
+	seal(block);
+	for (int i = 0; i < f->params->size(); i++)
+	{
+		VarSym* param = cast<VarSym>((*f->params)[i]);
+		if (!inRegister(param))
+			continue;
+		IRInstr* instr = append(irParam, func->newValue(kindOf(param)));
+		instr->var = param;
+		writeVariable(param, block, instr->result);
+	}
+	f->body->lower(*this);
+	terminate(new IRInstr(irReturn));
+	removeUnreachable();
+	removeTrivialPhis();
+	renumber();
+	return func;
+}
+
+int IRBuilder::resolve(int value) const
+{
+	while (value >= 0 && value < replaced.size() && replaced[value] >= 0)
+		value = replaced[value];
+	return value;
+}
+
+void IRBuilder::replace(int value, int by)
+{
+	if (replaced.size() <= value)
+		replaced.resize(func->values.size(), -1);
+	replaced[value] = by;
+}
+
+IRValueKindT IRBuilder::kindOf(VarSym* var) const
+{
+	return kindOfType(var->type);
+}
+
+IRInstr* IRBuilder::append(IROpcodeT op, int result)
+{
+	IRInstr* instr = new IRInstr(op, result);
+	block->instrs.push_back(instr);
+	return instr;
+}
+
+int IRBuilder::emit(IROpcodeT op, IRValueKindT kind, int a, int b)
+{
+	IRInstr* instr = append(op, func->newValue(kind));
+	if (a >= 0)
+		instr->args.push_back(a);
+	if (b >= 0)
+		instr->args.push_back(b);
+	return instr->result;
+}
+
+int IRBuilder::emitInt(int value)
+{
+	int result = emit(irInt, irValueInt);
+	block->instrs.back()->imm = value;
+	return result;
+}
+
+IRBlock* IRBuilder::newBlock()
+{
+	return func->newBlock();
+}
+
+// Ends the current block; what follows until the next enter is unreachable and goes to a block
+// of its own, dropped once the function is built
+void IRBuilder::terminate(IRInstr* instr)
+{
+	block->instrs.push_back(instr);
+	for (int i = 0; i < instr->targets.size(); i++)
+		instr->targets[i]->preds.push_back(block);
+	enter(newBlock());
+	seal(block);
+}
+
+void IRBuilder::jump(IRBlock* to)
+{
+	IRInstr* instr = new IRInstr(irJump);
+	instr->targets.push_back(to);
+	terminate(instr);
+}
+
+void IRBuilder::enterCycle(const CycleStatement* cycle, IRBlock* breakTo, IRBlock* continueTo)
+{
+	cycles[cycle] = make_pair(breakTo, continueTo);
+}
+
+// Branches on node, evaluating && and || and ! by control flow alone
+void IRBuilder::condition(const Node* node, IRBlock* ifTrue, IRBlock* ifFalse)
+{
+	if (isa<EmptyNode>(node))
+	{
+		jump(ifTrue);
+		return;
+	}
+	if (node->kind == nodeBinaryOp)
+	{
+		const BinaryOpNode* op = cast<BinaryOpNode>(node);
+		if (op->token->op == LOGICAL_AND || op->token->op == LOGICAL_OR)
+		{
+			IRBlock* right = newBlock();
+			if (op->token->op == LOGICAL_AND)
+				condition(op->left, right, ifFalse);
+			else
+				condition(op->left, ifTrue, right);
+			continueIn(right);
+			condition(op->right, ifTrue, ifFalse);
+			return;
+		}
+	}
+	if (node->kind == nodeUnaryOp && node->token->op == LOGICAL_NOT)
+	{
+		condition(cast<UnaryOpNode>(node)->operand, ifFalse, ifTrue);
+		return;
+	}
+	int value = truth(node);
+	if (ifTrue == ifFalse)
+	{
+		jump(ifTrue);
+		return;
+	}
+	IRInstr* instr = new IRInstr(irBranch);
+	instr->args.push_back(value);
+	instr->targets.push_back(ifTrue);
+	instr->targets.push_back(ifFalse);
+	terminate(instr);
+}
+
+// Value of node that is not 0 when it holds; a float is compared with 0
+int IRBuilder::truth(const Node* node)
+{
+	int value = visit(node);
+	if (!isFloat(node->getType()))
+		return value;
+	return emit(irFNe, irValueInt, value, emit(irIntToFloat, irValueFloat, emitInt(0)));
+}
+
+IRInstr* IRBuilder::newPhi(IRBlock* b, IRValueKindT kind)
+{
+	IRInstr* phi = new IRInstr(irPhi, func->newValue(kind));
+	b->instrs.insert(b->instrs.begin(), phi);
+	return phi;
+}
+
+int IRBuilder::undefined(IRBlock* b, IRValueKindT kind)
+{
+	vector<IRInstr*>::iterator at = b->instrs.begin();
+	while (at != b->instrs.end() && (*at)->op == irPhi)
+		at++;
+	IRInstr* instr = new IRInstr(irUndef, func->newValue(kind));
+	b->instrs.insert(at, instr);
+	return instr->result;
+}
+
+int IRBuilder::readVariable(VarSym* var, IRBlock* b)
+{
+	map<VarSym*, int>& defined = definitions[b];
+	map<VarSym*, int>::iterator it = defined.find(var);
+	if (it != defined.end())
+		return resolve(it->second);
+	return readVariableRecursive(var, b);
+}
+
+int IRBuilder::readVariableRecursive(VarSym* var, IRBlock* b)
+{
+	int value;
+	if (!sealedBlocks.count(b))
+	{
+		IRInstr* phi = newPhi(b, kindOf(var));
+		incompletePhis[b][var] = phi;
+		value = phi->result;
+	} else if (b->preds.size() == 0)
+		value = undefined(b, kindOf(var));
+	else if (b->preds.size() == 1)
+		value = readVariable(var, b->preds[0]);
+	else {
+		IRInstr* phi = newPhi(b, kindOf(var));
+		writeVariable(var, b, phi->result); // breaks the cycle through a loop
+		value = addPhiOperands(var, phi, b);
+	}
+	writeVariable(var, b, value);
+	return value;
+}
+
+int IRBuilder::addPhiOperands(VarSym* var, IRInstr* phi, IRBlock* b)
+{
+	for (int i = 0; i < b->preds.size(); i++)
+	{
+		phi->args.push_back(readVariable(var, b->preds[i]));
+		phi->targets.push_back(b->preds[i]);
+	}
+	return tryRemoveTrivialPhi(phi, b);
+}
+
+// A phi merging one value, besides itself, is replaced by that value
+int IRBuilder::tryRemoveTrivialPhi(IRInstr* phi, IRBlock* b)
+{
+	int same = -1;
+	for (int i = 0; i < phi->args.size(); i++)
+	{
+		int arg = resolve(phi->args[i]);
+		if (arg == same || arg == phi->result)
+			continue;
+		if (same != -1)
+			return phi->result;
+		same = arg;
+	}
+	if (same == -1)
+		same = undefined(b, func->values[phi->result]);
+	replace(phi->result, same);
+	b->instrs.erase(find(b->instrs.begin(), b->instrs.end(), phi));
+	delete phi;
+	return same;
+}
+
+// No predecessors come to b after this, so the phis it got while unsealed can be completed
+void IRBuilder::seal(IRBlock* b)
+{
+	map<VarSym*, IRInstr*> phis;
+	phis.swap(incompletePhis[b]);
+	for (map<VarSym*, IRInstr*>::iterator it = phis.begin(); it != phis.end(); it++)
+		addPhiOperands(it->first, it->second, b);
+	sealedBlocks.insert(b);
+}
+
+// Successors are taken last to first, so the reverse postorder lays a branch out as written
+static void postorder(IRBlock* b, set<IRBlock*>& reached, vector<IRBlock*>& order)
+{
+	reached.insert(b);
+	IRInstr* last = b->terminator();
+	for (int i = last ? last->targets.size() - 1 : -1; i >= 0; i--)
+		if (!reached.count(last->targets[i]))
+			postorder(last->targets[i], reached, order);
+	order.push_back(b);
+}
+
+// Drops the blocks left after jumps and the edges out of them, and orders the rest
+// in reverse postorder
+void IRBuilder::removeUnreachable()
+{
+	set<IRBlock*> reached;
+	vector<IRBlock*> order;
+	postorder(func->blocks[0], reached, order);
+	for (int i = 0; i < func->blocks.size(); i++)
+		if (!reached.count(func->blocks[i]))
+			delete func->blocks[i];
+	func->blocks.assign(order.rbegin(), order.rend());
+	for (int i = 0; i < func->blocks.size(); i++)
+	{
+		IRBlock* b = func->blocks[i];
+		vector<IRBlock*> preds;
+		for (int j = 0; j < b->preds.size(); j++)
+			if (reached.count(b->preds[j]))
+				preds.push_back(b->preds[j]);
+		b->preds.swap(preds);
+		for (int j = 0; j < b->instrs.size() && b->instrs[j]->op == irPhi; j++)
+		{
+			IRInstr* phi = b->instrs[j];
+			vector<int> args;
+			vector<IRBlock*> targets;
+			for (int k = 0; k < phi->targets.size(); k++)
+				if (reached.count(phi->targets[k]))
+				{
+					args.push_back(phi->args[k]);
+					targets.push_back(phi->targets[k]);
+				}
+			phi->args.swap(args);
+			phi->targets.swap(targets);
+		}
+	}
+}
+
+// The phis built before their operands were known, and those left with one predecessor
+void IRBuilder::removeTrivialPhis()
+{
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int i = 0; i < func->blocks.size(); i++)
+		{
+			IRBlock* b = func->blocks[i];
+			for (int j = 0; j < b->instrs.size(); j++)
+				for (int k = 0; k < b->instrs[j]->args.size(); k++)
+					b->instrs[j]->args[k] = resolve(b->instrs[j]->args[k]);
+			for (int j = 0; j < b->instrs.size() && b->instrs[j]->op == irPhi; j++)
+			{
+				int result = b->instrs[j]->result;
+				if (tryRemoveTrivialPhi(b->instrs[j], b) != result)
+				{
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+}
+
+// Numbers the blocks in order and the registers in the order they are defined
+void IRBuilder::renumber()
+{
+	vector<int> number(func->values.size(), -1);
+	vector<IRValueKindT> values;
+	for (int i = 0; i < func->blocks.size(); i++)
+	{
+		IRBlock* b = func->blocks[i];
+		b->index = i;
+		for (int j = 0; j < b->instrs.size(); j++)
+			if (b->instrs[j]->result >= 0)
+			{
+				number[b->instrs[j]->result] = values.size();
+				values.push_back(func->values[b->instrs[j]->result]);
+			}
+	}
+	for (int i = 0; i < func->blocks.size(); i++)
+		for (int j = 0; j < func->blocks[i]->instrs.size(); j++)
+		{
+			IRInstr* instr = func->blocks[i]->instrs[j];
+			if (instr->result >= 0)
+				instr->result = number[instr->result];
+			for (int k = 0; k < instr->args.size(); k++)
+				instr->args[k] = number[instr->args[k]];
+		}
+	func->values.swap(values);
+}
+
+int IRBuilder::load(int address, TypeSym* type)
+{
+	int value = emit(irLoad, kindOfType(type), address);
+	block->instrs.back()->imm = resolved(type)->byteSize() == 1;
+	return value;
+}
+
+int IRBuilder::offset(int base, int bytes)
+{
+	return bytes ? emit(irAdd, irValueInt, base, emitInt(bytes)) : base;
+}
+
+int IRBuilder::scale(int index, int size)
+{
+	return size != 1 ? emit(irMul, irValueInt, index, emitInt(size)) : index;
+}
+
+int IRBuilder::convert(int value, TypeSym* from, TypeSym* to)
+{
+	if (isFloat(to) && !isFloat(from))
+		return emit(irIntToFloat, irValueFloat, value);
+	if (!isFloat(to) && isFloat(from))
+		return emit(irFloatToInt, irValueInt, value);
+	return value;
+}
+
+int IRBuilder::address(const Node* node)
+{
+	switch (node->kind)
+	{
+	case nodeIdentifier:
+		{
+			VarSym* var = cast<IdentifierNode>(node)->sym;
+			if (inRegister(var))
+				throw CompilerException("Address of a variable held in a register", node->token);
+			IRInstr* instr = append(irAddress, func->newValue(irValueInt));
+			instr->var = var;
+			return instr->result;
+		}
+	case nodeArr:
+		return elementAddress(cast<ArrNode>(node));
+	case nodeUnaryOp:
+		if (node->token->op == MULT)
+			return visit(cast<UnaryOpNode>(node)->operand);
+		break;
+	case nodeBinaryOp:
+		{
+			const BinaryOpNode* op = cast<BinaryOpNode>(node);
+			if (op->token->op == DOT)
+				return offset(address(op->left), cast<IdentifierNode>(op->right)->sym->offset);
+			if (op->token->op == ARROW)
+				return offset(visit(op->left), cast<IdentifierNode>(op->right)->sym->offset);
+		}
+		break;
+	}
+	if (isAggregate(node->getType()))
+		return visit(node);
+	throw CompilerException("Expression must have lvalue", node->token);
+}
+
+int IRBuilder::elementAddress(const ArrNode* node)
+{
+	TypeSym* type = resolved(node->name->getType());
+	int base = visit(node->name);
+	for (int i = 0; i < node->args.size(); i++)
+	{
+		TypeSym* element = resolved(type->nextType());
+		base = emit(irAdd, irValueInt, base, scale(visit(node->args[i]), element->byteSize()));
+		if (i + 1 < node->args.size() && isa<PointerSym>(element))
+			base = load(base, element);
+		type = element;
+	}
+	return base;
+}
+
+IRPlaceT IRBuilder::place(const Node* node)
+{
+	IRPlaceT result = { 0, -1, false };
+	if (node->kind == nodeBinaryOp && BinaryOpNode::isAssignment(node->token->op))
+	{
+		visit(node); // then the assigned operand names the result
+		return place(cast<BinaryOpNode>(node)->left);
+	}
+	if (isa<IdentifierNode>(node) && inRegister(cast<IdentifierNode>(node)->sym))
+		result.var = cast<IdentifierNode>(node)->sym;
+	else {
+		result.address = address(node);
+		result.byte = resolved(node->getType())->byteSize() == 1;
+	}
+	return result;
+}
+
+int IRBuilder::read(IRPlaceT place, IRValueKindT kind)
+{
+	if (place.var)
+		return readVariable(place.var, block);
+	int value = emit(irLoad, kind, place.address);
+	block->instrs.back()->imm = place.byte;
+	return value;
+}
+
+void IRBuilder::write(IRPlaceT place, int value)
+{
+	if (place.var)
+		writeVariable(place.var, block, value);
+	else {
+		IRInstr* instr = append(irStore);
+		instr->args.push_back(place.address);
+		instr->args.push_back(value);
+		instr->imm = place.byte;
+	}
+}
+
+// Every kind of node there is has a visit of its own
+int IRBuilder::visitNode(const Node* node)
+{
+	assert(!"a node of no known kind");
+	return -1;
+}
+
+int IRBuilder::visitIdentifier(const IdentifierNode* node)
+{
+	if (inRegister(node->sym))
+		return readVariable(node->sym, block);
+	int at = address(node);
+	return isAggregate(node->sym->type) ? at : load(at, node->sym->type);
+}
+
+int IRBuilder::visitFloat(const FloatNode* node)
+{
+	IRInstr* instr = append(irFloat, func->newValue(irValueFloat));
+	instr->name = node->constName();
+	return instr->result;
+}
+
+int IRBuilder::visitString(const StringNode* node)
+{
+	IRInstr* instr = append(irAddress, func->newValue(irValueInt));
+	instr->name = "str" + to_string(node->index);
+	return instr->result;
+}
+
+int IRBuilder::visitArr(const ArrNode* node)
+{
+	int at = elementAddress(node);
+	return isAggregate(node->getType()) ? at : load(at, node->getType());
+}
+
+int IRBuilder::visitCoerce(const CoerceNode* node)
+{
+	return convert(visit(node->operand), node->operand->getType(), node->type);
+}
+
+int IRBuilder::visitUnaryOp(const UnaryOpNode* node)
+{
+	TypeSym* type = node->getType();
+	switch (node->token->op)
+	{
+	case BITWISE_AND:
+		return address(node->operand);
+	case MULT:
+		{
+			int at = visit(node->operand);
+			return isAggregate(type) ? at : load(at, type);
+		}
+	case PLUS:
+		return visit(node->operand);
+	case MINUS:
+		return emit(isFloat(type) ? irFNeg : irNeg, kindOfType(type), visit(node->operand));
+	case BITWISE_NOT:
+		return emit(irNot, irValueInt, visit(node->operand));
+	case LOGICAL_NOT:
+		{
+			int value = visit(node->operand);
+			if (isFloat(node->operand->getType()))
+				return emit(irFEq, irValueInt, value, emit(irIntToFloat, irValueFloat, emitInt(0)));
+			return emit(irEq, irValueInt, value, emitInt(0));
+		}
+	case INC:
+	case DEC:
+		return step(node, false);
+	}
+	assert(!"the TypeChecker lets no other operation through");
+	return -1;
+}
+
+// ++ and --, by the size of the pointee for a pointer
+int IRBuilder::step(const UnaryOpNode* node, bool postfix)
+{
+	TypeSym* type = resolved(node->operand->getType());
+	IRPlaceT target = place(node->operand);
+	int old = read(target, kindOfType(type));
+	int by = isFloat(type) ? emit(irIntToFloat, irValueFloat, emitInt(1)) : emitInt(pointee(type) ? pointee(type)->byteSize() : 1);
+	int value = emit(arithmeticOp(node->token->op, isFloat(type)), kindOfType(type), old, by);
+	write(target, value);
+	return postfix ? old : value;
+}
+
+int IRBuilder::visitBinaryOp(const BinaryOpNode* node)
+{
+	OperationsT op = node->token->op;
+	TypeSym* type = node->getType();
+	switch (op)
+	{
+	case DOT:
+	case ARROW:
+		{
+			int at = address(node);
+			return isAggregate(type) ? at : load(at, type);
+		}
+	case ASSIGN:
+		return assign(node);
+	case PLUS_ASSIGN:
+	case MINUS_ASSIGN:
+	case MULT_ASSIGN:
+	case DIV_ASSIGN:
+	case MOD_ASSIGN:
+	case AND_ASSIGN:
+	case OR_ASSIGN:
+	case XOR_ASSIGN:
+	case BITWISE_SHIFT_LEFT_ASSIGN:
+	case BITWISE_SHIFT_RIGHT_ASSIGN:
+		return compoundAssign(node);
+	case COMMA:
+		visit(node->left);
+		return visit(node->right);
+	case LOGICAL_AND:
+	case LOGICAL_OR:
+		return logical(node);
+	}
+	TypeSym* leftPointee = pointee(node->left->getType());
+	TypeSym* rightPointee = pointee(node->right->getType());
+	if ((op == PLUS || op == MINUS) && (leftPointee != 0) != (rightPointee != 0))
+	{
+		const Node* pointer = leftPointee ? node->left : node->right;
+		const Node* index = leftPointee ? node->right : node->left;
+		if (isFloat(index->getType()))
+			throw CompilerException("Expression must have integral type", index->token);
+		int base = visit(pointer);
+		int by = scale(visit(index), (leftPointee ? leftPointee : rightPointee)->byteSize());
+		return emit(op == PLUS ? irAdd : irSub, irValueInt, base, by);
+	}
+	int left = visit(node->left);
+	int right = visit(node->right);
+	if (op == MINUS && leftPointee && rightPointee)
+	{
+		int size = leftPointee->byteSize();
+		int difference = emit(irSub, irValueInt, left, right);
+		return size != 1 ? emit(irDiv, irValueInt, difference, emitInt(size)) : difference;
+	}
+	bool floating = isFloat(node->left->getType());
+	IROpcodeT code = arithmeticOp(op, floating);
+	return emit(code, isComparison(code) ? irValueInt : kindOfType(type), left, right);
+}
+
+int IRBuilder::assign(const BinaryOpNode* node)
+{
+	TypeSym* type = resolved(node->getType());
+	int value = visit(node->right);
+	if (isAggregate(type))
+	{
+		int to = address(node->left);
+		IRInstr* instr = append(irCopy);
+		instr->imm = type->byteSize();
+		instr->args.push_back(to);
+		instr->args.push_back(value);
+		return to;
+	}
+	write(place(node->left), value);
+	return value;
+}
+
+int IRBuilder::compoundAssign(const BinaryOpNode* node)
+{
+	TypeSym* type = resolved(node->left->getType());
+	OperationsT op = node->token->op;
+	int right = visit(node->right);
+	IRPlaceT target = place(node->left);
+	int old = read(target, kindOfType(type));
+	if (pointee(type) && (op == PLUS_ASSIGN || op == MINUS_ASSIGN))
+		right = scale(right, pointee(type)->byteSize());
+	int value = emit(arithmeticOp(op, isFloat(type)), kindOfType(type), old, right);
+	write(target, value);
+	return value;
+}
+
+// && and || as a value: the left operand may decide it, the right one decides it otherwise
+int IRBuilder::logical(const BinaryOpNode* node)
+{
+	bool isAnd = node->token->op == LOGICAL_AND;
+	IRBlock* right = newBlock();
+	IRBlock* end = newBlock();
+	int decided = emitInt(isAnd ? 0 : 1);
+	condition(node->left, isAnd ? right : end, isAnd ? end : right);
+	continueIn(right);
+	int value = truth(node->right);
+	if (!isFloat(node->right->getType()))
+		value = emit(irNe, irValueInt, value, emitInt(0));
+	IRBlock* last = block;
+	jump(end);
+	continueIn(end);
+	IRInstr* phi = newPhi(end, irValueInt);
+	for (int i = 0; i < end->preds.size(); i++)
+	{
+		phi->args.push_back(end->preds[i] == last ? value : decided);
+		phi->targets.push_back(end->preds[i]);
+	}
+	return phi->result;
+}
+
+int IRBuilder::visitTernaryOp(const TernaryOpNode* node)
+{
+	IRBlock* ifTrue = newBlock();
+	IRBlock* ifFalse = newBlock();
+	IRBlock* end = newBlock();
+	condition(node->condition, ifTrue, ifFalse);
+	continueIn(ifTrue);
+	int left = visit(node->left);
+	IRBlock* leftEnd = block;
+	jump(end);
+	continueIn(ifFalse);
+	int right = visit(node->right);
+	IRBlock* rightEnd = block;
+	jump(end);
+	continueIn(end);
+	if (left < 0 || right < 0)
+		return -1;
+	IRInstr* phi = newPhi(end, kindOfType(node->getType()));
+	phi->args.push_back(left);
+	phi->targets.push_back(leftEnd);
+	phi->args.push_back(right);
+	phi->targets.push_back(rightEnd);
+	return phi->result;
+}
+
+int IRBuilder::visitFuncCall(const FuncCallNode* node)
+{
+	IRInstr* call = new IRInstr(irCall);
+	call->name = "f_" + node->name->token->text();
+	call->args.resize(node->args.size());
+	call->sizes.resize(node->args.size());
+	for (int i = node->args.size() - 1; i >= 0; i--)
+	{
+		call->args[i] = visit(node->args[i]);
+		TypeSym* type = resolved(node->args[i]->getType());
+		call->sizes[i] = type->isStruct() ? type->byteSize() : 0;
+	}
+	TypeSym* returns = resolved(node->symbol->val);
+	if (returns->isStruct())
+	{
+		IRInstr* frame = append(irFrame, func->newValue(irValueInt));
+		frame->imm = returns->byteSize();
+		call->imm = frame->imm;
+		call->args.push_back(frame->result);
+		call->sizes.push_back(frame->imm);
+	} else if (returns->byteSize())
+		call->result = func->newValue(kindOfType(returns));
+	block->instrs.push_back(call);
+	return call->imm ? call->args.back() : call->result;
+}
+
+int IRBuilder::visitIOOperator(const IOOperatorNode* node)
+{
+	IRInstr* io = new IRInstr(node->token->op == PRINTF ? irPrintf : irScanf);
+	io->name = "str" + to_string(node->format->index);
+	io->args.resize(node->args.size());
+	io->sizes.resize(node->args.size());
+	for (int i = node->args.size() - 1; i >= 0; i--)
+	{
+		io->args[i] = visit(node->args[i]);
+		TypeSym* type = resolved(node->args[i]->getType());
+		io->sizes[i] = type->isStruct() ? type->byteSize() : 0;
+	}
+	io->result = func->newValue(irValueInt);
+	block->instrs.push_back(io);
+	return io->result;
+}
+
+void IRBuilder::returnValue(const Node* arg)
+{
+	IRInstr* instr = new IRInstr(irReturn);
+	TypeSym* type = resolved(function->val);
+	if (arg)
+	{
+		int value = visit(arg);
+		if (type->isStruct())
+		{
+			instr->imm = type->byteSize();
+			instr->args.push_back(value);
+		} else if (type->byteSize())
+			instr->args.push_back(convert(value, arg->getType(), type));
+	}
+	terminate(instr);
+}
+
+void Block::lower(IRBuilder& builder) const
+{
+	builder.reserveFrame(locals->shift + locals->byteSize());
+	for (int i = 0; i < size(); i++)
+		statements[i]->lower(builder);
+}
+
+void SingleStatement::lower(IRBuilder& builder) const
+{
+	builder.evaluate(expr);
+}
+
+void IfStatement::lower(IRBuilder& builder) const
+{
+	IRBlock* ifTrue = builder.newBlock();
+	IRBlock* ifFalse = falseBranch ? builder.newBlock() : 0;
+	IRBlock* end = builder.newBlock();
+	if (!falseBranch)
+		ifFalse = end;
+	builder.condition(condition, ifTrue, ifFalse);
+	builder.continueIn(ifTrue);
+	trueBranch->lower(builder);
+	builder.jump(end);
+	if (falseBranch)
+	{
+		builder.continueIn(ifFalse);
+		falseBranch->lower(builder);
+		builder.jump(end);
+	}
+	builder.continueIn(end);
+}
+
+void WhilePreCondStatement::lower(IRBuilder& builder) const
+{
+	IRBlock* header = builder.newBlock();
+	IRBlock* loop = builder.newBlock();
+	IRBlock* end = builder.newBlock();
+	builder.jump(header);
+	builder.enter(header);
+	builder.condition(condition, loop, end);
+	builder.continueIn(loop);
+	builder.enterCycle(this, end, header);
+	body->lower(builder);
+	builder.jump(header);
+	builder.seal(header);
+	builder.continueIn(end);
+}
+
+void WhilePostCondStatement::lower(IRBuilder& builder) const
+{
+	IRBlock* loop = builder.newBlock();
+	IRBlock* test = builder.newBlock();
+	IRBlock* end = builder.newBlock();
+	builder.jump(loop);
+	builder.enter(loop);
+	builder.enterCycle(this, end, test);
+	body->lower(builder);
+	builder.jump(test);
+	builder.continueIn(test);
+	builder.condition(condition, loop, end);
+	builder.seal(loop);
+	builder.continueIn(end);
+}
+
+void ForStatement::lower(IRBuilder& builder) const
+{
+	IRBlock* header = builder.newBlock();
+	IRBlock* loop = builder.newBlock();
+	IRBlock* step = builder.newBlock();
+	IRBlock* end = builder.newBlock();
+	builder.evaluate(initialization);
+	builder.jump(header);
+	builder.enter(header);
+	builder.condition(condition, loop, end);
+	builder.continueIn(loop);
+	builder.enterCycle(this, end, step);
+	body->lower(builder);
+	builder.jump(step);
+	builder.continueIn(step);
+	builder.evaluate(increment);
+	builder.jump(header);
+	builder.seal(header);
+	builder.continueIn(end);
+}
+
+void BreakStatement::lower(IRBuilder& builder) const
+{
+	builder.jump(builder.breakTarget(owner));
+}
+
+void ContinueStatement::lower(IRBuilder& builder) const
+{
+	builder.jump(builder.continueTarget(owner));
+}
+
+void ReturnStatement::lower(IRBuilder& builder) const
+{
+	builder.returnValue(arg);
+}
@@ -0,0 +1,101 @@
+#ifndef IR_BUILDER_H
+#define IR_BUILDER_H
+
+#include <map>
+#include <set>
+#include "IR.h"
+#include "Symbols.h"
+#include "NodeVisitor.h"
+
+using namespace std;
+
+// Where an assignment goes: a variable held in virtual registers, or a dword in memory
+typedef struct {
+	VarSym* var; // 0 for memory
+	int address;
+	bool byte; // a char, read and written alone
+} IRPlaceT;
+
+// Lowers the body of one function into SSA form as it walks the tree. Local scalars and pointers
+// whose address is never taken live in virtual registers: each block maps them to their current
+// value, and a read a block cannot answer asks its predecessors, through a phi when they are
+// several. A block takes no more predecessors once sealed, so a loop header gets its phis
+// completed when the back edges are known. Every visit returns the register of the value,
+// the address for a struct or an array, and -1 for no value
+class IRBuilder : public NodeVisitor<IRBuilder, int>
+{
+private:
+	IRFunction* func;
+	const FuncSym* function;
+	IRBlock* block; // instructions go to its end
+	map<IRBlock*, map<VarSym*, int> > definitions;
+	map<IRBlock*, map<VarSym*, IRInstr*> > incompletePhis;
+	set<IRBlock*> sealedBlocks;
+	vector<int> replaced; // by the value of the trivial phi that defined it, -1 if not replaced
+	map<const CycleStatement*, pair<IRBlock*, IRBlock*> > cycles; // break and continue targets
+	int resolve(int value) const;
+	void replace(int value, int by);
+	IRValueKindT kindOf(VarSym* var) const;
+	IRInstr* append(IROpcodeT op, int result = -1);
+	int emit(IROpcodeT op, IRValueKindT kind, int a = -1, int b = -1);
+	int emitInt(int value);
+	void terminate(IRInstr* instr);
+	IRInstr* newPhi(IRBlock* b, IRValueKindT kind);
+	int undefined(IRBlock* b, IRValueKindT kind);
+	void writeVariable(VarSym* var, IRBlock* b, int value) { definitions[b][var] = value; }
+	int readVariable(VarSym* var, IRBlock* b);
+	int readVariableRecursive(VarSym* var, IRBlock* b);
+	int addPhiOperands(VarSym* var, IRInstr* phi, IRBlock* b);
+	int tryRemoveTrivialPhi(IRInstr* phi, IRBlock* b);
+	void removeUnreachable();
+	void removeTrivialPhis();
+	void renumber();
+	int address(const Node* node);
+	int elementAddress(const ArrNode* node);
+	int offset(int base, int bytes);
+	int scale(int index, int size);
+	int load(int address, TypeSym* type);
+	int convert(int value, TypeSym* from, TypeSym* to);
+	int truth(const Node* node);
+	int logical(const BinaryOpNode* node);
+	int assign(const BinaryOpNode* node);
+	int compoundAssign(const BinaryOpNode* node);
+	int step(const UnaryOpNode* node, bool postfix);
+	IRPlaceT place(const Node* node);
+	int read(IRPlaceT place, IRValueKindT kind);
+	void write(IRPlaceT place, int value);
+public:
+	IRBuilder(): func(0), function(0), block(0) {}
+	static bool inRegister(VarSym* var);
+	IRFunction* build(const FuncSym* function, const string& name);
+	void reserveFrame(int bytes) { func->frameBytes = max(func->frameBytes, bytes); }
+	IRBlock* newBlock();
+	void enter(IRBlock* b) { block = b; }
+	void jump(IRBlock* to);
+	void condition(const Node* node, IRBlock* ifTrue, IRBlock* ifFalse);
+	void seal(IRBlock* b);
+	void continueIn(IRBlock* b) { seal(b); enter(b); }
+	void enterCycle(const CycleStatement* cycle, IRBlock* breakTo, IRBlock* continueTo);
+	IRBlock* breakTarget(const CycleStatement* cycle) { return cycles[cycle].first; }
+	IRBlock* continueTarget(const CycleStatement* cycle) { return cycles[cycle].second; }
+	void returnValue(const Node* arg);
+	void evaluate(const Node* node) { visit(node); }
+	int visitNode(const Node* node);
+	int visitEmpty(const EmptyNode* node) { return -1; }
+	int visitKeyword(const KeywordNode* node) { return -1; }
+	int visitUnaryOp(const UnaryOpNode* node);
+	int visitPostfixUnaryOp(const PostfixUnaryOpNode* node) { return step(node, true); }
+	int visitCoerce(const CoerceNode* node);
+	int visitBinaryOp(const BinaryOpNode* node);
+	int visitTernaryOp(const TernaryOpNode* node);
+	int visitInt(const IntNode* node) { return emitInt(node->token->intVal); }
+	int visitChar(const CharNode* node) { return emitInt(node->token->charVal); }
+	int visitFloat(const FloatNode* node);
+	int visitString(const StringNode* node);
+	int visitIdentifier(const IdentifierNode* node);
+	int visitFuncCall(const FuncCallNode* node);
+	int visitArr(const ArrNode* node);
+	int visitIOOperator(const IOOperatorNode* node);
+};
+
+#endif
@@ -0,0 +1,406 @@
+#include "IRLowering.h"
+#include "Nodes.h"
+
+using namespace std;
+
+AsmArgIndirect* IRLowering::slot(int value) const
+{
+	return makeIndirectArg(EBP, -(func.frameBytes + 4 * (value + 1)));
+}
+
+AsmArgLabel* IRLowering::label(const IRBlock* block) const
+{
+	return makeLabel("block_" + func.name + "_" + to_string(block->index));
+}
+
+AsmArgLabel* IRLowering::edgeLabel(const IRBlock* from, const IRBlock* to) const
+{
+	return makeLabel("edge_" + func.name + "_" + to_string(from->index) + "_" + to_string(to->index));
+}
+
+// The variables, then the registers, then the temporaries of struct results
+void IRLowering::layFrame()
+{
+	frameSize = func.frameBytes + 4 * func.values.size();
+	for (int i = 0; i < func.blocks.size(); i++)
+		for (int j = 0; j < func.blocks[i]->instrs.size(); j++)
+		{
+			const IRInstr* instr = func.blocks[i]->instrs[j];
+			if (instr->op != irFrame)
+				continue;
+			frameSize += alignUp(instr->imm, 4);
+			frames[instr] = -frameSize;
+		}
+}
+
+void IRLowering::lower()
+{
+	layFrame();
+	code.add(makeLabel("f_" + func.name))
+		.add(cmdPUSH, EBP)
+		.add(cmdMOV, EBP, ESP)
+		.add(cmdSUB, ESP, frameSize);
+	for (int i = 0; i < func.blocks.size(); i++)
+	{
+		const IRBlock* block = func.blocks[i];
+		code.add(label(block));
+		for (int j = 0; j < block->instrs.size(); j++)
+			lowerInstr(block, block->instrs[j]);
+	}
+}
+
+// eax = ebp + offset
+void IRLowering::loadAddress(int offset)
+{
+	code.add(cmdMOV, EAX, EBP)
+		.add(cmdMOV, EBX, offset)
+		.add(cmdADD, EAX, EBX);
+}
+
+void IRLowering::lowerInstr(const IRBlock* block, const IRInstr* instr)
+{
+	switch (instr->op)
+	{
+	case irUndef:
+	case irPhi:
+		break;
+	case irInt:
+		code.add(cmdMOV, slot(instr->result), makeArg(instr->imm));
+		break;
+	case irFloat:
+		code.add(cmdMOV, makeArg(EAX), makeArgMemory(instr->name))
+			.add(cmdMOV, slot(instr->result), makeArg(EAX));
+		break;
+	case irParam:
+		code.add(cmdMOV, makeArg(EAX), makeIndirectArg(EBP, instr->var->offset))
+			.add(cmdMOV, slot(instr->result), makeArg(EAX));
+		break;
+	case irAddress:
+		if (instr->var && !instr->var->global)
+			loadAddress(instr->var->offset);
+		else
+			code.add(cmdMOV, makeArg(EAX), makeArgMemory(instr->var ? "var_" + instr->var->name : instr->name, true));
+		code.add(cmdMOV, slot(instr->result), makeArg(EAX));
+		break;
+	case irFrame:
+		loadAddress(frames[instr]);
+		code.add(cmdMOV, slot(instr->result), makeArg(EAX));
+		break;
+	case irLoad:
+		code.add(cmdMOV, makeArg(EAX), slot(instr->args[0]));
+		if (instr->imm)
+			code.add(cmdMOVSX, makeArg(EAX), makeIndirectArg(EAX, 0, 1));
+		else
+			code.add(cmdMOV, makeArg(EAX), makeIndirectArg(EAX));
+		code.add(cmdMOV, slot(instr->result), makeArg(EAX));
+		break;
+	case irStore:
+		code.add(cmdMOV, makeArg(EAX), slot(instr->args[0]))
+			.add(cmdMOV, makeArg(EBX), slot(instr->args[1]))
+			.add(cmdMOV, makeIndirectArg(EAX, 0, instr->imm ? 1 : 4), makeArg(instr->imm ? BL : EBX));
+		break;
+	case irCopy:
+		code.add(cmdMOV, makeArg(ESI), slot(instr->args[1]))
+			.add(cmdMOV, makeArg(EDI), slot(instr->args[0]));
+		generateBlockCopy(code, instr->imm);
+		break;
+	case irNeg:
+	case irNot:
+		code.add(cmdMOV, makeArg(EAX), slot(instr->args[0]))
+			.add(instr->op == irNeg ? cmdNEG : cmdNOT, EAX)
+			.add(cmdMOV, slot(instr->result), makeArg(EAX));
+		break;
+	case irFNeg:
+		code.add(cmdFLD, slot(instr->args[0]))
+			.add(cmdFCHS)
+			.add(cmdFSTP, slot(instr->result));
+		break;
+	case irIntToFloat:
+		code.add(cmdFILD, slot(instr->args[0]))
+			.add(cmdFSTP, slot(instr->result));
+		break;
+	case irFloatToInt:
+		code.add(cmdFLD, slot(instr->args[0]))
+			.add(cmdFISTP, slot(instr->result));
+		break;
+	case irCall:
+		lowerCall(instr);
+		break;
+	case irPrintf:
+	case irScanf:
+		lowerIO(instr);
+		break;
+	case irJump:
+		assignPhis(block, instr->targets[0]);
+		code.add(cmdJMP, label(instr->targets[0]));
+		break;
+	case irBranch:
+		lowerBranch(block, instr);
+		break;
+	case irReturn:
+		lowerReturn(instr);
+		break;
+	default:
+		if (instr->op >= irFAdd && instr->op <= irFGe)
+			lowerFloat(instr);
+		else
+			lowerBinary(instr);
+	}
+}
+
+void IRLowering::lowerBinary(const IRInstr* instr)
+{
+	AsmArgIndirect* result = slot(instr->result);
+	code.add(cmdMOV, makeArg(EAX), slot(instr->args[0]));
+	switch (instr->op)
+	{
+	case irShl:
+	case irShr:
+		code.add(cmdMOV, makeArg(ECX), slot(instr->args[1]))
+			.add(instr->op == irShl ? cmdSHL : cmdSHR, makeArg(EAX), makeArg(CL))
+			.add(cmdMOV, result, makeArg(EAX));
+		return;
+	}
+	code.add(cmdMOV, makeArg(EBX), slot(instr->args[1]));
+	AsmCommandsT cmd;
+	switch (instr->op)
+	{
+	case irDiv:
+	case irMod:
+		code.add(cmdCDQ)
+			.add(cmdIDIV, EBX)
+			.add(cmdMOV, result, makeArg(instr->op == irDiv ? EAX : EDX));
+		return;
+	case irAdd:
+		cmd = cmdADD;
+		break;
+	case irSub:
+		cmd = cmdSUB;
+		break;
+	case irMul:
+		cmd = cmdIMUL;
+		break;
+	case irAnd:
+		cmd = cmdAND;
+		break;
+	case irOr:
+		cmd = cmdOR;
+		break;
+	case irXor:
+		cmd = cmdXOR;
+		break;
+	default:
+		switch (instr->op)
+		{
+		case irEq:
+			cmd = cmdSETE;
+			break;
+		case irNe:
+			cmd = cmdSETNE;
+			break;
+		case irLt:
+			cmd = cmdSETL;
+			break;
+		case irLe:
+			cmd = cmdSETLE;
+			break;
+		case irGt:
+			cmd = cmdSETG;
+			break;
+		default:
+			cmd = cmdSETGE;
+		}
+		code.add(cmdCMP, EAX, EBX)
+			.add(cmdMOV, EAX, 0)
+			.add(cmd, AL)
+			.add(cmdMOV, result, makeArg(EAX));
+		return;
+	}
+	code.add(cmd, EAX, EBX)
+		.add(cmdMOV, result, makeArg(EAX));
+}
+
+// fcompp compares the left operand, on top, with the right one and leaves the result in the
+// flags of an unsigned comparison once sahf copies it
+void IRLowering::lowerFloat(const IRInstr* instr)
+{
+	AsmArgIndirect* result = slot(instr->result);
+	AsmCommandsT cmd;
+	switch (instr->op)
+	{
+	case irFAdd:
+	case irFSub:
+	case irFMul:
+	case irFDiv:
+		code.add(cmdFLD, slot(instr->args[0]))
+			.add(cmdFLD, slot(instr->args[1]));
+		if (instr->op == irFAdd)
+			code.add(cmdFADDP);
+		else if (instr->op == irFSub)
+			code.add(cmdFSUBP);
+		else if (instr->op == irFMul)
+			code.add(cmdFMULP);
+		else
+			code.add(cmdFDIVP);
+		code.add(cmdFSTP, result);
+		return;
+	case irFEq:
+		cmd = cmdSETE;
+		break;
+	case irFNe:
+		cmd = cmdSETNE;
+		break;
+	case irFLt:
+		cmd = cmdSETB;
+		break;
+	case irFLe:
+		cmd = cmdSETBE;
+		break;
+	case irFGt:
+		cmd = cmdSETA;
+		break;
+	default:
+		cmd = cmdSETAE;
+	}
+	code.add(cmdFLD, slot(instr->args[1]))
+		.add(cmdFLD, slot(instr->args[0]))
+		.add(cmdFCOMPP)
+		.add(cmdFNSTSW, AX)
+		.add(cmdSAHF)
+		.add(cmdMOV, EAX, 0)
+		.add(cmd, AL)
+		.add(cmdMOV, result, makeArg(EAX));
+}
+
+// A copy of size bytes at address on the stack, in whole dwords
+void IRLowering::pushBlock(int address, int size)
+{
+	code.add(cmdMOV, makeArg(ESI), slot(address))
+		.add(cmdSUB, ESP, alignUp(size, 4))
+		.add(cmdMOV, EDI, ESP);
+	generateBlockCopy(code, size);
+}
+
+void IRLowering::lowerCall(const IRInstr* instr)
+{
+	int count = instr->args.size() - (instr->imm ? 1 : 0);
+	int resultBytes = instr->imm ? alignUp(instr->imm, 4) : instr->result >= 0 ? 4 : 0;
+	int paramsBytes = 0;
+	code.add(cmdSUB, ESP, resultBytes);
+	for (int i = count - 1; i >= 0; i--)
+		if (instr->sizes[i])
+		{
+			pushBlock(instr->args[i], instr->sizes[i]);
+			paramsBytes += alignUp(instr->sizes[i], 4);
+		} else {
+			code.add(cmdPUSH, slot(instr->args[i]));
+			paramsBytes += 4;
+		}
+	code.add(cmdCALL, makeLabel(instr->name))
+		.add(cmdADD, ESP, paramsBytes);
+	if (instr->result >= 0)
+		code.add(cmdPOP, EAX)
+			.add(cmdMOV, slot(instr->result), makeArg(EAX));
+	else if (instr->imm) {
+		code.add(cmdMOV, ESI, ESP)
+			.add(cmdMOV, makeArg(EDI), slot(instr->args.back()));
+		generateBlockCopy(code, instr->imm);
+		code.add(cmdADD, ESP, resultBytes);
+	}
+}
+
+// A float goes as a double, as C passes it to a variadic function
+void IRLowering::lowerIO(const IRInstr* instr)
+{
+	int size = 0;
+	for (int i = instr->args.size() - 1; i >= 0; i--)
+		if (instr->sizes[i])
+		{
+			pushBlock(instr->args[i], instr->sizes[i]);
+			size += alignUp(instr->sizes[i], 4);
+		} else if (func.values[instr->args[i]] == irValueFloat) {
+			code.add(cmdMOV, makeArg(EAX), makeArgMemory(real8name, true)) // keeps the pushes before it above fstp
+				.add(cmdFLD, slot(instr->args[i]))
+				.add(cmdFSTP, real8)
+				.add(cmdPUSH, makeIndirectArg(EAX, 4))
+				.add(cmdPUSH, makeIndirectArg(EAX));
+			size += 8;
+		} else {
+			code.add(cmdPUSH, slot(instr->args[i]));
+			size += 4;
+		}
+	code.add(instr->op == irPrintf ? PRINTF : SCANF, makeArgMemory(instr->name));
+	code.add(cmdADD, ESP, size)
+		.add(cmdMOV, slot(instr->result), makeArg(EAX));
+}
+
+// An edge into a block with phis gets their moves; when both edges need them, the taken one
+// goes through a label of its own
+void IRLowering::lowerBranch(const IRBlock* block, const IRInstr* instr)
+{
+	const IRBlock* ifTrue = instr->targets[0];
+	const IRBlock* ifFalse = instr->targets[1];
+	bool truePhis = ifTrue->instrs[0]->op == irPhi;
+	bool falsePhis = ifFalse->instrs[0]->op == irPhi;
+	code.add(cmdMOV, makeArg(EAX), slot(instr->args[0]))
+		.add(cmdCMP, EAX, 0);
+	if (!truePhis)
+	{
+		code.add(cmdJNE, label(ifTrue));
+		assignPhis(block, ifFalse);
+		code.add(cmdJMP, label(ifFalse));
+	} else if (!falsePhis) {
+		code.add(cmdJE, label(ifFalse));
+		assignPhis(block, ifTrue);
+		code.add(cmdJMP, label(ifTrue));
+	} else {
+		AsmArgLabel* edge = edgeLabel(block, ifTrue);
+		code.add(cmdJNE, edge);
+		assignPhis(block, ifFalse);
+		code.add(cmdJMP, label(ifFalse))
+			.add(edge);
+		assignPhis(block, ifTrue);
+		code.add(cmdJMP, label(ifTrue));
+	}
+}
+
+void IRLowering::lowerReturn(const IRInstr* instr)
+{
+	if (instr->args.size() && instr->imm)
+	{
+		code.add(cmdMOV, makeArg(ESI), slot(instr->args[0]))
+			.add(cmdMOV, EDI, EBP)
+			.add(cmdADD, EDI, func.returnSlot);
+		generateBlockCopy(code, instr->imm);
+	} else if (instr->args.size())
+		code.add(cmdMOV, makeArg(EAX), slot(instr->args[0]))
+			.add(cmdMOV, makeIndirectArg(EBP, func.returnSlot), makeArg(EAX));
+	code.add(cmdMOV, ESP, EBP)
+		.add(cmdPOP, EBP)
+		.add(cmdRET, makeArg(0));
+}
+
+void IRLowering::assignPhis(const IRBlock* from, const IRBlock* to)
+{
+	vector<const IRInstr*> phis;
+	vector<int> values;
+	for (int i = 0; i < to->instrs.size() && to->instrs[i]->op == irPhi; i++)
+	{
+		const IRInstr* phi = to->instrs[i];
+		for (int j = 0; j < phi->targets.size(); j++)
+			if (phi->targets[j] == from && phi->args[j] != phi->result)
+			{
+				phis.push_back(phi);
+				values.push_back(phi->args[j]);
+			}
+	}
+	if (phis.size() == 1)
+		code.add(cmdMOV, makeArg(EAX), slot(values[0]))
+			.add(cmdMOV, slot(phis[0]->result), makeArg(EAX));
+	else {
+		for (int i = 0; i < phis.size(); i++)
+			code.add(cmdPUSH, slot(values[i]));
+		for (int i = phis.size() - 1; i >= 0; i--)
+			code.add(cmdPOP, slot(phis[i]->result));
+	}
+}
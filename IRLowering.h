@@ -0,0 +1,39 @@
+#ifndef IR_LOWERING_H
+#define IR_LOWERING_H
+
+#include <map>
+#include "IR.h"
+
+using namespace std;
+
+// Emits a function in SSA form as AsmCode. Every virtual register gets a dword of the frame below
+// the variables, and each instruction loads its operands from there and stores its result back,
+// which keeps the code in the shapes the Optimizer rewrites. A phi is assigned on each edge into
+// its block; several go through the stack, so each reads the values from before the edge
+class IRLowering
+{
+private:
+	const IRFunction& func;
+	AsmCode& code;
+	map<const IRInstr*, int> frames; // offsets of the irFrame bytes
+	int frameSize;
+	AsmArgIndirect* slot(int value) const;
+	AsmArgLabel* label(const IRBlock* block) const;
+	AsmArgLabel* edgeLabel(const IRBlock* from, const IRBlock* to) const;
+	void layFrame();
+	void lowerInstr(const IRBlock* block, const IRInstr* instr);
+	void lowerBinary(const IRInstr* instr);
+	void lowerFloat(const IRInstr* instr);
+	void lowerCall(const IRInstr* instr);
+	void lowerIO(const IRInstr* instr);
+	void lowerBranch(const IRBlock* block, const IRInstr* instr);
+	void lowerReturn(const IRInstr* instr);
+	void loadAddress(int offset);
+	void pushBlock(int address, int size);
+	void assignPhis(const IRBlock* from, const IRBlock* to);
+public:
+	IRLowering(const IRFunction& f, AsmCode& c): func(f), code(c), frameSize(0) {}
+	void lower();
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include <cstring>
+#include <exception>
+#include "Interner.h"
+
+Interner::Interner(const Interner* base): base(base), first(base ? scopedIds : 0), count(0)
+{
+	for (int i = 0; i < chunksCount; i++)
+		chunks[i] = 0;
+	tables.push_back(newSlots(1024));
+	table = tables.back();
+}
+
+Interner::~Interner()
+{
+	for (int i = 0; i < chunksCount; i++)
+		delete[] chunks[i].load();
+	for (int i = 0; i < tables.size(); i++)
+	{
+		delete[] tables[i]->slots;
+		delete tables[i];
+	}
+}
+
+Interner& Interner::shared()
+{
+	static Interner interner;
+	return interner;
+}
+
+// The interner of the batch running on this thread, the shared one outside any
+Interner& Interner::current()
+{
+	return active() ? *active() : shared();
+}
+
+unsigned Interner::hash(const char* s, size_t length)
+{
+	unsigned h = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+		h = (h ^ (unsigned char) s[i]) * 16777619u;
+	return h;
+}
+
+NameSlotsT* Interner::newSlots(unsigned size)
+{
+	NameSlotsT* slots = new NameSlotsT;
+	slots->mask = size - 1;
+	slots->slots = new atomic<NameIdT>[size];
+	for (unsigned i = 0; i < size; i++)
+		slots->slots[i].store(noName, memory_order_relaxed);
+	return slots;
+}
+
+const InternedNameT& Interner::entry(NameIdT id) const
+{
+	id -= first;
+	return chunks[id >> chunkBits].load(memory_order_acquire)[id & ((1 << chunkBits) - 1)];
+}
+
+NameIdT Interner::lookup(const char* s, size_t length, unsigned h) const
+{
+	const NameSlotsT* slots = table.load(memory_order_acquire);
+	for (unsigned slot = h & slots->mask;; slot = (slot + 1) & slots->mask)
+	{
+		NameIdT id = slots->slots[slot].load(memory_order_acquire);
+		if (id == noName)
+			return noName;
+		const InternedNameT& name = entry(id);
+		if (name.hash == h && name.spelling.length() == length && memcmp(name.spelling.data(), s, length) == 0)
+			return id;
+	}
+}
+
+void Interner::place(NameSlotsT* slots, NameIdT id, unsigned h)
+{
+	unsigned slot = h & slots->mask;
+	while (slots->slots[slot].load(memory_order_relaxed) != noName)
+		slot = (slot + 1) & slots->mask;
+	slots->slots[slot].store(id, memory_order_release);
+}
+
+// Called with lock held. Readers see a new table only once it holds every name
+NameIdT Interner::insert(const char* s, size_t length, unsigned h)
+{
+	NameIdT id = lookup(s, length, h);
+	if (id != noName)
+		return id;
+	unsigned index = count.load(memory_order_relaxed);
+	if (index >> chunkBits >= chunksCount)
+		throw exception("Too many names");
+	InternedNameT* chunk = chunks[index >> chunkBits].load(memory_order_relaxed);
+	if (!chunk)
+	{
+		chunk = new InternedNameT[1 << chunkBits];
+		chunks[index >> chunkBits].store(chunk, memory_order_release);
+	}
+	InternedNameT& name = chunk[index & ((1 << chunkBits) - 1)];
+	name.spelling.assign(s, length);
+	name.hash = h;
+	name.decorated.store(noName, memory_order_relaxed);
+	id = first + index;
+	count.store(index + 1, memory_order_release);
+	NameSlotsT* slots = table.load(memory_order_relaxed);
+	if ((index + 1) * 2 > slots->mask + 1)
+	{
+		NameSlotsT* grown = newSlots((slots->mask + 1) * 2);
+		for (unsigned i = 0; i < index; i++)
+			place(grown, first + i, chunks[i >> chunkBits].load(memory_order_relaxed)[i & ((1 << chunkBits) - 1)].hash);
+		place(grown, id, h);
+		tables.push_back(grown);
+		table.store(grown, memory_order_release);
+	}
+	else
+		place(slots, id, h);
+	return id;
+}
+
+NameIdT Interner::intern(const char* s, size_t length)
+{
+	unsigned h = hash(s, length);
+	NameIdT id = base ? base->lookup(s, length, h) : noName;
+	if (id == noName)
+		id = lookup(s, length, h);
+	if (id != noName)
+		return id;
+	lock_guard<mutex> guard(lock);
+	return insert(s, length, h);
+}
+
+NameIdT Interner::find(const char* s, size_t length) const
+{
+	unsigned h = hash(s, length);
+	NameIdT id = base ? base->lookup(s, length, h) : noName;
+	return id != noName ? id : lookup(s, length, h);
+}
+
+const string& Interner::spelling(NameIdT id) const
+{
+	return id < first ? base->entry(id).spelling : entry(id).spelling;
+}
+
+// Id of '$' + spelling, the name struct-typed variables are stored under. The shared names
+// belong to no batch, so theirs is not remembered
+NameIdT Interner::decorated(NameIdT id)
+{
+	if (id == noName)
+		return noName;
+	if (id < first)
+		return intern('$' + spelling(id));
+	InternedNameT& name = const_cast<InternedNameT&>(entry(id));
+	NameIdT dec = name.decorated.load(memory_order_acquire);
+	if (dec == noName)
+	{
+		dec = intern('$' + name.spelling);
+		name.decorated.store(dec, memory_order_release);
+	}
+	return dec;
+}
@@ -0,0 +1,67 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "ActiveStack.h"
+
+using namespace std;
+
+typedef unsigned NameIdT;
+
+static const NameIdT noName = 0xffffffff;
+
+typedef struct {
+	string spelling;
+	unsigned hash;
+	atomic<NameIdT> decorated;
+} InternedNameT;
+
+// Open addressing over ids; a full one is replaced by one twice the size and kept until the interner dies
+typedef struct {
+	unsigned mask;
+	atomic<NameIdT>* slots;
+} NameSlotsT;
+
+// Every distinct spelling of an identifier, symbol or asm name gets one id,
+// so names are compared and looked up as integers. Lookups take no lock: a name is complete
+// before its id is published in the slots, and names never move. Only inserts lock.
+// The shared interner holds the names made outside any compilation, the predefined symbols' first;
+// a scoped one sees them too and numbers its own names from scopedIds, so it can die with its batch
+class Interner : public ActiveStack<Interner>
+{
+private:
+	static const int chunkBits = 12;
+	static const int chunksCount = 4096;
+	static const NameIdT scopedIds = 0x80000000;
+	const Interner* base;
+	NameIdT first;
+	atomic<InternedNameT*> chunks[chunksCount];
+	atomic<unsigned> count;
+	atomic<NameSlotsT*> table;
+	vector<NameSlotsT*> tables;
+	mutex lock;
+	static unsigned hash(const char* s, size_t length);
+	static NameSlotsT* newSlots(unsigned size);
+	const InternedNameT& entry(NameIdT id) const;
+	NameIdT lookup(const char* s, size_t length, unsigned h) const;
+	void place(NameSlotsT* slots, NameIdT id, unsigned h);
+	NameIdT insert(const char* s, size_t length, unsigned h);
+	Interner(const Interner&);
+	Interner& operator = (const Interner&);
+public:
+	Interner(const Interner* base = 0);
+	~Interner();
+	NameIdT intern(const char* s, size_t length);
+	NameIdT intern(const string& s) { return intern(s.data(), s.length()); }
+	NameIdT find(const char* s, size_t length) const;
+	NameIdT decorated(NameIdT id);
+	const string& spelling(NameIdT id) const;
+	int size() const { return count; }
+	static Interner& shared();
+	static Interner& current();
+};
+
+#endif
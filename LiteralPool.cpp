@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <exception>
+#include "LiteralPool.h"
+#include "Tokens.h"
+
+static const size_t chunkSize = 64 * 1024;
+
+LiteralPool::LiteralPool(): chunkUsed(chunkSize), count(0)
+{
+	for (int i = 0; i < valueChunksCount; i++)
+		values[i] = 0;
+}
+
+LiteralPool::~LiteralPool()
+{
+	for (int i = 0; i < chunks.size(); i++)
+		delete[] chunks[i];
+	for (int i = 0; i < valueChunksCount; i++)
+		delete[] values[i].load();
+}
+
+// Room for length chars at the end of the last chunk; a literal longer than a chunk gets one of its own
+char* LiteralPool::reserve(size_t length)
+{
+	if (chunkUsed + length > chunkSize)
+	{
+		chunks.push_back(new char[max(length, chunkSize)]);
+		chunkUsed = 0;
+	}
+	return chunks.back() + chunkUsed;
+}
+
+// Decodes literal text found between the quotes; noLiteral if an escape is invalid
+LiteralIdT LiteralPool::add(const char* begin, const char* end)
+{
+	char* text = reserve(end - begin);
+	char* textEnd = decodeLiteral(begin, end, text);
+	if (!textEnd)
+		return noLiteral;
+	unsigned id = count.load(memory_order_relaxed);
+	if (id >> valueBits >= valueChunksCount)
+		throw exception("Too many string literals");
+	LiteralValueT* chunk = values[id >> valueBits].load(memory_order_relaxed);
+	if (!chunk)
+	{
+		chunk = new LiteralValueT[1 << valueBits];
+		values[id >> valueBits].store(chunk, memory_order_release);
+	}
+	chunkUsed = textEnd - chunks.back();
+	LiteralValueT& value = chunk[id & ((1 << valueBits) - 1)];
+	value.text = text;
+	value.length = textEnd - text;
+	count.store(id + 1, memory_order_release);
+	return id;
+}
+
+string LiteralPool::value(LiteralIdT id) const
+{
+	const LiteralValueT& value = values[id >> valueBits].load(memory_order_acquire)[id & ((1 << valueBits) - 1)];
+	return string(value.text, value.length);
+}
@@ -0,0 +1,46 @@
+#ifndef LITERAL_POOL_H
+#define LITERAL_POOL_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include "ActiveStack.h"
+
+using namespace std;
+
+typedef unsigned LiteralIdT;
+
+static const LiteralIdT noLiteral = 0xffffffff;
+
+typedef struct {
+	const char* text;
+	unsigned length;
+} LiteralValueT;
+
+// Decoded values of the string literals of one compilation. Escapes are decoded straight into
+// large chunks, so a literal costs no allocation of its own. The scanner that reads the input
+// makes one and adds to it as it lexes; the Parser keeps it next to its arena and makes it
+// active on its threads, so a token finds its value there. Values never move and are complete
+// before their id is counted, so other threads may read while the one that adds goes on
+class LiteralPool : public ActiveStack<LiteralPool>
+{
+private:
+	vector<char*> chunks;
+	size_t chunkUsed;
+	static const int valueBits = 10;
+	static const int valueChunksCount = 4096;
+	atomic<LiteralValueT*> values[valueChunksCount];
+	atomic<unsigned> count;
+	char* reserve(size_t length);
+	LiteralPool(const LiteralPool&);
+	LiteralPool& operator = (const LiteralPool&);
+public:
+	LiteralPool();
+	~LiteralPool();
+	LiteralIdT add(const char* begin, const char* end);
+	string value(LiteralIdT id) const;
+	int size() const { return count.load(memory_order_acquire); }
+	static LiteralPool& current() { return running(); }
+};
+
+#endif
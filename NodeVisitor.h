@@ -0,0 +1,71 @@
+#ifndef NODE_VISITOR_H
+#define NODE_VISITOR_H
+
+#include "Nodes.h"
+
+// Static visitor over the node kinds. Derived overrides the visitX it cares about; the
+// rest fall through to the visit of the base class, ending in visitNode
+template <class Derived, class ResultT = void>
+class NodeVisitor
+{
+private:
+	Derived* self() { return static_cast<Derived*>(this); }
+public:
+	ResultT visit(const Node* node)
+	{
+		switch (node->kind)
+		{
+		case nodeEmpty:
+			return self()->visitEmpty(cast<EmptyNode>(node));
+		case nodeUnaryOp:
+			return self()->visitUnaryOp(cast<UnaryOpNode>(node));
+		case nodePostfixUnaryOp:
+			return self()->visitPostfixUnaryOp(cast<PostfixUnaryOpNode>(node));
+		case nodeCoerce:
+			return self()->visitCoerce(cast<CoerceNode>(node));
+		case nodeBinaryOp:
+			return self()->visitBinaryOp(cast<BinaryOpNode>(node));
+		case nodeTernaryOp:
+			return self()->visitTernaryOp(cast<TernaryOpNode>(node));
+		case nodeInt:
+			return self()->visitInt(cast<IntNode>(node));
+		case nodeFloat:
+			return self()->visitFloat(cast<FloatNode>(node));
+		case nodeIdentifier:
+			return self()->visitIdentifier(cast<IdentifierNode>(node));
+		case nodeFuncCall:
+			return self()->visitFuncCall(cast<FuncCallNode>(node));
+		case nodeArr:
+			return self()->visitArr(cast<ArrNode>(node));
+		case nodeIOOperator:
+			return self()->visitIOOperator(cast<IOOperatorNode>(node));
+		case nodeKeyword:
+			return self()->visitKeyword(cast<KeywordNode>(node));
+		case nodeChar:
+			return self()->visitChar(cast<CharNode>(node));
+		case nodeString:
+			return self()->visitString(cast<StringNode>(node));
+		}
+		return self()->visitNode(node);
+	}
+	ResultT visitNode(const Node* node) { return ResultT(); }
+	ResultT visitEmpty(const EmptyNode* node) { return self()->visitNode(node); }
+	ResultT visitOp(const OpNode* node) { return self()->visitNode(node); }
+	ResultT visitUnaryOp(const UnaryOpNode* node) { return self()->visitOp(node); }
+	ResultT visitPostfixUnaryOp(const PostfixUnaryOpNode* node) { return self()->visitUnaryOp(node); }
+	ResultT visitCoerce(const CoerceNode* node) { return self()->visitUnaryOp(node); }
+	ResultT visitBinaryOp(const BinaryOpNode* node) { return self()->visitOp(node); }
+	ResultT visitTernaryOp(const TernaryOpNode* node) { return self()->visitBinaryOp(node); }
+	ResultT visitInt(const IntNode* node) { return self()->visitNode(node); }
+	ResultT visitFloat(const FloatNode* node) { return self()->visitNode(node); }
+	ResultT visitIdentifier(const IdentifierNode* node) { return self()->visitNode(node); }
+	ResultT visitFunctional(const FunctionalNode* node) { return self()->visitNode(node); }
+	ResultT visitFuncCall(const FuncCallNode* node) { return self()->visitFunctional(node); }
+	ResultT visitArr(const ArrNode* node) { return self()->visitFunctional(node); }
+	ResultT visitIOOperator(const IOOperatorNode* node) { return self()->visitFunctional(node); }
+	ResultT visitKeyword(const KeywordNode* node) { return self()->visitNode(node); }
+	ResultT visitChar(const CharNode* node) { return self()->visitNode(node); }
+	ResultT visitString(const StringNode* node) { return self()->visitNode(node); }
+};
+
+#endif
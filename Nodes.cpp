@@ -1,13 +1,16 @@
 #include <iostream>
+#include <algorithm>
 #include "Nodes.h"
+#include "NodeVisitor.h"
+#include "TypeChecker.h"
 #include "Exceptions.h"
 
 using namespace std;
 
-ScalarSym* intType = new ScalarSym("int");
-ScalarSym* floatType = new ScalarSym("float");
-ScalarSym* charType = new ScalarSym("char");
-ScalarSym* voidType = new ScalarSym("void");
+ScalarSym* intType = new ScalarSym("int", 4);
+ScalarSym* floatType = new ScalarSym("float", 4);
+ScalarSym* charType = new ScalarSym("char", 1);
+ScalarSym* voidType = new ScalarSym("void", 0);
 PointerSym* stringType = new PointerSym(charType);
 
 string real4name("tmp4");
@@ -19,6 +22,68 @@ map<TypeSym*, int> typePriority;
 map<OperationsT, TypeSym*> operationTypeOperands;
 map<OperationsT, TypeSym*> operationReturningType;
 
+// Filled once before any compilation starts; readers never insert, so all threads may share them
+static bool initOperationTypes()
+{
+	typePriority[charType] = 1;
+	typePriority[intType] = 2;
+	typePriority[floatType] = 3;
+
+	operationTypeOperands[MOD] = intType;
+	operationTypeOperands[BITWISE_AND] = intType;
+	operationTypeOperands[BITWISE_OR] = intType;
+	operationTypeOperands[BITWISE_XOR] = intType;
+	operationTypeOperands[BITWISE_NOT] = intType;
+	operationTypeOperands[BITWISE_SHIFT_LEFT] = intType;
+	operationTypeOperands[BITWISE_SHIFT_RIGHT] = intType;
+
+	operationReturningType[MOD] = intType;
+	operationReturningType[BITWISE_AND] = intType;
+	operationReturningType[BITWISE_OR] = intType;
+	operationReturningType[BITWISE_NOT] = intType;
+	operationReturningType[BITWISE_SHIFT_LEFT] = intType;
+	operationReturningType[BITWISE_SHIFT_RIGHT] = intType;
+	operationReturningType[LOGICAL_AND] = intType;
+	operationReturningType[LOGICAL_OR] = intType;
+	operationReturningType[BITWISE_XOR] = intType;
+	operationReturningType[LOGICAL_NOT] = intType;
+	operationReturningType[BITWISE_XOR] = intType;
+	operationReturningType[EQUAL] = intType;
+	operationReturningType[NOT_EQUAL] = intType;
+	operationReturningType[LESS] = intType;
+	operationReturningType[LESS_OR_EQUAL] = intType;
+	operationReturningType[GREATER] = intType;
+	operationReturningType[GREATER_OR_EQUAL] = intType;
+	return true;
+}
+
+static bool operationTypesReady = initOperationTypes();
+
+static SymTable* initPredefinedTypes()
+{
+	SymTable* table = new SymTable();
+	table->add(intType);
+	table->add(floatType);
+	table->add(charType);
+	table->add(voidType);
+	return table;
+}
+
+// Bottom of the scope of every compilation, never added to
+SymTable* predefinedTypes = initPredefinedTypes();
+
+int priorityOf(TypeSym* type)
+{
+	map<TypeSym*, int>::const_iterator it = typePriority.find(type);
+	return it != typePriority.end() ? it->second : 0;
+}
+
+TypeSym* typeOfOperation(const map<OperationsT, TypeSym*>& types, OperationsT op)
+{
+	map<OperationsT, TypeSym*>::const_iterator it = types.find(op);
+	return it != types.end() ? it->second : 0;
+}
+
 static const int M = 2;
 
 void Node::generateByteToFPU(AsmCode& code) const
@@ -34,122 +99,109 @@ void Node::generateST0ToStack(AsmCode& code) const
 		.add(cmdPUSH, real4);
 }
 
-Node* Node::makeTypeCoerce(Node* expr, TypeSym* from, TypeSym* to)
+// Pushes the size bytes at esi as whole dwords, the first one on top
+void Node::generatePushBlock(AsmCode& code, int size) const
 {
-	if (!from->canConvertTo(to))
-		throw CompilerException("Cannot perform conversion", expr->token->line, expr->token->col);
-	if (from == to || *from == to)
-		return expr;
-	if (!dynamic_cast<ScalarSym*>(from) || !dynamic_cast<ScalarSym*>(to))
+	code.add(cmdSUB, ESP, alignUp(size, 4))
+		.add(cmdMOV, EDI, ESP);
+	generateBlockCopy(code, size);
+}
+
+// Pushes the size bytes at eax as whole dwords, the first one on top; a char is sign extended,
+// its neighbours may be other fields or elements
+void Node::generatePushDwords(AsmCode& code, int size) const
+{
+	if (size == 1)
 	{
-		return expr;
-	} else {
-		if (typePriority[to] - typePriority[from] == 1)
-			return new CoerceNode(0, expr, to);
-		return new CoerceNode(0, makeTypeCoerce(expr, from, intType), floatType); 
+		code.add(cmdMOVSX, makeArg(EAX), makeIndirectArg(EAX, 0, 1))
+			.add(cmdPUSH, EAX);
+		return;
 	}
+	int steps = alignUp(size, 4) / 4;
+	code.add(cmdMOV, EBX, EAX);
+	for (int i = 0; i < steps; i++)
+		code.add(cmdMOV, makeArg(EAX), makeIndirectArg(EBX, (steps - i - 1) * 4))
+			.add(cmdPUSH, EAX);
 }
 
-void EmptyNode::print(int deep) const
-{ 
-	cout << string(deep * M, ' ') << "<empty expression>" << endl;
+// Up to this size a value goes through the stack a dword at a time, which the optimizer turns
+// into movs; above it the value is copied from its address with rep movsd
+static const int blockCopyBytes = 16;
+
+bool isBlockCopied(TypeSym* type)
+{
+	return type->stackSize() > blockCopyBytes;
 }
 
-string OpNode::opName() const
+// Stores the first bytes bytes of ebx at eax + offset, a byte at a time unless it is the whole dword
+static void generateStore(AsmCode& code, int offset, int bytes)
 {
-	char operations[][5] = { "+", "-", "*", "/", "%", "++", "--", "+=", "-=", "*=", "/=", "%=", "?", ":",
-		"&", "|", "&&", "||", "!", "^", "&=", "|=", "^=", "=", "==", "!=", ">", "<", ">=", "<=", "<<", ">>", ".", "->",
-		"<<=", ">>=", "(", ")", "[", "]", ",", "~" };
-	return string(operations[dynamic_cast<OpToken*>(token)->val]);
+	if (bytes == 4)
+		code.add(cmdMOV, makeIndirectArg(EAX, offset), makeArg(EBX));
+	else if (bytes == 1)
+		code.add(cmdMOV, makeIndirectArg(EAX, offset, 1), makeArg(BL));
+	else {
+		code.add(cmdMOV, ECX, EBX);
+		for (int i = 0; i < bytes; i++)
+		{
+			code.add(cmdMOV, makeIndirectArg(EAX, offset + i, 1), makeArg(CL));
+			if (i < bytes - 1)
+				code.add(cmdSHR, ECX, 8);
+		}
+	}
 }
 
-BinaryOpNode::BinaryOpNode(Token* op, Node* l, Node* r): OpNode(op), left(l), right(r) 
+// Copies size bytes from esi to edi, whole dwords then the bytes left one by one
+void generateBlockCopy(AsmCode& code, int size)
 {
-	if (l == 0 || r == 0)
-		throw ParserException("Lost operand", op->line, op->col);
+	code.add(cmdMOV, ECX, size / 4)
+		.add(cmdREPMOVSD);
+	for (int i = 0; i < size % 4; i++)
+		code.add(cmdMOVSX, makeArg(EBX), makeIndirectArg(ESI, i, 1))
+			.add(cmdMOV, makeIndirectArg(EDI, i, 1), makeArg(BL));
 }
 
-TypeSym* BinaryOpNode::getType() const
+Node* Node::makeTypeCoerce(Node* expr, TypeSym* from, TypeSym* to)
 {
-	TypeSym* leftType = left->getType();
-	TypeSym* rightType = right->getType();
-	if (dynamic_cast<AliasSym*>(leftType))
-		leftType = leftType->getType();
-	if (dynamic_cast<AliasSym*>(rightType))
-		rightType = rightType->getType();
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
-	TypeSym* maxTypeOfArgs = 0;
-	if (operationTypeOperands.count(op))
-		maxTypeOfArgs = operationTypeOperands[op];
-	else
-		maxTypeOfArgs = typePriority[leftType] > typePriority[rightType] ? leftType : rightType;
-	PointerSym* lp = dynamic_cast<PointerSym*>(leftType);
-	PointerSym* rp = dynamic_cast<PointerSym*>(rightType);
-	ArraySym* la = dynamic_cast<ArraySym*>(leftType);
-	ArraySym* ra = dynamic_cast<ArraySym*>(rightType);
-	switch (op)
+	if (!from->canConvertTo(to))
+		throw CompilerException("Cannot perform conversion", expr->token);
+	if (from == to || *from == to)
+		return expr;
+	if (!isa<ScalarSym>(from) || !isa<ScalarSym>(to))
 	{
-	case MOD_ASSIGN:
-	case AND_ASSIGN:
-	case OR_ASSIGN:
-	case XOR_ASSIGN:
-	case BITWISE_SHIFT_LEFT_ASSIGN:
-	case BITWISE_SHIFT_RIGHT_ASSIGN:	
-		if (!leftType->canConvertTo(intType) || !rightType->canConvertTo(intType))
-			throw CompilerException("Invalid operator arguments type (required int in both sides)", token->line, token->col);
-		// fallthrough
-	case ASSIGN:
-		if (leftType->isStruct() && *leftType == rightType)
-			return leftType;
-		// fallthrough
-	case MULT_ASSIGN:
-	case PLUS_ASSIGN:
-	case MINUS_ASSIGN:
-	case DIV_ASSIGN:		
-		if (!left->isModifiableLvalue())
-			throw CompilerException("Left argument of assignment must be modifiable lvalue", left->token->line, left->token->col);
-		right = makeTypeCoerce(right, rightType, leftType);
-		return leftType;
-	case DOT:
-		if (!dynamic_cast<StructSym*>(leftType))
-			throw CompilerException("Left operand of . must be a structure", left->token->line, left->token->col);
-		return rightType;
-	case ARROW:
-		if (!lp || (!dynamic_cast<StructSym*>(lp->type) && !dynamic_cast<StructSym*>(dynamic_cast<AliasSym*>(lp->type)->type)))
-			throw CompilerException("Left operand of -> must be of pointer-to-structure type", left->token->line, left->token->col);
-		return rightType;		
-	case MINUS:		
-		if (lp && rp || la && ra)
-		{
-			if (lp && rp && *lp->type != rp->type 
-				|| la && ra && *la->type != ra->type)
-				throw CompilerException("Operand types are incompatible", token->line, token->col);
-			return intType;
-		}			
-	case PLUS:
-		if (lp && rp || la && ra)
-			throw CompilerException("Cannot add two pointers", token->line, token->col);
-		if (lp || rp)
-			return lp == 0 ? rightType : leftType;
-		if (la || ra)
-			return new PointerSym(la == 0 ? ra->type : la->type);
-	default:
-		if (leftType->isStruct() || rightType->isStruct())
-			throw CompilerException("Cannot perform operation over two structures", token->line, token->col);
-		if (typePriority[maxTypeOfArgs] < max(typePriority[leftType], typePriority[rightType]))
-			throw CompilerException("Invalid type of operands", token->line, token->col);
-		left = makeTypeCoerce(left, leftType, maxTypeOfArgs);
-		right = makeTypeCoerce(right, rightType, maxTypeOfArgs);
-		if (operationReturningType.count(op))
-			return operationReturningType[op];
-		else 
-			return maxTypeOfArgs;
-	}	
+		return expr;
+	} else {
+		if (priorityOf(to) - priorityOf(from) == 1)
+			return create<CoerceNode>(nullptr, expr, to);
+		return create<CoerceNode>(nullptr, makeTypeCoerce(expr, from, intType), floatType); 
+	}
+}
+
+// isLvalue, or isModifiableLvalue when modifiable is set, decided by the node kind
+class LvalueCheck : public NodeVisitor<LvalueCheck, bool>
+{
+private:
+	bool modifiable;
+public:
+	LvalueCheck(bool m): modifiable(m) {}
+	bool visitUnaryOp(const UnaryOpNode* node);
+	bool visitPostfixUnaryOp(const PostfixUnaryOpNode* node) { return false; }
+	bool visitBinaryOp(const BinaryOpNode* node);
+	bool visitIdentifier(const IdentifierNode* node);
+	bool visitArr(const ArrNode* node);
+};
+
+bool LvalueCheck::visitUnaryOp(const UnaryOpNode* node)
+{
+	OperationsT op = node->token->op;
+	if (modifiable)
+		return (op == MULT || op == DEC || op == INC) && node->getType()->isModifiableLvalue();
+	return op == MULT || ((op == DEC || op == INC) && node->operand->isLvalue());
 }
 
-bool BinaryOpNode::isModifiableLvalue() const
+bool LvalueCheck::visitBinaryOp(const BinaryOpNode* node)
 {
-	switch (dynamic_cast<OpToken*>(token)->val)
+	switch (node->token->op)
 	{
 	case ASSIGN:
 	case PLUS_ASSIGN:
@@ -162,27 +214,104 @@ bool BinaryOpNode::isModifiableLvalue() const
 	case XOR_ASSIGN:
 	case AND_ASSIGN:
 	case OR_ASSIGN:
-		return left->isModifiableLvalue();
+		return node->left->isModifiableLvalue();
 	case DOT:
 	case ARROW:
-		return right->isModifiableLvalue();
+		return modifiable ? node->right->isModifiableLvalue() : node->right->isLvalue();
 	default:
 		return false;
 	}
 }
 
-bool BinaryOpNode::isLvalue() const
+bool LvalueCheck::visitIdentifier(const IdentifierNode* node)
 {
-	switch (dynamic_cast<OpToken*>(token)->val)
+	if (!modifiable)
+		return true;
+	TypeSym* type = node->sym->type;
+	return !isa<ConstTypeSym>(type) && !isa<FuncSym>(type) 
+		&& !isa<StructSym>(type) 
+		&& !isa<ArraySym>(type);
+}
+
+bool LvalueCheck::visitArr(const ArrNode* node)
+{
+	if (!modifiable)
+		return true;
+	TypeSym* type = node->name->getType();
+	for (int i = 0; i < node->args.size(); i++)
+		type = type->nextType();
+	return type->isModifiableLvalue();
+}
+
+// hasAddress: whether generateLvalue pushes the address of the value, so a struct is copied from there
+class AddressCheck : public NodeVisitor<AddressCheck, bool>
+{
+public:
+	bool visitUnaryOp(const UnaryOpNode* node) { return node->token->op == MULT; }
+	bool visitPostfixUnaryOp(const PostfixUnaryOpNode* node) { return false; }
+	bool visitCoerce(const CoerceNode* node) { return false; }
+	bool visitBinaryOp(const BinaryOpNode* node);
+	bool visitTernaryOp(const TernaryOpNode* node) { return false; }
+	bool visitIdentifier(const IdentifierNode* node) { return true; }
+	bool visitArr(const ArrNode* node) { return true; }
+};
+
+bool AddressCheck::visitBinaryOp(const BinaryOpNode* node)
+{
+	switch (node->token->op)
 	{
 	case DOT:
+		return visit(node->left);
 	case ARROW:
-		return right->isLvalue();
+	case ASSIGN:
+		return true;
 	default:
-		return isModifiableLvalue();
+		return false;
 	}
 }
 
+bool Node::isModifiableLvalue() const
+{
+	return LvalueCheck(true).visit(this);
+}
+
+bool Node::isLvalue() const
+{
+	return LvalueCheck(false).visit(this);
+}
+
+bool Node::hasAddress() const
+{
+	return AddressCheck().visit(this);
+}
+
+TypeSym* Node::getType() const
+{
+	if (!type)
+		type = TypeChecker().visit(this);
+	return type;
+}
+
+void EmptyNode::print(int deep) const
+{ 
+	cout << string(deep * M, ' ') << "<empty expression>" << endl;
+}
+
+string OpNode::opName() const
+{
+	char operations[][5] = { "+", "-", "*", "/", "%", "++", "--", "+=", "-=", "*=", "/=", "%=", "?", ":",
+		"&", "|", "&&", "||", "!", "^", "&=", "|=", "^=", "=", "==", "!=", ">", "<", ">=", "<=", "<<", ">>", ".", "->",
+		"<<=", ">>=", "(", ")", "[", "]", ",", "~" };
+	return string(operations[token->op]);
+}
+
+BinaryOpNode::BinaryOpNode(Token* op, Node* l, Node* r): OpNode(op), left(l), right(r) 
+{
+	kind = nodeBinaryOp;
+	if (l == 0 || r == 0)
+		throw ParserException("Lost operand", op);
+}
+
 void BinaryOpNode::print(int deep) const
 {
 	left->print(deep + 1);
@@ -198,6 +327,36 @@ bool BinaryOpNode::isAssignment(OperationsT op)
 		|| op == BITWISE_SHIFT_LEFT_ASSIGN || op == BITWISE_SHIFT_RIGHT_ASSIGN;
 }
 
+// The operation a compound assignment applies before it stores
+static OperationsT operationOf(OperationsT op)
+{
+	switch (op)
+	{
+	case PLUS_ASSIGN:
+		return PLUS;
+	case MINUS_ASSIGN:
+		return MINUS;
+	case MULT_ASSIGN:
+		return MULT;
+	case DIV_ASSIGN:
+		return DIV;
+	case MOD_ASSIGN:
+		return MOD;
+	case AND_ASSIGN:
+		return BITWISE_AND;
+	case OR_ASSIGN:
+		return BITWISE_OR;
+	case XOR_ASSIGN:
+		return BITWISE_XOR;
+	case BITWISE_SHIFT_LEFT_ASSIGN:
+		return BITWISE_SHIFT_LEFT;
+	case BITWISE_SHIFT_RIGHT_ASSIGN:
+		return BITWISE_SHIFT_RIGHT;
+	default:
+		return op;
+	}
+}
+
 bool BinaryOpNode::isComparison(OperationsT op)
 {
 	return op == EQUAL || op == LESS || op == GREATER
@@ -210,7 +369,7 @@ void BinaryOpNode::generateForFloat(AsmCode& code) const
 	left->generateLoadInFPUStack(code);
 	right->generateLoadInFPUStack(code);
 	AsmCommandsT cmd;
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
+	OperationsT op = token->op;
 	 if (isComparison(op)) 
 	 {
 		code.add(cmdFCOMPP)
@@ -260,7 +419,7 @@ void BinaryOpNode::generateForFloat(AsmCode& code) const
 			cmd = cmdFMULP;
 			break;
 		default:
-			throw CompilerException("not implemented", token->line, token->col);
+			throw CompilerException("not implemented", token);
 			break;
 		}
 		code.add(cmd);
@@ -284,15 +443,15 @@ void BinaryOpNode::generateLoadInFPUStack(AsmCode& code) const
 
 void BinaryOpNode::generate(AsmCode& code) const
 {
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
+	OperationsT op = token->op;
 	TypeSym* leftType = left->getType();
 	TypeSym* rightType = right->getType();
-	PointerSym* lp = dynamic_cast<PointerSym*>(leftType);
-	PointerSym* rp = dynamic_cast<PointerSym*>(rightType);
-	if (!lp && dynamic_cast<ArraySym*>(leftType))
-		lp = dynamic_cast<ArraySym*>(leftType)->convertToPointer();
-	if (!rp && dynamic_cast<ArraySym*>(rightType))
-		rp = dynamic_cast<ArraySym*>(rightType)->convertToPointer();
+	PointerSym* lp = dyn_cast<PointerSym>(leftType);
+	PointerSym* rp = dyn_cast<PointerSym>(rightType);
+	if (!lp && isa<ArraySym>(leftType))
+		lp = cast<ArraySym>(leftType)->convertToPointer();
+	if (!rp && isa<ArraySym>(rightType))
+		rp = cast<ArraySym>(rightType)->convertToPointer();
 	if ((op == PLUS || op == MINUS) && (lp || rp) && !(lp && rp))
 	{
 		if (!lp)
@@ -325,8 +484,35 @@ void BinaryOpNode::generate(AsmCode& code) const
 	}
 	if (op == DOT || op == ARROW) {
 			generateLvalue(code);
-			code.add(cmdPOP, EAX)
-				.add(cmdPUSH, makeIndirectArg(EAX));
+			if (isBlockCopied(getType()))
+			{
+				code.add(cmdPOP, ESI);
+				generatePushBlock(code, getType()->byteSize());
+			} else if (getType()->stackSize() > 4 || getType()->byteSize() == 1) {
+				code.add(cmdPOP, EAX);
+				generatePushDwords(code, getType()->byteSize());
+			} else
+				code.add(cmdPOP, EAX)
+					.add(cmdPUSH, makeIndirectArg(EAX));
+	} else if (op == ASSIGN && isBlockCopied(rightType)) {
+		// a struct is copied straight from where it is, or from the copy a call left on the stack
+		bool addressed = right->hasAddress();
+		if (addressed)
+			right->generateLvalue(code);
+		else
+			right->generate(code);
+		left->generateLvalue(code);
+		// rep movsd leaves edi past the copy, the value of the assignment is where it starts
+		code.add(cmdPOP, EDI)
+			.add(cmdMOV, EAX, EDI);
+		if (addressed)
+			code.add(cmdPOP, ESI);
+		else
+			code.add(cmdMOV, ESI, ESP);
+		generateBlockCopy(code, rightType->byteSize());
+		if (!addressed)
+			code.add(cmdADD, ESP, rightType->stackSize());
+		code.add(cmdPUSH, EAX);
 	} else {
 		right->generate(code);
 		if (op == ASSIGN)
@@ -336,8 +522,10 @@ void BinaryOpNode::generate(AsmCode& code) const
 			int size = right->getType()->byteSize();
 			int steps = size / 4 + (size % 4 != 0);
 			for (int i = 0; i < steps; i++)
-				code.add(cmdPOP, EBX)
-					.add(cmdMOV, makeIndirectArg(EAX, i * 4), makeArg(EBX));
+			{
+				code.add(cmdPOP, EBX);
+				generateStore(code, i * 4, min(size - i * 4, 4));
+			}
 			code.add(cmdMOV, EAX, EBX);
 		} else {
 			if (*getType() == floatType)
@@ -346,8 +534,20 @@ void BinaryOpNode::generate(AsmCode& code) const
 				return;
 			}
 			AsmArg *l, *r;
-			if (isAssignment(op))
+			bool byteTarget = isAssignment(op) && leftType->byteSize() == 1;
+			if (byteTarget)
 			{
+				// a char is computed in eax and only its byte stored, the address waits on the stack
+				left->generateLvalue(code);
+				code.add(cmdPOP, EAX)
+					.add(cmdPOP, EBX)
+					.add(cmdMOVSX, makeArg(ECX), makeIndirectArg(EAX, 0, 1))
+					.add(cmdPUSH, EAX)
+					.add(cmdMOV, EAX, ECX);
+				l = makeArg(EAX);
+				r = makeArg(EBX);
+				op = operationOf(op);
+			} else if (isAssignment(op)) {
 				left->generateLvalue(code);
 				l = makeIndirectArg(EAX);
 				r = makeArg(EBX);				
@@ -452,6 +652,9 @@ void BinaryOpNode::generate(AsmCode& code) const
 					code.add(cmdMOV, ECX, EAX)
 						.add(cmdMOV, makeArg(EAX), makeIndirectArg(ECX));
 			}
+			if (byteTarget)
+				code.add(cmdPOP, EBX)
+					.add(cmdMOV, makeIndirectArg(EBX, 0, 1), makeArg(AL));
 		}
 		code.add(cmdPUSH, EAX);
 	}
@@ -459,7 +662,7 @@ void BinaryOpNode::generate(AsmCode& code) const
 
 void BinaryOpNode::generateLvalue(AsmCode& code) const
 {
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
+	OperationsT op = token->op;
 	if (op == DOT || op == ARROW) 
 	{
 		if (op == DOT)
@@ -467,7 +670,7 @@ void BinaryOpNode::generateLvalue(AsmCode& code) const
 		else
 			left->generate(code);
 		code.add(cmdPOP, EAX)
-			.add(cmdMOV, EBX, dynamic_cast<IdentifierNode*>(right)->sym->offset)
+			.add(cmdMOV, EBX, cast<IdentifierNode>(right)->sym->offset)
 			.add(cmdADD, EAX, EBX)
 			.add(cmdPUSH, EAX);
 	} else if (isAssignment(op)) {
@@ -475,22 +678,17 @@ void BinaryOpNode::generateLvalue(AsmCode& code) const
 		code.add(cmdPOP, EAX);
 		left->generateLvalue(code);
 	} else 
-		throw CompilerException("not implemented", token->line, token->col);
+		throw CompilerException("not implemented", token);
 }
 
 void IntNode::print(int deep) const
 {
-	cout << string(deep * M, ' ') << dynamic_cast<IntegerToken*>(token)->val << endl;
+	cout << string(deep * M, ' ') << token->intVal << endl;
 }
 
 void IntNode::generate(AsmCode& code) const
 {
-	code.add(cmdPUSH, makeArg(dynamic_cast<IntegerToken*>(token)->val));
-}
-
-TypeSym* IntNode::getType() const
-{
-	return intType;
+	code.add(cmdPUSH, makeArg(token->intVal));
 }
 
 string FloatNode::constName() const
@@ -500,7 +698,7 @@ string FloatNode::constName() const
 
 void FloatNode::print(int deep) const
 {
-	cout << string(deep * M, ' ') << dynamic_cast<FloatToken*>(token)->val << endl;
+	cout << string(deep * M, ' ') << token->floatVal << endl;
 }
 
 void FloatNode::generate(AsmCode& code) const
@@ -515,7 +713,7 @@ void FloatNode::generateLvalue(AsmCode& code) const
 
 void FloatNode::generateData(AsmCode& code) const
 {
-	code.add(cmdDD, makeArgMemory(constName()), makeFloat(dynamic_cast<FloatToken*>(token)->val));
+	code.add(cmdDD, makeArgMemory(constName()), makeFloat(token->floatVal));
 }
 
 void FloatNode::generateLoadInFPUStack(AsmCode& code) const
@@ -523,11 +721,6 @@ void FloatNode::generateLoadInFPUStack(AsmCode& code) const
 	code.add(cmdFLD, makeArgMemory(constName()));
 }
 
-TypeSym* FloatNode::getType() const
-{
-	return floatType;
-}
-
 void IdentifierNode::print(int deep) const
 {
 	cout << string(deep * M, ' ') << sym->name << endl;
@@ -537,7 +730,20 @@ void IdentifierNode::generate(AsmCode& code) const
 {
 	int size = sym->byteSize();
 	int steps = size / 4 + (size % 4 != 0);
-	if (sym->global)
+	if (isa<ArraySym>(sym->getType())) // an array stands for the address of its first element
+		generateLvalue(code);
+	else if (isBlockCopied(sym->getType()))
+	{
+		generateLvalue(code);
+		code.add(cmdPOP, ESI);
+		generatePushBlock(code, size);
+	} else if (size == 1) { // a char is stored as a byte, the rest of its dword is stale
+		if (sym->global)
+			code.add(cmdMOVSX, makeArg(EAX), makeArgMemory("byte ptr [var_" + sym->name + " + 0]"));
+		else
+			code.add(cmdMOVSX, makeArg(EAX), makeIndirectArg(EBP, sym->offset, 1));
+		code.add(cmdPUSH, EAX);
+	} else if (sym->global)
 		for (int i = 0; i < steps; i++)
 			code.add(cmdPUSH, makeArgMemory("dword ptr [var_" + sym->name + " + " + to_string(4 * (steps - i - 1)) +"]"));
 	else
@@ -566,23 +772,11 @@ void IdentifierNode::generateLoadInFPUStack(AsmCode& code) const
 			.add(cmdFLD, real4);
 }
 
-TypeSym* IdentifierNode::getType() const
-{
-	return sym->getType();
-}
-
-bool IdentifierNode::isModifiableLvalue() const 
-{
-	TypeSym* type = dynamic_cast<VarSym*>(sym)->type;
-	return !dynamic_cast<ConstTypeSym*>(type) && !dynamic_cast<FuncSym*>(type) 
-		&& !dynamic_cast<StructSym*>(type) 
-		&& !dynamic_cast<ArraySym*>(type);
-}
-
 UnaryOpNode::UnaryOpNode(Token* op, Node* oper): OpNode(op), operand(oper) 
 {
+	kind = nodeUnaryOp;
 	if (!oper)
-		throw ScannerException("Lost operand", op->line, op->col);
+		throw ScannerException("Lost operand", op);
 }
 
 void UnaryOpNode::print(int deep) const
@@ -591,55 +785,9 @@ void UnaryOpNode::print(int deep) const
 	operand->print(deep + 1);
 }
 
-TypeSym* UnaryOpNode::getType() const
-{
-	TypeSym* type = operand->getType();
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
-	switch (op)
-	{
-	case MULT:
-		if (!dynamic_cast<PointerSym*>(type))
-			throw CompilerException("Type of unary operation is not a pointer", token->line, token->col);
-		return dynamic_cast<PointerSym*>(type)->type;
-	case BITWISE_AND:
-		if (!operand->isLvalue())
-			throw CompilerException("Expression must have lvalue", token->line, token->col);
-		return new PointerSym(type);
-		break;
-	case BITWISE_NOT:
-		operand = makeTypeCoerce(operand, type, intType);
-		break;
-	case LOGICAL_NOT:
-		if (dynamic_cast<StructSym*>(type))
-			throw CompilerException("Cannot perform logical not operation over structure", token->line, token->col);
-		break;
-	case DEC:
-	case INC:
-		if (!operand->isModifiableLvalue())
-			throw CompilerException("Expression must have modifiable lvalue", token->line, token->col);
-		break;
-	case MINUS:
-		if (!type->canConvertTo(floatType))
-			throw CompilerException("Expression must have arithmetic type", token->line, token->col);
-	}
-	return type;	
-}
-
-bool UnaryOpNode::isModifiableLvalue() const
-{
-	OperationsT op = dynamic_cast<OpToken*>(token)->val; 
-	return (op == MULT || op == DEC || op == INC) && getType()->isModifiableLvalue();
-}
-
-bool UnaryOpNode::isLvalue() const 
-{
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
-	return op == MULT || ((op == DEC || op == INC) && operand->isLvalue());
-}
-
 void UnaryOpNode::generate(AsmCode& code) const
 {
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
+	OperationsT op = token->op;
 	if (op == BITWISE_AND)
 		operand->generateLvalue(code);
 	else if (op == INC || op == DEC) {
@@ -652,7 +800,7 @@ void UnaryOpNode::generate(AsmCode& code) const
 			generateST0ToStack(code);			
 		} else {
 			code.add(cmdPOP, EAX);
-			PointerSym* pointer = dynamic_cast<PointerSym*>(operand->getType()); 
+			PointerSym* pointer = dyn_cast<PointerSym>(operand->getType()); 
 			if (pointer)
 				code.add(cmdMOV, EBX, pointer->type->byteSize())
 					.add(op == INC ? cmdADD : cmdSUB, EAX, EBX);
@@ -662,9 +810,12 @@ void UnaryOpNode::generate(AsmCode& code) const
 		}
 		operand->generateLvalue(code);
 		code.add(cmdPOP, EBX)
-			.add(cmdPOP, EAX)
-			.add(cmdMOV, makeIndirectArg(EBX), makeArg(EAX))
-			.add(cmdPUSH, EAX);
+			.add(cmdPOP, EAX);
+		if (operand->getType()->byteSize() == 1)
+			code.add(cmdMOV, makeIndirectArg(EBX, 0, 1), makeArg(AL));
+		else
+			code.add(cmdMOV, makeIndirectArg(EBX), makeArg(EAX));
+		code.add(cmdPUSH, EAX);
 	} else if (op == LOGICAL_NOT) {
 		operand->generate(code);
 		code.add(cmdPOP, EAX)
@@ -688,19 +839,20 @@ void UnaryOpNode::generate(AsmCode& code) const
 			code.add(cmdNOT, EAX)
 				.add(cmdPUSH, EAX);
 		else if (op == MULT) {
-			int size = operand->getType()->nextType()->byteSize();
-			int steps = size / 4 + (size % 4 != 0);
-			code.add(cmdMOV, EBX, EAX);
-			for (int i = 0; i < steps; i++)
-				code.add(cmdMOV, makeArg(EAX), makeIndirectArg(EBX, (steps - i - 1) * 4))
-					.add(cmdPUSH, EAX);
+			TypeSym* type = operand->getType()->nextType();
+			if (isBlockCopied(type))
+			{
+				code.add(cmdMOV, ESI, EAX);
+				generatePushBlock(code, type->byteSize());
+			} else
+				generatePushDwords(code, type->byteSize());
 		}
 	}
 }
 
 void UnaryOpNode::generateLvalue(AsmCode& code) const
 {
-	OperationsT op = dynamic_cast<OpToken*>(token)->val;
+	OperationsT op = token->op;
 	switch (op)
 	{
 	case MULT:
@@ -759,11 +911,6 @@ void CoerceNode::generateLoadInFPUStack(AsmCode& code) const
 	generateByteToFPU(code);
 }
 
-TypeSym* CoerceNode::getType() const
-{
-	return type;
-}
-
 void FunctionalNode::printArgs(int deep) const
 {
 	for (int i = 0; i < args.size(); i++)
@@ -790,33 +937,21 @@ void FuncCallNode::print(int deep) const
 
 void FuncCallNode::generate(AsmCode& code) const
 {
-	code.add(cmdSUB, ESP, symbol->val->byteSize());	
+	code.add(cmdSUB, ESP, symbol->val->stackSize());	
 	for (int i = args.size() - 1; i > -1; i--)
-		args[i]->generate(code);
-	code.add(cmdCALL, makeLabel("f_" + name->token->text))
-		.add(cmdADD, ESP, symbol->params->byteSize());
-}
-
-TypeSym* FuncCallNode::getType() const
-{
-	FuncSym* sym = dynamic_cast<FuncSym*>(symbol);
-	int formalParametersCount = sym->params->size();
-	int realParametersCount = args.size();
-	if (formalParametersCount != realParametersCount)
-		throw CompilerException("Incorrect parameters count", token->line, token->col);
-	for (int i = 0; i < formalParametersCount; i++)
 	{
-		TypeSym* realParamType = args[i]->getType();
-		TypeSym* formalParamType = sym->params->symbols[i]->getType();
-		if (dynamic_cast<AliasSym*>(realParamType))
-			realParamType = realParamType->getType();
-		if (dynamic_cast<AliasSym*>(formalParamType))
-			formalParamType = formalParamType->getType();
-		if (!realParamType->canConvertTo(formalParamType))
-			throw CompilerException("Invalid type of parameter", args[i]->token->line, args[i]->token->col);
-		args[i] = makeTypeCoerce(args[i], realParamType, formalParamType);
+		// an assignment pushes only where its struct went, the struct is copied from there
+		TypeSym* type = args[i]->getType();
+		if (isBlockCopied(type) && args[i]->hasAddress())
+		{
+			args[i]->generateLvalue(code);
+			code.add(cmdPOP, ESI);
+			generatePushBlock(code, type->byteSize());
+		} else
+			args[i]->generate(code);
 	}
-	return symbol->getType();
+	code.add(cmdCALL, makeLabel("f_" + name->token->text()))
+		.add(cmdADD, ESP, symbol->params->byteSize());
 }
 
 void ArrNode::print(int deep) const 
@@ -830,16 +965,24 @@ void ArrNode::print(int deep) const
 void ArrNode::generate(AsmCode& code) const
 {
 	generateLvalue(code);
-	code.add(cmdPOP, EAX)
-		.add(cmdPUSH, makeIndirectArg(EAX));
+	if (isBlockCopied(getType()))
+	{
+		code.add(cmdPOP, ESI);
+		generatePushBlock(code, getType()->byteSize());
+	} else if (getType()->stackSize() > 4 || getType()->byteSize() == 1) {
+		code.add(cmdPOP, EAX);
+		generatePushDwords(code, getType()->byteSize());
+	} else
+		code.add(cmdPOP, EAX)
+			.add(cmdPUSH, makeIndirectArg(EAX));
 }
 
 void ArrNode::generateLvalue(AsmCode& code) const
 {
 	TypeSym* nameType = name->getType();
-	if (dynamic_cast<ArraySym*>(nameType))
+	if (isa<ArraySym>(nameType))
 		name->generateLvalue(code);
-	else if (dynamic_cast<PointerSym*>(nameType))
+	else if (isa<PointerSym>(nameType))
 		name->generate(code);
 	TypeSym* type = nameType->nextType();
 	for (int i = 0; i < args.size(); i++)
@@ -855,34 +998,6 @@ void ArrNode::generateLvalue(AsmCode& code) const
 	}
 }
 
-TypeSym* ArrNode::getType() const
-{
-	TypeSym* sym = dynamic_cast<ArraySym*>(name->getType());
-	if (!sym)
-		sym = dynamic_cast<PointerSym*>(name->getType());
-	if (!sym)
-		throw CompilerException("Expression must have a pointer-to-object type", name->token->line, name->token->col);
-	TypeSym* type = sym;
-	for (int i = 0; i < args.size(); i++)
-	{
-		type = type->nextType();
-		if (type == 0)
-			throw CompilerException("Expression must have a pointer-to-object type", args[i]->token->line, args[i]->token->col);
-		if (!args[i]->getType()->canConvertTo(intType))
-			throw CompilerException("Expression must have integral type", args[i]->token->line, args[i]->token->col);
-		args[i] = makeTypeCoerce(args[i], args[i]->getType(), intType);			
-	}
-	return type;
-}
-
-bool ArrNode::isModifiableLvalue() const
-{
-	TypeSym* type = name->getType();
-	for (int i = 0; i < args.size(); i++)
-		type = type->nextType();
-	return type->isModifiableLvalue();
-}
-
 void IOOperatorNode::generate(AsmCode& code) const
 {
 	int size = 0;
@@ -890,7 +1005,7 @@ void IOOperatorNode::generate(AsmCode& code) const
 	{
 		TypeSym* type = args[i]->getType();
 		args[i]->generate(code);
-		size += type->byteSize();
+		size += isa<ArraySym>(type) ? 4 : type->stackSize(); // an array goes as its address
 		if (*type == floatType)
 		{
 			code.add(cmdPOP, real4)
@@ -902,14 +1017,14 @@ void IOOperatorNode::generate(AsmCode& code) const
 			size += 4;
 		}
 	}
-	code.add(token->val, makeArgMemory("str" + to_string(format->index)));
+	code.add(token->op, makeArgMemory("str" + to_string(format->index)));
 	code.add(cmdADD, ESP, size);
 }
 
 void IOOperatorNode::print(int deep) const
 {
 	string tab(deep * M, ' ');
-	cout << tab << token->text << "(" << endl;
+	cout << tab << token->text() << "(" << endl;
 	format->print(deep + 1);
 	if (args.size() > 0)
 	{
@@ -921,7 +1036,7 @@ void IOOperatorNode::print(int deep) const
 
 string KeywordNode::KeywordName() const
 {
-	return token->text;
+	return token->text();
 }
 
 void KeywordNode::print(int deep) const
@@ -931,32 +1046,22 @@ void KeywordNode::print(int deep) const
 
 void CharNode::print(int deep) const
 {
-	cout << string(deep * M, ' ') << '\'' << dynamic_cast<CharToken*>(token)->val << '\'' << endl; 
+	cout << string(deep * M, ' ') << '\'' << token->charVal << '\'' << endl; 
 }
 
 void CharNode::generate(AsmCode& code) const
 {
-
-}
-
-TypeSym* CharNode::getType() const
-{
-	return charType;
+	code.add(cmdPUSH, makeArg(token->charVal));
 }
 
 void StringNode::print(int deep) const 
 { 
-	cout << string(deep * M, ' ') << '"' << dynamic_cast<StringToken*>(token)->val << '"' << endl; 
+	cout << string(deep * M, ' ') << '"' << token->stringVal() << '"' << endl; 
 }
 
 void StringNode::generateData(AsmCode& code) const
 {
-	code.add(cmdDB, makeArgMemory("str" + to_string(index)), makeString(token->text));
-}
-
-TypeSym* StringNode::getType() const
-{
-	return stringType;
+	code.add(cmdDB, makeArgMemory("str" + to_string(index)), makeString(token->text()));
 }
 
 void TernaryOpNode::print(int deep) const
@@ -14,31 +14,60 @@ extern string real8name;
 extern AsmArgMemory* real4;
 extern AsmArgMemory* real8;
 
+bool isBlockCopied(TypeSym* type);
+void generateBlockCopy(AsmCode& code, int size);
+
+// Kind tag of every concrete node. Subclasses follow their base, so the classof of an
+// intermediate class checks a range
+typedef enum {
+	nodeEmpty,
+	nodeUnaryOp,
+	nodePostfixUnaryOp,
+	nodeCoerce,
+	nodeBinaryOp,
+	nodeTernaryOp,
+	nodeInt,
+	nodeFloat,
+	nodeIdentifier,
+	nodeFuncCall,
+	nodeArr,
+	nodeIOOperator,
+	nodeKeyword,
+	nodeChar,
+	nodeString,
+} NodeKindT;
+
 class Node
 {
 protected:
 	void generateByteToFPU(AsmCode& code) const;
 	void generateST0ToStack(AsmCode& code) const;
+	void generatePushBlock(AsmCode& code, int size) const;
+	void generatePushDwords(AsmCode& code, int size) const;
 public:
 	Token* token;
+	NodeKindT kind;
+	mutable TypeSym* type; // resolved by the first getType, 0 until then
 	friend class Parser;
-	Node(): token(0) {}
-	Node(Token* t): token(t) {}
+	Node(): token(0), type(0) {}
+	Node(Token* t): token(t), type(0) {}
 	virtual void print(int deep = 0) const = 0;
 	virtual void generate(AsmCode& code) const {}
 	virtual void generateLvalue(AsmCode& code) const {}
 	virtual void generateLoadInFPUStack(AsmCode& code) const {}
 	virtual void setType(PointerSym* type) {}
-	virtual bool isModifiableLvalue() const { return false; }
-	virtual bool isLvalue() const { return false; }
-	virtual TypeSym* getType() const { return 0; }
+	bool isModifiableLvalue() const;
+	bool isLvalue() const;
+	bool hasAddress() const;
+	TypeSym* getType() const;
 	static Node* makeTypeCoerce(Node* expr, TypeSym* from, TypeSym* to);
 };
 
 class EmptyNode : public Node
 {
 public:
-	EmptyNode(): Node(0) {}
+	EmptyNode(): Node(0) { kind = nodeEmpty; }
+	static bool classof(const Node* node) { return node->kind == nodeEmpty; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const {}
 };
@@ -49,6 +78,7 @@ protected:
 	string opName() const;
 public:
 	OpNode(Token* op): Node(op) {}
+	static bool classof(const Node* node) { return node->kind >= nodeUnaryOp && node->kind <= nodeTernaryOp; }
 	virtual void print(int deep) {}
 };
 
@@ -57,11 +87,12 @@ class UnaryOpNode : public OpNode
 protected:
 	mutable Node* operand;
 public:
+	friend class LvalueCheck;
+	friend class TypeChecker;
+	friend class IRBuilder;
 	UnaryOpNode(Token* op, Node* oper);
+	static bool classof(const Node* node) { return node->kind >= nodeUnaryOp && node->kind <= nodeCoerce; }
 	void print(int deep) const;
-	TypeSym* getType() const;
-	bool isModifiableLvalue() const;
-	bool isLvalue() const;
 	virtual void generate(AsmCode& code) const;
 	void generateLvalue(AsmCode& code) const;
 	void generateLoadInFPUStack(AsmCode& code) const;
@@ -70,21 +101,18 @@ public:
 class PostfixUnaryOpNode : public UnaryOpNode
 {
 public:
-	PostfixUnaryOpNode(Token* op, Node* oper): UnaryOpNode(op, oper) {}
+	PostfixUnaryOpNode(Token* op, Node* oper): UnaryOpNode(op, oper) { kind = nodePostfixUnaryOp; }
+	static bool classof(const Node* node) { return node->kind == nodePostfixUnaryOp; }
 	void print(int deep) const;
-	bool isLvalue() const { return false; }
-	bool isModifiableLvalue() const { return false; }
 	void generate(AsmCode& code) const;
 };
 
 class CoerceNode : public UnaryOpNode
 {
-private:
-	TypeSym* type;
 public:
-	CoerceNode(Token* op, Node* oper, TypeSym* ts): UnaryOpNode(op, oper), type(ts) {}
+	CoerceNode(Token* op, Node* oper, TypeSym* ts): UnaryOpNode(op, oper) { kind = nodeCoerce; type = ts; }
+	static bool classof(const Node* node) { return node->kind == nodeCoerce; }
 	void print(int deep) const;
-	virtual TypeSym* getType() const;
 	void generate(AsmCode& code) const;
 	void generateLoadInFPUStack(AsmCode& code) const;
 };
@@ -98,15 +126,17 @@ protected:
 	static bool isComparison(OperationsT op);
 public:	
 	friend class Parser;
+	friend class LvalueCheck;
+	friend class AddressCheck;
+	friend class TypeChecker;
+	friend class IRBuilder;
 	BinaryOpNode(Token* op, Node* l, Node* r);
-	bool isModifiableLvalue() const;
-	bool isLvalue() const;
+	static bool classof(const Node* node) { return node->kind == nodeBinaryOp || node->kind == nodeTernaryOp; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
 	void generateLvalue(AsmCode& code) const;
 	void generateForFloat(AsmCode& code) const;
 	void generateLoadInFPUStack(AsmCode& code) const;
-	virtual TypeSym* getType() const;	
 };
 
 class TernaryOpNode : public BinaryOpNode
@@ -114,17 +144,19 @@ class TernaryOpNode : public BinaryOpNode
 private:
 	Node* condition;
 public:
-	TernaryOpNode(Token* op, Node* c, Node* l, Node* r): BinaryOpNode(op, l, r), condition(c) {}
+	friend class IRBuilder;
+	TernaryOpNode(Token* op, Node* c, Node* l, Node* r): BinaryOpNode(op, l, r), condition(c) { kind = nodeTernaryOp; }
+	static bool classof(const Node* node) { return node->kind == nodeTernaryOp; }
 	void print(int deep) const;
 };
 
 class IntNode : public Node
 {
 public:	
-	IntNode(Token* t): Node(t) {}
+	IntNode(Token* t): Node(t) { kind = nodeInt; }
+	static bool classof(const Node* node) { return node->kind == nodeInt; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
-	virtual TypeSym* getType() const;	
 };
 
 class FloatNode : public Node
@@ -132,28 +164,27 @@ class FloatNode : public Node
 private:
 	string constName() const;
 public:	
+	friend class IRBuilder;
 	int index;
-	FloatNode(Token* t, int idx): Node(t), index(idx) {}
+	FloatNode(Token* t, int idx): Node(t), index(idx) { kind = nodeFloat; }
+	static bool classof(const Node* node) { return node->kind == nodeFloat; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
 	void generateLoadInFPUStack(AsmCode& code) const;
 	void generateLvalue(AsmCode& code) const;
 	void generateData(AsmCode& code) const;
-	virtual TypeSym* getType() const;
 };
 
 class IdentifierNode : public Node
 {
 public:		
 	VarSym* sym;
-	IdentifierNode(Token* t, VarSym* s): Node(t), sym(s) {}
+	IdentifierNode(Token* t, VarSym* s): Node(t), sym(s) { kind = nodeIdentifier; }
+	static bool classof(const Node* node) { return node->kind == nodeIdentifier; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
 	void generateLvalue(AsmCode& code) const;
 	void generateLoadInFPUStack(AsmCode& code) const;
-	bool isModifiableLvalue() const;
-	bool isLvalue() const { return true; }
-	virtual TypeSym* getType() const;
 };
 
 class FunctionalNode : public Node
@@ -163,7 +194,11 @@ protected:
 	mutable vector<Node*> args;
 	void printArgs(int deep) const;
 public:
+	friend class LvalueCheck;
+	friend class TypeChecker;
+	friend class IRBuilder;
 	FunctionalNode(Token* tok, Node* n): Node(tok), name(n), args(0) {}
+	static bool classof(const Node* node) { return node->kind >= nodeFuncCall && node->kind <= nodeIOOperator; }
 	void generateLoadInFPUStack(AsmCode& code) const;
 	void addArg(Node* arg) { args.push_back(arg); }
 };
@@ -173,32 +208,34 @@ class FuncCallNode : public FunctionalNode
 private:
 	FuncSym* symbol;
 public:
-	FuncCallNode(Token* t, Node* func, FuncSym* funcsym): FunctionalNode(t, func), symbol(funcsym) {}
+	friend class TypeChecker;
+	friend class IRBuilder;
+	FuncCallNode(Token* t, Node* func, FuncSym* funcsym): FunctionalNode(t, func), symbol(funcsym) { kind = nodeFuncCall; }
+	static bool classof(const Node* node) { return node->kind == nodeFuncCall; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
-	virtual TypeSym* getType() const;	
 };
 
 class ArrNode : public FunctionalNode
 {
 public:
-	ArrNode(Token* t, Node* arr): FunctionalNode(t, arr) {}
+	ArrNode(Token* t, Node* arr): FunctionalNode(t, arr) { kind = nodeArr; }
+	static bool classof(const Node* node) { return node->kind == nodeArr; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
 	void generateLvalue(AsmCode& code) const;
-	bool isModifiableLvalue() const;
-	bool isLvalue() const { return true; }
-	TypeSym* getType() const;	
 };
 
 class IOOperatorNode : public FunctionalNode
 {
 private:
-	OpToken* token;
+	Token* token;
 	StringNode* format;
 public:
 	friend class Parser;
-	IOOperatorNode(OpToken* tok, StringNode* f): token(tok), format(f), FunctionalNode(0, 0) {}
+	friend class IRBuilder;
+	IOOperatorNode(Token* tok, StringNode* f): token(tok), format(f), FunctionalNode(0, 0) { kind = nodeIOOperator; }
+	static bool classof(const Node* node) { return node->kind == nodeIOOperator; }
 	void generate(AsmCode& code) const;
 	void print(int deep) const;
 };
@@ -208,7 +245,8 @@ class KeywordNode : public Node
 private:
 	string KeywordName() const;
 public:
-	KeywordNode(Token* t): Node(t) {}
+	KeywordNode(Token* t): Node(t) { kind = nodeKeyword; }
+	static bool classof(const Node* node) { return node->kind == nodeKeyword; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const {}
 };
@@ -216,20 +254,20 @@ public:
 class CharNode : public Node
 {
 public:
-	CharNode(Token* t): Node(t) {}
+	CharNode(Token* t): Node(t) { kind = nodeChar; }
+	static bool classof(const Node* node) { return node->kind == nodeChar; }
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
-	virtual TypeSym* getType() const;
 };
 
 class StringNode : public Node
 {	
 public:
 	int index;
-	StringNode(Token* t, int idx): Node(t), index(idx) {}
+	StringNode(Token* t, int idx): Node(t), index(idx) { kind = nodeString; }
+	static bool classof(const Node* node) { return node->kind == nodeString; }
 	void print(int deep) const;
 	void generateData(AsmCode& code) const;
-	virtual TypeSym* getType() const;
 };
 
 typedef Node* NodeP;
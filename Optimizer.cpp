@@ -77,10 +77,10 @@ bool Neg2MovOppositeOptimization::optimize(AsmCode& code, int index)
 		prepare(code[index], code[index + 1]) 
 		&& *cmd1 == cmdMOV && *cmd1->firstArg() == EAX
 		&& *cmd2 == cmdNEG && *cmd2->argument() == EAX
-		&& dynamic_cast<AsmArgImmediate*>(cmd1->secondArg())
+		&& isa<AsmArgImmediate>(cmd1->secondArg())
 		)
 	{
-		int val = dynamic_cast<AsmArgImmediate*>(cmd1->secondArg())->value;
+		int val = cast<AsmArgImmediate>(cmd1->secondArg())->value;
 		AsmCmd2* optCmd = new AsmCmd2(cmdMOV, makeArg(EAX), makeArg(-val));
 		code.deleteRange(index, index + 1);
 		code.insertBefore(optCmd, index);
@@ -157,8 +157,8 @@ bool MultIntByInt2MovOptimization::optimize(AsmCode& code, int index)
 		&& *cmd3 == cmdIMUL
 		)
 	{
-		int val1 = dynamic_cast<AsmArgImmediate*>(cmd1->secondArg())->value,
-			val2 = dynamic_cast<AsmArgImmediate*>(cmd2->secondArg())->value;
+		int val1 = cast<AsmArgImmediate>(cmd1->secondArg())->value,
+			val2 = cast<AsmArgImmediate>(cmd2->secondArg())->value;
 		AsmCmd2* optCmd = new AsmCmd2(cmdMOV, cmd3->firstArg(), makeArg(val1 * val2));
 		code.deleteRange(index, index + 2);
 		code.insertBefore(optCmd, index);
@@ -203,10 +203,10 @@ bool CompactAdditionOptimization::optimize(AsmCode& code, int index)
 
 bool Mov2MemoryDirectlyOptimization::optimize(AsmCode& code, int index)
 {
-	AsmCmd2* cmd1 = dynamic_cast<AsmCmd2*>(code[index]);
-	AsmCmd2* cmd2 = dynamic_cast<AsmCmd2*>(code[index + 1]);
-	AsmCmd2* cmd3 = dynamic_cast<AsmCmd2*>(code[index + 2]);
-	AsmCmd2* cmd4 = dynamic_cast<AsmCmd2*>(code[index + 3]);
+	AsmCmd2* cmd1 = dyn_cast<AsmCmd2>(code[index]);
+	AsmCmd2* cmd2 = dyn_cast<AsmCmd2>(code[index + 1]);
+	AsmCmd2* cmd3 = dyn_cast<AsmCmd2>(code[index + 2]);
+	AsmCmd2* cmd4 = dyn_cast<AsmCmd2>(code[index + 3]);
 	if (
 		cmd1 && *cmd1->firstArg() == EAX && cmd1->secondArg()->isOffset()
 		&& cmd2 && *cmd2->firstArg() == EBX && cmd2->secondArg()->isImmediate()
@@ -247,11 +247,19 @@ Optimizer::Optimizer(): oneOpOpts(0), twoOpOpts(0), threeOpOpts(0), fourOpOpts(0
 	postTwoOpOpts.push_back(new MovCycle2NilOptimization());
 }
 
+Optimizer::~Optimizer()
+{
+	vector<Optimization*>* groups[] = { &oneOpOpts, &twoOpOpts, &threeOpOpts, &fourOpOpts, &postTwoOpOpts };
+	for (int i = 0; i < sizeof(groups) / sizeof(groups[0]); i++)
+		for (int j = 0; j < groups[i]->size(); j++)
+			delete (*groups[i])[j];
+}
+
 void Optimizer::pushDownPopUp(AsmCode& code)
 {
 	for (int i = 0; i < code.size(); i++)
 	{
-		AsmCmd1* cmd = dynamic_cast<AsmCmd1*>(code[i]);
+		AsmCmd1* cmd = dyn_cast<AsmCmd1>(code[i]);
 		if (cmd && *cmd == cmdPUSH)
 		{			
 			int j = i;
@@ -273,7 +281,7 @@ void Optimizer::deleteUselessMovs(AsmCode& code)
 	{
 		if (*code[i] != cmdMOV || !code[i]->usesRegister(EAX))
 			continue;
-		AsmCmd2* cmd = dynamic_cast<AsmCmd2*>(code[i]);
+		AsmCmd2* cmd = dyn_cast<AsmCmd2>(code[i]);
 		if (cmd->secondArg()->usesRegister(EAX))
 			continue;
 		if (*cmd->firstArg() != EAX)
@@ -286,9 +294,9 @@ void Optimizer::deleteUselessMovs(AsmCode& code)
 				if (*code[idx] != cmdMOV)
 					deletingNedeed = false;
 				else {
-					AsmCmd2* tmp = dynamic_cast<AsmCmd2*>(code[idx]);
+					AsmCmd2* tmp = cast<AsmCmd2>(code[idx]);
 					if (tmp->secondArg()->usesRegister(EAX)
-						|| dynamic_cast<AsmArgIndirect*>(tmp->firstArg()))
+						|| isa<AsmArgIndirect>(tmp->firstArg()))
 						deletingNedeed = false;
 					else
 						break;
@@ -300,12 +308,14 @@ void Optimizer::deleteUselessMovs(AsmCode& code)
 	}
 }
 
-void Optimizer::deleteUselessLabels(AsmCode& code) 
+// Labels in calledLabels are called from other code and stay
+void Optimizer::deleteUselessLabels(AsmCode& code, const set<NameIdT>& calledLabels) 
 {
+	NameIdT startLabel = Interner::current().intern("start");
 	for (int i = 0; i < code.size(); i++)
 	{
-		AsmLabel* label = dynamic_cast<AsmLabel*>(code[i]);
-		if (!label || *label == string("start"))
+		AsmLabel* label = dyn_cast<AsmLabel>(code[i]);
+		if (!label || *label == startLabel || calledLabels.count(label->label->labelName()))
 			continue;
 		bool unused = true;
 		for (int j = 0; j < code.size() && unused; j++)
@@ -314,7 +324,7 @@ void Optimizer::deleteUselessLabels(AsmCode& code)
 				continue;
 			if (code[j]->isJump())
 			{
-				AsmArgLabel* dstn = dynamic_cast<AsmArgLabel*>(dynamic_cast<AsmCmd1*>(code[j])->argument());
+				AsmArgLabel* dstn = dyn_cast<AsmArgLabel>(cast<AsmCmd1>(code[j])->argument());
 				unused = *label->label != dstn;
 			}
 		}
@@ -323,7 +333,19 @@ void Optimizer::deleteUselessLabels(AsmCode& code)
 	}
 }
 
-void Optimizer::optimize(AsmCode& code)
+// Labels the calls in code go to
+void Optimizer::collectCalls(AsmCode& code, set<NameIdT>& calledLabels)
+{
+	for (int i = 0; i < code.size(); i++)
+	{
+		AsmCmd1* cmd = dyn_cast<AsmCmd1>(code[i]);
+		AsmArgLabel* dstn = cmd && *cmd == cmdCALL ? dyn_cast<AsmArgLabel>(cmd->argument()) : 0;
+		if (dstn)
+			calledLabels.insert(dstn->labelName());
+	}
+}
+
+void Optimizer::optimize(AsmCode& code, const set<NameIdT>& calledLabels)
 {
 	while (1)
 	{
@@ -353,7 +375,7 @@ void Optimizer::optimize(AsmCode& code)
 			break;
 	}
 	deleteUselessMovs(code);
-	deleteUselessLabels(code);
+	deleteUselessLabels(code, calledLabels);
 	while (1)
 	{
 		bool goToNextIteration = false;
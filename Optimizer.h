@@ -2,6 +2,7 @@
 #define OPTIMIZER_H
 
 #include <vector>
+#include <set>
 #include "Commands.h"
 
 using namespace std;
@@ -9,6 +10,7 @@ using namespace std;
 class Optimization
 {
 public:
+	virtual ~Optimization() {}
 	virtual bool optimize(AsmCode& code, int index) = 0;
 };
 
@@ -21,7 +23,7 @@ public:
 	OneOperationOptimization(): cmd1(0) {}
 	bool prepare(AsmInstruction* ins) 
 	{
-		cmd1 = dynamic_cast<Type1*>(ins);
+		cmd1 = dyn_cast<Type1>(ins);
 		return cmd1 != 0;
 	}
 };
@@ -35,7 +37,7 @@ public:
 	TwoOperationOptimization(): cmd2(0) {}
 	bool prepare(AsmInstruction* ins1, AsmInstruction* ins2)
 	{
-		cmd2 = dynamic_cast<Type2*>(ins2);
+		cmd2 = dyn_cast<Type2>(ins2);
 		return OneOperationOptimization<Type1>::prepare(ins1) && cmd2 != 0;
 	}
 };
@@ -49,7 +51,7 @@ public:
 	ThreeOperationOptimization(): cmd3(0) {}
 	bool prepare(AsmInstruction* ins1, AsmInstruction* ins2, AsmInstruction* ins3)
 	{
-		cmd3 = dynamic_cast<Type3*>(ins3);
+		cmd3 = dyn_cast<Type3>(ins3);
 		return TwoOperationOptimization<Type1, Type2>::prepare(ins1, ins2) && cmd3 != 0;
 	}
 };
@@ -156,10 +158,12 @@ private:
 	vector<Optimization*> postTwoOpOpts;
 	void pushDownPopUp(AsmCode& code);
 	void deleteUselessMovs(AsmCode& code);
-	void deleteUselessLabels(AsmCode& code);
+	void deleteUselessLabels(AsmCode& code, const set<NameIdT>& calledLabels);
 public:
 	Optimizer();
-	void optimize(AsmCode& code);
+	~Optimizer();
+	void optimize(AsmCode& code, const set<NameIdT>& calledLabels = set<NameIdT>());
+	static void collectCalls(AsmCode& code, set<NameIdT>& calledLabels);
 };
 
 
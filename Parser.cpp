@@ -1,140 +1,85 @@
 #include <iostream>
+#include <algorithm>
+#include <thread>
 #include "Parser.h"
 
 using namespace std;
 
-Parser::Parser(Scanner& scanner, CodeGenerator& codeGen): lexer(scanner), generator(codeGen), optimizer(), 
-	nameCounter(0), stringConsts(0), parsingFunc(0), parsingCycle(0)
-{ 
-	lexer.next(); 
-	
-	priorityTable[PARENTHESIS_FRONT] = 15;
-	priorityTable[BRACKET_FRONT] = 15;
-	priorityTable[ARROW] = 15;
-	priorityTable[DOT] = 15;
+// Thrown where the parse of a deferred body stops matching the serial one; serial parsing goes on
+// from the body of func
+typedef struct {
+	VarSym* sym;
+	FuncSym* func;
+} DivergenceT;
 
-	priorityTable[LOGICAL_NOT] = 14;
-	priorityTable[BITWISE_NOT] = 14;
-	priorityTable[INC] = 14;
-	priorityTable[DEC] = 14;
+// Binding power of every operation, indexed by OperationsT. Binary operations bind at the level
+// of their power, 0 is for the ones that never bind, 16 is an operand
+static const int factorPriority = 16;
 
-	priorityTable[MULT] = 13;
-	priorityTable[DIV] = 13;
-	priorityTable[MOD] = 13;
+static const int priorities[SCANF + 1] = {
+	12, 12, 13, 13, 13, 14, 14,			// + - * / % ++ --
+	2, 2, 2, 2, 2, 3, 0,				// += -= *= /= %= ? :
+	8, 6, 5, 4, 14, 7,					// & | && || ! ^
+	2, 2, 2, 2, 9, 9,					// &= |= ^= = == !=
+	10, 10, 10, 10, 11, 11, 15, 15,		// > < >= <= << >> . ->
+	2, 2, 15, 0, 15, 0, 1, 14,			// <<= >>= ( ) [ ] , ~
+	0, 0, 0								// OPERATIONS_COUNT printf scanf
+};
 
-	priorityTable[PLUS] = 12;
-	priorityTable[MINUS] = 12;
+// Laid out in rows like priorities
+static const bool unaryOps[SCANF + 1] = {
+	true, true, true, false, false, true, true,
+	false, false, false, false, false, false, false,
+	true, false, false, false, true, false,
+	false, false, false, false, false, false,
+	false, false, false, false, false, false, false, false,
+	false, false, false, false, false, false, false, true,
+	false, false, false
+};
 
-	priorityTable[BITWISE_SHIFT_LEFT] = 11;
-	priorityTable[BITWISE_SHIFT_RIGHT] = 11;
+static const bool rightAssocOps[SCANF + 1] = {
+	false, false, true, false, false, false, false,
+	true, true, true, true, true, true, false,
+	true, false, false, false, true, false,
+	true, true, true, true, false, false,
+	false, false, false, false, false, false, false, false,
+	true, true, false, false, false, false, false, true,
+	false, false, false
+};
 
-	priorityTable[LESS] = 10;
-	priorityTable[LESS_OR_EQUAL] = 10;
-	priorityTable[GREATER] = 10;
-	priorityTable[GREATER_OR_EQUAL] = 10;
+Parser::Parser(Scanner& scanner, CodeGenerator& codeGen): lexer(scanner), generator(codeGen), 
+	literals(scanner.literals), names(&Interner::current()), sources(&SourceMap::current()), 
+	nameCounter(0), stringConsts(0), stringsBase(0), floatsBase(0), parsingFunc(0), parsingCycle(0), 
+	owner(0), deferring(false), threadsCount(1), packStructs(false), throughIR(false)
+{ 
+	arena.activate();
+	types.activate();
+	literals->activate();
+	lexer.next(); 
+	
+	tableStack.push(predefinedTypes);
+	tableStack.push(create<SymTable>());
+}
 
-	priorityTable[EQUAL] = 9;
-	priorityTable[NOT_EQUAL] = 9;
+// The lexer's literals may outlive the parser, its arena and types go with it
+Parser::~Parser()
+{
+	if (!owner)
+		literals->deactivate();
+}
 
-	priorityTable[BITWISE_AND] = 8;
-	
-	priorityTable[BITWISE_XOR] = 7;
-
-	priorityTable[BITWISE_OR] = 6;
-
-	priorityTable[LOGICAL_AND] = 5;
-
-	priorityTable[LOGICAL_OR] = 4;
-
-	priorityTable[QUESTION] = 3;
-	priorityTable[COLON] = 0; 
-
-	priorityTable[ASSIGN] = 2;
-	priorityTable[PLUS_ASSIGN] = 2;
-	priorityTable[MINUS_ASSIGN] = 2;
-	priorityTable[MULT_ASSIGN] = 2;
-	priorityTable[DIV_ASSIGN] = 2;
-	priorityTable[MOD_ASSIGN] = 2;
-	priorityTable[AND_ASSIGN] = 2;
-	priorityTable[OR_ASSIGN] = 2;
-	priorityTable[XOR_ASSIGN] = 2;
-	priorityTable[AND_ASSIGN] = 2;
-	priorityTable[OR_ASSIGN] = 2;
-	priorityTable[BITWISE_SHIFT_LEFT_ASSIGN] = 2;
-	priorityTable[BITWISE_SHIFT_RIGHT_ASSIGN] = 2;
-
-	priorityTable[COMMA] = 1;
-
-	unaryOps[LOGICAL_NOT] = true;
-	unaryOps[MULT] = true; 
-	unaryOps[INC] = true;
-	unaryOps[DEC] = true;
-	unaryOps[BITWISE_AND] = true; 
-	unaryOps[PLUS] = true;
-	unaryOps[MINUS] = true;
-	unaryOps[BITWISE_NOT] = true;
-
-	rightAssocOps[ASSIGN] = true;
-	rightAssocOps[PLUS_ASSIGN] = true;
-	rightAssocOps[MINUS_ASSIGN] = true;
-	rightAssocOps[MULT_ASSIGN] = true;
-	rightAssocOps[DIV_ASSIGN] = true;
-	rightAssocOps[MOD_ASSIGN] = true;
-	rightAssocOps[AND_ASSIGN] = true;
-	rightAssocOps[OR_ASSIGN] = true;
-	rightAssocOps[XOR_ASSIGN] = true;
-	rightAssocOps[BITWISE_SHIFT_LEFT_ASSIGN] = true;
-	rightAssocOps[BITWISE_SHIFT_RIGHT_ASSIGN] = true;
-	rightAssocOps[LOGICAL_NOT] = true;
-	rightAssocOps[BITWISE_NOT] = true;
-	rightAssocOps[MULT] = true;
-	rightAssocOps[BITWISE_AND] = true;
-	rightAssocOps[QUESTION] = true;
-
-	SymTable* predefined = new SymTable();
-	predefined->add(intType);
-	predefined->add(floatType);
-	predefined->add(charType);
-	predefined->add(voidType);
-	tableStack.push(predefined);
-
-	tableStack.push(new SymTable());
-
-	typePriority[charType] = 1;
-	typePriority[intType] = 2;
-	typePriority[floatType] = 3;
-
-	operationTypeOperands[MOD] = intType;
-	operationTypeOperands[BITWISE_AND] = intType;
-	operationTypeOperands[BITWISE_OR] = intType;
-	operationTypeOperands[BITWISE_XOR] = intType;
-	operationTypeOperands[BITWISE_NOT] = intType;
-	operationTypeOperands[BITWISE_SHIFT_LEFT] = intType;
-	operationTypeOperands[BITWISE_SHIFT_RIGHT] = intType;
-
-	operationReturningType[MOD] = intType;
-	operationReturningType[BITWISE_AND] = intType;
-	operationReturningType[BITWISE_OR] = intType;
-	operationReturningType[BITWISE_NOT] = intType;
-	operationReturningType[BITWISE_SHIFT_LEFT] = intType;
-	operationReturningType[BITWISE_SHIFT_RIGHT] = intType;
-	operationReturningType[LOGICAL_AND] = intType;
-	operationReturningType[LOGICAL_OR] = intType;
-	operationReturningType[BITWISE_XOR] = intType;
-	operationReturningType[LOGICAL_NOT] = intType;
-	operationReturningType[BITWISE_XOR] = intType;
-	operationReturningType[EQUAL] = intType;
-	operationReturningType[NOT_EQUAL] = intType;
-	operationReturningType[LESS] = intType;
-	operationReturningType[LESS_OR_EQUAL] = intType;
-	operationReturningType[GREATER] = intType;
-	operationReturningType[GREATER_OR_EQUAL] = intType;
+// Parses bodies deferred by owner on the tokens of owner, in the arena active on its thread
+Parser::Parser(const Parser* owner): literals(owner->literals), names(owner->names), sources(owner->sources), 
+	lexer(owner->lexer, 0), generator(owner->generator), nameCounter(0), stringConsts(0), stringsBase(0), floatsBase(0), 
+	parsingFunc(0), parsingCycle(0), owner(owner), deferring(false), threadsCount(1), packStructs(owner->packStructs), 
+	throughIR(owner->throughIR)
+{
 }
 
 void Parser::throwException(bool condition, const char* msg)
 {
 	if (condition)
-		throw ParserException(msg, lexer.get()->line, lexer.get()->col);
+		throw ParserException(msg, lexer.get());
 }
 
 void Parser::parseFuncCall(NodeP& root)
@@ -143,10 +88,10 @@ void Parser::parseFuncCall(NodeP& root)
 	if (*next == PARENTHESIS_FRONT)
 		{
 			Token* t = lexer.next();
-			root = new FuncCallNode(root->token, root, dynamic_cast<FuncSym*>(root->getType()));
+			root = create<FuncCallNode>(root->token, root, dyn_cast<FuncSym>(root->getType()));
 			while (*t != PARENTHESIS_BACK)
 			{
-				dynamic_cast<FuncCallNode*>(root)->addArg(parseExpression(priorityTable[COMMA] + 1));
+				cast<FuncCallNode>(root)->addArg(parseExpression(priorities[COMMA] + 1));
 				t = lexer.get();
 				throwException(*t == END_OF_FILE, "Expected parenthesis close after function argument list");
 				if (*t == COMMA)
@@ -161,13 +106,13 @@ void Parser::parseArrIndex(NodeP& root)
 	Token* next = lexer.get();
 	if (*next == BRACKET_FRONT)
 		{
-			root = new ArrNode(root->token, root);
+			root = create<ArrNode>(root->token, root);
 			Token* t = lexer.get();
 			while (*t == BRACKET_FRONT)
 			{
 				lexer.next();
 				Node* index = parseExpression();
-				dynamic_cast<ArrNode*>(root)->addArg(index);
+				cast<ArrNode>(root)->addArg(index);
 				t = lexer.get();
 				throwException(*t != BRACKET_BACK, "Expected bracket close after array index");
 				t = lexer.next();
@@ -181,47 +126,47 @@ Node* Parser::parseFactor()
 	bool nextNeeded = true;
 	Token* token = lexer.get();
 	if (*token == SEMICOLON)
-		return new EmptyNode();
+		return create<EmptyNode>();
 	switch (token->type) {
 	case INTEGER:
-		root = new IntNode(token);
+		root = create<IntNode>(token);
 		parseArrIndex(root);
 		break;
 	case REAL_NUMBER:
-		root = new FloatNode(token, floatConsts.size());
-		floatConsts.push_back(dynamic_cast<FloatNode*>(root));
+		root = create<FloatNode>(token, floatsBase + floatConsts.size());
+		floatConsts.push_back(cast<FloatNode>(root));
 		break;
 	case IDENTIFIER:
 		{
-			Symbol* sym = tableStack.find(token->text);
+			Symbol* sym = tableStack.find(token->name());
 			if (!sym && parsingFunc)
-				sym = parsingFunc->params->find(token->text);
+				sym = parsingFunc->params->find(token->name());
 			throwException(!sym, "Undefined name");
-			throwException(!dynamic_cast<VarSym*>(sym), "???");
-			root = new IdentifierNode(token, dynamic_cast<VarSym*>(sym));
+			throwException(!isa<VarSym>(sym), "???");
+			root = create<IdentifierNode>(token, cast<VarSym>(sym));
 			parseFuncCall(root);
 		}
 		break; 
 	case CHARACTER:
-		root = new CharNode(token);
+		root = create<CharNode>(token);
 		break;
 	case STRING:
 		{
-			StringNode* string = new StringNode(token, stringConsts.size());
+			StringNode* string = create<StringNode>(token, stringsBase + stringConsts.size());
 			stringConsts.push_back(string);
 			root = string;
 			break;
 		}
 	case KEYWORD:
 		{
-			KeywordsT kw = dynamic_cast<KeywordToken*>(token)->val;
+			KeywordsT kw = token->keyword;
 			if (kw == CHAR || kw == INT || kw == FLOAT || kw == SIZEOF)
 			{
 				lexer.next();
 				string typeName = kw == CHAR ? "char" : kw == INT ? "int" : "float";
 				throwException(*lexer.get() != PARENTHESIS_FRONT, "Expected open parenthesis");
 				lexer.next();
-				root = new CoerceNode(token, parseExpression(), dynamic_cast<TypeSym*>(tableStack.find(typeName)));
+				root = create<CoerceNode>(token, parseExpression(), dyn_cast<TypeSym>(tableStack.find(typeName)));
 				throwException(*lexer.get() != PARENTHESIS_BACK, "Expected close parenthesis");
 				lexer.next();
 			} else 
@@ -235,15 +180,15 @@ Node* Parser::parseFactor()
 			{
 				throwException(*lexer.next() != PARENTHESIS_FRONT, "Expected open parenthesis");
 				lexer.next();
-				StringNode* format = dynamic_cast<StringNode*>(parseExpression(priorityTable[COMMA] + 1));
+				StringNode* format = dyn_cast<StringNode>(parseExpression(priorities[COMMA] + 1));
 				throwException(!format, "Expected format string");
-				IOOperatorNode* node = new IOOperatorNode(dynamic_cast<OpToken*>(token), format);
+				IOOperatorNode* node = create<IOOperatorNode>(token, format);
 				if (*lexer.get() == COMMA)
 				{
 					lexer.next();
 					while (1)
 					{
-						Node* arg = parseExpression(priorityTable[COMMA] + 1);
+						Node* arg = parseExpression(priorities[COMMA] + 1);
 						throwException(!arg, "Expected argument");
 						node->addArg(arg);
 						if (*lexer.get() == PARENTHESIS_BACK)
@@ -260,10 +205,10 @@ Node* Parser::parseFactor()
 				root = parseExpression();
 				Token* close = lexer.get();
 				if (!close || *close != PARENTHESIS_BACK)
-					throw ParserException("Expected parenthesis close", root->token->line, root->token->col);
-			} else if (unaryOps[dynamic_cast<OpToken*>(token)->val] == true) {
+					throw ParserException("Expected parenthesis close", root->token);
+			} else if (unaryOps[token->op]) {
 				lexer.next();
-				root = new UnaryOpNode(token, parseExpression(priorityTable[DEC]));
+				root = create<UnaryOpNode>(token, parseExpression(priorities[DEC]));
 				nextNeeded = false;
 			} else
 				throwException(true, "Empty expression is not allowed");
@@ -279,73 +224,82 @@ Node* Parser::parseMember(Node* left)
 {
 	TypeSym* type = left->getType();
 	StructSym* structType = 0;
-	PointerSym* sp = dynamic_cast<PointerSym*>(type);
+	PointerSym* sp = dyn_cast<PointerSym>(type);
 	if (sp) 
 	{
-		if (dynamic_cast<AliasSym*>(sp->type))
-			structType = dynamic_cast<StructSym*>(dynamic_cast<AliasSym*>(sp->type)->type);
+		if (isa<AliasSym>(sp->type))
+			structType = dyn_cast<StructSym>(cast<AliasSym>(sp->type)->type);
 		else
-			structType = dynamic_cast<StructSym*>(sp->type);		
-	} else if (dynamic_cast<AliasSym*>(type))
-		structType = dynamic_cast<StructSym*>(type->getType());
+			structType = dyn_cast<StructSym>(sp->type);		
+	} else if (isa<AliasSym>(type))
+		structType = dyn_cast<StructSym>(type->getType());
 	else
-		structType= dynamic_cast<StructSym*>(type);
+		structType= dyn_cast<StructSym>(type);
 	throwException(!structType, "Left operand of . or -> must be a structure");
 	Token* opTok = lexer.get();
 	Token* token = lexer.next();
-	throwException(!dynamic_cast<IdentifierToken*>(token), "Right operand of . or -> must be a identifier");
-	string fieldName = token->text;
+	throwException(*token != IDENTIFIER, "Right operand of . or -> must be a identifier");
+	NameIdT fieldName = token->name();
 	if (!structType->fields->exists(fieldName))
-		fieldName = '$' + fieldName;
+		fieldName = Interner::current().decorated(fieldName);
 	throwException(!structType->fields->exists(fieldName), "Undefined field in structure");
 	lexer.next();
-	Node* right = new IdentifierNode(token, dynamic_cast<VarSym*>(structType->fields->find(fieldName)));
-	return new BinaryOpNode(opTok, left, right);
+	Node* right = create<IdentifierNode>(token, dyn_cast<VarSym>(structType->fields->find(fieldName)));
+	return create<BinaryOpNode>(opTok, left, right);
 }
 
+// Precedence climbing: the operand is parsed once, then level walks down from the highest
+// binding power, jumping straight to the power of the next operation. A level takes every
+// operation binding at least as tightly and parses right operands from the level above it
 Node* Parser::parseExpression(int priority)
 {
-	if (priority > 15)
+	if (priority >= factorPriority)
 		return parseFactor();
-	Node* left = parseExpression(priority + 1);
-	Node* root = left;
+	Node* root = parseFactor();
 	Token* opTok = lexer.get();
-	if (*opTok == END_OF_FILE || *opTok == PARENTHESIS_BACK || *opTok == BRACKET_BACK
-		|| *opTok == COLON || *opTok == SEPARATOR)
+	int level = factorPriority - 1;
+	while (level >= priority)
 	{
-		root->getType();
-		return root;
-	}
-	throwException(!dynamic_cast<OpToken*>(opTok), "Invalid expression. Expected operation");
-	if (priorityTable[dynamic_cast<OpToken*>(opTok)->val] < priority)
-		return root;
-	while (dynamic_cast<OpToken*>(opTok) && priorityTable[dynamic_cast<OpToken*>(opTok)->val] >= priority)
-	{
-		OperationsT op = dynamic_cast<OpToken*>(opTok)->val;	
-		if (op == PARENTHESIS_FRONT)
-			parseFuncCall(root);
-		else if (op == BRACKET_FRONT)
-			parseArrIndex(root);
-		else if (op == INC || op == DEC) {
-			root = new PostfixUnaryOpNode(opTok, root);
-			lexer.next();		
-		} else if (op == QUESTION) {
-			lexer.next();
-			Node* l = parseExpression();
-			if (*lexer.get() != COLON)
-				throw ParserException("Missed branch of ternary operator", lexer.line, lexer.col);
-			lexer.next();
-			Node* r = parseExpression();
-			root = new TernaryOpNode(opTok, root, l, r);
-		} else if (op == DOT || op == ARROW)
-			root = parseMember(root);		
-		else {
-			lexer.next();
-			root = new BinaryOpNode(opTok, root, parseExpression(priority + (rightAssocOps[op] == true ? 0 : 1)));		
+		if (*opTok == END_OF_FILE || *opTok == PARENTHESIS_BACK || *opTok == BRACKET_BACK
+			|| *opTok == COLON || *opTok == SEPARATOR)
+		{
+			root->getType();
+			return root;
+		}
+		throwException(*opTok != OPERATION, "Invalid expression. Expected operation");
+		if (priorities[opTok->op] < level)
+		{
+			level = priorities[opTok->op];
+			continue;
+		}
+		while (*opTok == OPERATION && priorities[opTok->op] >= level)
+		{
+			OperationsT op = opTok->op;	
+			if (op == PARENTHESIS_FRONT)
+				parseFuncCall(root);
+			else if (op == BRACKET_FRONT)
+				parseArrIndex(root);
+			else if (op == INC || op == DEC) {
+				root = create<PostfixUnaryOpNode>(opTok, root);
+				lexer.next();		
+			} else if (op == QUESTION) {
+				lexer.next();
+				Node* l = parseExpression();
+				throwException(*lexer.get() != COLON, "Missed branch of ternary operator");
+				lexer.next();
+				Node* r = parseExpression();
+				root = create<TernaryOpNode>(opTok, root, l, r);
+			} else if (op == DOT || op == ARROW)
+				root = parseMember(root);		
+			else {
+				lexer.next();
+				root = create<BinaryOpNode>(opTok, root, parseExpression(level + (rightAssocOps[op] ? 0 : 1)));		
+			}
+			opTok = lexer.get();
 		}
-		opTok = lexer.get();
+		root->getType();
+		level--;
 	}
-	root->getType();
 	return root;
 }
 
@@ -353,17 +307,19 @@ StructSym* Parser::parseStruct(bool inParamList)
 {
 	Token* token = lexer.next();
 	string structName;
-	if (dynamic_cast<IdentifierToken*>(token)) 
+	bool anonymous = *token != IDENTIFIER;
+	if (*token == IDENTIFIER) 
 	{
-		structName = token->text;
+		structName = token->text();
 		token = lexer.next();
 	} else 
 		structName = "$$unnamedStruct" + to_string(nameCounter++);	
-	StructSym* structType = dynamic_cast<StructSym*>(tableStack.find(structName));
+	StructSym* structType = dyn_cast<StructSym>(tableStack.find(structName));
 	throwException(inParamList && !structType, "Unknown struct type");
+	bool declared = structType != 0;
 	if (!structType)	
 	{
-		structType = new StructSym(structName, 0);
+		structType = create<StructSym>(structName, nullptr);
 		if (structName.length() > 0)
 			tableStack.add(structType);
 	}
@@ -371,15 +327,23 @@ StructSym* Parser::parseStruct(bool inParamList)
 	{
 		throwException(inParamList, "Type definition is not allowed");
 		throwException(structType->fields, "Struct redefinition");
-		structType->fields = new SymTableForFields();
-		tableStack.push(structType->fields);
+		if (declared && owner) // bodies run in parallel must not complete shared structs
+		{
+			DivergenceT divergence = { 0, 0 };
+			throw divergence;
+		}
+		if (declared)
+			settleDeferred();
+		SymTableForFields* fields = create<SymTableForFields>();
+		structType->fields = fields;
+		tableStack.push(fields);
 		token = lexer.next();
 		while (*token != BRACE_BACK)
 		{
 			TypeSym* type = parseType();
 			while (*lexer.get() != SEMICOLON)
 			{
-				structType->fields->add(parseIdentifier(type));
+				tableStack.add(parseIdentifier(type));
 				token = lexer.get();
 				if (*token == COMMA)
 					token = lexer.next();
@@ -387,6 +351,8 @@ StructSym* Parser::parseStruct(bool inParamList)
 			token = lexer.next();
 		}
 		tableStack.pop();
+		if (packStructs && anonymous) // no tag, so no other declaration shares its layout
+			fields->pack();
 		lexer.next();
 	}
 	return structType;	
@@ -405,14 +371,14 @@ TypeSym* Parser::parseType(bool inParamList)
 	if (*token == STRUCT) 
 		type = parseStruct(inParamList);
 	else {
-		type = dynamic_cast<TypeSym*>(tableStack.find(token->text));
+		type = dyn_cast<TypeSym>(tableStack.find(token->name()));
 		lexer.next();
 	}
 	throwException(!type, "Unknown type");	
-	while (dynamic_cast<AliasSym*>(type))
+	while (isa<AliasSym>(type))
 		type = type->getType();
 	if (isConst)
-		type = new ConstTypeSym(type);
+		type = TypeTable::current().constOf(type);
 	return type;
 }
 
@@ -423,7 +389,7 @@ TypeSym* Parser::parseArrayDimensions(TypeSym* baseType, bool inParamList)
 	while (*token == BRACKET_FRONT)
 	{
 		token = lexer.next();
-		int size = dynamic_cast<IntegerToken*>(token) ? dynamic_cast<IntegerToken*>(token)->val : -1;
+		int size = *token == INTEGER ? token->intVal : -1;
 		throwException(size == 0 || size < -1, "Array bounds must be a positive integer");
 		arrSizes.push_back(size);
 		if (size != -1)
@@ -435,7 +401,7 @@ TypeSym* Parser::parseArrayDimensions(TypeSym* baseType, bool inParamList)
 		throwException(arrSizes[i] == -1, "Expected array bounds");
 	throwException(!inParamList && arrSizes.size() == 1 && arrSizes[0] == -1, "Expected array bounds");
 	for (int i = arrSizes.size() - 1; i >= 0; i--)
-		baseType = new ArraySym(baseType, arrSizes[i]);
+		baseType = create<ArraySym>(baseType, arrSizes[i]);
 	return baseType;
 }
 
@@ -447,22 +413,22 @@ void Parser::parseParam()
 	throwException(*type == "void" && *token != MULT, "Argument type cannot be a void");	
 	while (*token == MULT)
 	{
-		type = new PointerSym(type);
+		type = TypeTable::current().pointerTo(type);
 		token = lexer.next();
 	}	
 	if (*token == PARENTHESIS_FRONT)
 		param = parseComplexDecl(type);
 	else {
-		string name = dynamic_cast<IdentifierToken*>(token) ? token->text : "";
+		string name = *token == IDENTIFIER ? token->text() : "";
 		if (name.length() > 0) 
 		{
 			throwException(tableStack.top()->exists(name), "Redefinition");
 			token = lexer.next();
 		}
 		if (*token == BRACKET_FRONT)
-			type = parseArrayDimensions(type, true);
-		param = new VarSym(name, type);
-		dynamic_cast<VarSym*>(param)->global = false;
+			type = TypeTable::current().canonical(parseArrayDimensions(type, true));
+		param = create<VarSym>(name, type);
+		cast<VarSym>(param)->global = false;
 	}
 	tableStack.add(param);
 }
@@ -483,8 +449,8 @@ void Parser::parseArgList()
 
 FuncSym* Parser::createFunctionSymbol(TypeSym* type)
 {
-	FuncSym* function = new FuncSym(type);
-	function->params = new SymTableForParams();
+	FuncSym* function = create<FuncSym>(type);
+	function->params = create<SymTableForParams>();
 	tableStack.push(function->params);
 	parseArgList();
 	tableStack.pop();
@@ -497,13 +463,13 @@ VarSym* Parser::parseIdentifier(TypeSym* type)
 	Token* token = lexer.get();
 	while (*token == MULT)
 	{
-		type = new PointerSym(type);
+		type = TypeTable::current().pointerTo(type);
 		token = lexer.next();
 	}
 	if (*token == PARENTHESIS_FRONT)
 		return parseComplexDecl(type);
-	throwException(!dynamic_cast<IdentifierToken*>(token), "Expected identifier");
-	string name = dynamic_cast<IdentifierToken*>(token)->val;
+	throwException(*token != IDENTIFIER, "Expected identifier");
+	string name = token->text();
 	token = lexer.next();	
 	if (*token != PARENTHESIS_FRONT)
 	{
@@ -513,7 +479,7 @@ VarSym* Parser::parseIdentifier(TypeSym* type)
 			name = '$' + name;
 	} else 		
 		type = createFunctionSymbol(type);	
-	res = new VarSym(name, type);
+	res = create<VarSym>(name, TypeTable::current().declared(type));
 	throwException(tableStack.existsInLastNamespace(name), "Redefinition");
 	return res;
 }
@@ -535,13 +501,13 @@ VarSym* Parser::parseDirectDecl()
 	VarSym* sym = 0;
 	TypeSym* type = 0;
 	while (*lexer.next() == MULT)
-		type = new PointerSym(type);
+		type = create<PointerSym>(type);
 	if (*lexer.get() == PARENTHESIS_FRONT)
 		sym = parseDirectDecl();
 	else {
-		throwException(!dynamic_cast<IdentifierToken*>(lexer.get()), "Expected identifier");
-		throwException(tableStack.top()->exists(lexer.get()->text), "Redefinition");
-		sym = new VarSym(lexer.get()->text, 0);
+		throwException(*lexer.get() != IDENTIFIER, "Expected identifier");
+		throwException(tableStack.top()->exists(lexer.get()->name()), "Redefinition");
+		sym = create<VarSym>(lexer.get()->text(), nullptr);
 		lexer.next();
 	}
 	if (*lexer.get() == PARENTHESIS_FRONT)	
@@ -561,6 +527,7 @@ VarSym* Parser::parseComplexDecl(TypeSym* baseType)
 	else if (*lexer.get() == BRACKET_FRONT)
 		baseType = parseArrayDimensions(baseType, true);
 	hitch(sym, baseType);
+	sym->type = TypeTable::current().declared(sym->type); // the declarator was built from fresh types
 	return sym;
 }
 
@@ -579,11 +546,11 @@ void Parser::parseDeclaration()
 		{
 			Token* assign = lexer.get();
 			lexer.next();
-			Node* assignOperand = parseExpression(priorityTable[COMMA] + 1);
+			Node* assignOperand = parseExpression(priorities[COMMA] + 1);
 			throwException(blocks.size() == 0, "Cannot assign out of block");
-			BinaryOpNode* node = new BinaryOpNode(assign, new IdentifierNode(token, sym), assignOperand);
+			BinaryOpNode* node = create<BinaryOpNode>(assign, create<IdentifierNode>(token, sym), assignOperand);
 			node->getType();
-			blocks.top()->AddStatement(new SingleStatement(node));
+			blocks.top()->AddStatement(create<SingleStatement>(node));
 		}
 		if (*lexer.get() == SEMICOLON || *lexer.get() == BRACE_FRONT)
 			break;
@@ -594,14 +561,15 @@ void Parser::parseDeclaration()
 	};
 	if (*lexer.get() == BRACE_FRONT)
 	{
-		FuncSym* func = dynamic_cast<FuncSym*>(sym->type);
+		FuncSym* func = dyn_cast<FuncSym>(sym->type);
 		if (func)
 		{
 			throwException(blocks.size() != 0, "Cannot define function in block");
-			parsingFunc = func;
-			func->body = parseBlock(true);
-			parsingFunc = 0;
-			func->endLabel = makeLabel("f_" + sym->name + "_end");
+			if (!deferring || !deferBody(sym, func))
+			{
+				settleDeferred(); // the rest of the file is this body, the ones before come first
+				parseBody(sym, func);
+			}
 		} else 
 			throwException(true, "Unexpected brace");
 	} else
@@ -611,24 +579,24 @@ void Parser::parseDeclaration()
 JumpStatement* Parser::parseJumpStatement()
 {
 	JumpStatement* stmnt = 0;
-	switch (dynamic_cast<KeywordToken*>(lexer.get())->val) 
+	switch (lexer.get()->keyword) 
 	{
 	case CONTINUE:
 		throwException(!parsingCycle, "There is no cycle to jump");
-		stmnt = new ContinueStatement(parsingCycle);
+		stmnt = create<ContinueStatement>(parsingCycle);
 		break;
 	case BREAK:
 		throwException(!parsingCycle, "There is no cycle to jump");
-		stmnt = new BreakStatement(parsingCycle);
+		stmnt = create<BreakStatement>(parsingCycle);
 		break;
 	case RETURN:
 		Node* arg = *lexer.next() != SEMICOLON ? parseExpression() : 0;
 		throwException(!parsingFunc, "Unexpected return statement");
-		stmnt = new ReturnStatement(arg, parsingFunc);
+		stmnt = create<ReturnStatement>(arg, parsingFunc);
 	}
 	if (*lexer.get() != SEMICOLON)
 		if (*lexer.next() != SEMICOLON)
-			throw ParserException("Expected semicolon", lexer.get()->line, lexer.get()->col);
+			throw ParserException("Expected semicolon", lexer.get());
 	lexer.next();
 	return stmnt;
 }
@@ -649,7 +617,7 @@ Statement* Parser::parseStatement()
 	else if (*token == CONTINUE || *token == BREAK || *token == RETURN)
 		return parseJumpStatement();
 	else {
-		SingleStatement* stnmt = new SingleStatement(parseExpression());
+		SingleStatement* stnmt = create<SingleStatement>(parseExpression());
 		if (*lexer.get() == SEMICOLON)
 			lexer.next();
 		return stnmt;
@@ -677,10 +645,10 @@ ForStatement* Parser::parseFor()
 	Node* condition = parseExpression();
 	throwException(*lexer.get() != SEMICOLON, "Expected semicolon");
 	lexer.next();
-	Node* increment = *lexer.get() != PARENTHESIS_BACK ? parseExpression() : new EmptyNode();
+	Node* increment = *lexer.get() != PARENTHESIS_BACK ? parseExpression() : create<EmptyNode>();
 	throwException(*lexer.get() != PARENTHESIS_BACK, "Expected close parenthesis");
 	lexer.next();
-	ForStatement* stmnt = new ForStatement(initialization, condition, increment, 0);
+	ForStatement* stmnt = create<ForStatement>(initialization, condition, increment, nullptr);
 	CycleStatement* tmp = parsingCycle;
 	parsingCycle = stmnt;
 	Statement* body = parseStatement();
@@ -692,7 +660,7 @@ ForStatement* Parser::parseFor()
 WhilePreCondStatement* Parser::parseWhile()
 {
 	Node* condition = fetchCondition();
-	WhilePreCondStatement* stmnt = new WhilePreCondStatement(condition, 0);
+	WhilePreCondStatement* stmnt = create<WhilePreCondStatement>(condition, nullptr);
 	CycleStatement* tmp = parsingCycle;
 	parsingCycle = stmnt;
 	Statement* body = parseStatement();
@@ -704,7 +672,7 @@ WhilePreCondStatement* Parser::parseWhile()
 WhilePostCondStatement* Parser::parseDoWhile()
 {
 	lexer.next();
-	WhilePostCondStatement* stmnt = new WhilePostCondStatement(0, 0);
+	WhilePostCondStatement* stmnt = create<WhilePostCondStatement>(nullptr, nullptr);
 	CycleStatement* tmp = parsingCycle;
 	parsingCycle = stmnt;
 	Statement* body = parseStatement();
@@ -728,20 +696,20 @@ IfStatement* Parser::parseIf()
 		lexer.next();
 		falseBranch = parseStatement();
 	}
-	return new IfStatement(condition, trueBranch, falseBranch);
+	return create<IfStatement>(condition, trueBranch, falseBranch);
 }
 
 Block* Parser::parseBlock(bool function)
 {
 	lexer.next();
 	SymTable* top = tableStack.top();
-	Block* block = new Block(new SymTableForLocals(function ? 4 : top->shift + top->byteSize()));
+	Block* block = create<Block>(create<SymTableForLocals>(function ? 0 : top->shift + top->byteSize()));
 	blocks.push(block);
 	tableStack.push(block->locals);
 	Token* token = lexer.get();
 	while (*token != BRACE_BACK)
 	{
-		if (*token == CONST || *token == STRUCT || dynamic_cast<TypeSym*>(tableStack.find(token->text)))
+		if (*token == CONST || *token == STRUCT || isa<TypeSym>(tableStack.find(token->name())))
 			parseDeclaration();
 		else if (*token == TYPEDEF)
 			parseTypeDef();
@@ -761,14 +729,14 @@ void Parser::parseTypeDef()
 	TypeSym* type = parseType();
 	while (*lexer.get() == MULT)
 	{
-		type = new PointerSym(type);
+		type = TypeTable::current().pointerTo(type);
 		lexer.next();
 	}
 	while (*lexer.get() != SEMICOLON)
 	{
-		string alias = lexer.get()->text;
+		string alias = lexer.get()->text();
 		throwException(tableStack.find(alias), "Alias must be a unique");
-		tableStack.add(new AliasSym(alias, type));
+		tableStack.add(create<AliasSym>(alias, type));
 		lexer.next();
 		if (*lexer.get() == COMMA)
 			lexer.next();
@@ -781,22 +749,229 @@ void Parser::parse()
 	Token* token = lexer.get();
 	while (*token != END_OF_FILE)
 	{
-		if (*token == CONST || *token == STRUCT || dynamic_cast<TypeSym*>(tableStack.find(token->text)))
+		if (*token == CONST || *token == STRUCT || isa<TypeSym>(tableStack.find(token->name())))
 			parseDeclaration();
 		else if (*token == TYPEDEF)
 			parseTypeDef();
 		else 
-			parseExpression()->print();
+		{
+			Node* expression = parseExpression();
+			settleDeferred(); // not printed before the bodies ahead of it are known to parse
+			expression->print();
+		}
 		token = lexer.get();
 	}
 }
 
+// Parses as parse() does with the function bodies left to threads: this pass skips each body to its
+// matching brace, the workers parse them against the scope frozen there, each in an arena of its own.
+// From the first body that did not parse as it would have in place on, parsing goes on serially
+void Parser::parseParallel(int threads)
+{
+	if (!lexer.replays())
+	{
+		parse();
+		return;
+	}
+	threadsCount = max(threads, 1);
+	exception_ptr error;
+	deferring = true;
+	try {
+		try {
+			parse();
+		} catch (const DivergenceT&) {
+			throw;
+		} catch (...) {
+			error = current_exception(); // comes after every body deferred so far
+		}
+		deferring = false;
+		settleDeferred();
+	} catch (const DivergenceT& divergence) {
+		deferring = false;
+		parseBody(divergence.sym, divergence.func);
+		parse();
+		return;
+	}
+	if (error)
+		rethrow_exception(error);
+}
+
+void Parser::parseBody(VarSym* sym, FuncSym* func)
+{
+	parsingFunc = func;
+	func->body = parseBlock(true);
+	parsingFunc = 0;
+	func->endLabel = makeLabel("f_" + sym->name + "_end");
+}
+
+// Skips the body at the current brace, reserving the names and constants it will take;
+// false if it has no closing brace
+bool Parser::deferBody(VarSym* sym, FuncSym* func)
+{
+	DeferredBodyT body;
+	body.start = lexer.position();
+	int depth = 0, unnamedStructs = 0, strings = 0, floats = 0;
+	int end = body.start;
+	for (; end < lexer.tokensCount(); end++)
+	{
+		Token* token = lexer.token(end);
+		if (*token == BRACE_FRONT)
+			depth++;
+		else if (*token == BRACE_BACK && --depth == 0)
+			break;
+		else if (token->type == STRING)
+			strings++;
+		else if (token->type == REAL_NUMBER)
+			floats++;
+		else if (*token == STRUCT && (end + 1 == lexer.tokensCount() || *lexer.token(end + 1) != IDENTIFIER))
+			unnamedStructs++;
+	}
+	if (end + 1 >= lexer.tokensCount())
+		return false;
+	body.sym = sym;
+	body.func = func;
+	body.end = end + 1;
+	body.scope = tableStack.frozen();
+	body.nameCounter = nameCounter;
+	body.stringsBase = stringConsts.size();
+	body.floatsBase = floatConsts.size();
+	body.unnamedStructs = unnamedStructs;
+	body.strings = strings;
+	body.floats = floats;
+	body.block = 0;
+	body.diverged = false;
+	deferred.push_back(move(body));
+
+	nameCounter += unnamedStructs;
+	stringConsts.resize(stringConsts.size() + strings);
+	floatConsts.resize(floatConsts.size() + floats);
+	func->endLabel = makeLabel("f_" + sym->name + "_end");
+	lexer.seek(body.end);
+	return true;
+}
+
+// Runs work on threads threads that take their tasks by next, each thread creating in an arena of
+// its own. A single one runs on this thread, in the arena active here
+void Parser::runWorkers(int threads, ParserWorkT work)
+{
+	atomic<int> next(0);
+	if (threads <= 1)
+	{
+		(this->*work)(&next);
+		return;
+	}
+	while (workerArenas.size() < threads)
+		workerArenas.emplace_back();
+	vector<thread> pool;
+	for (int i = 0; i < threads; i++)
+		pool.push_back(thread(&Parser::runWorker, this, work, &next, &workerArenas[i]));
+	for (int i = 0; i < threads; i++)
+		pool[i].join();
+}
+
+void Parser::runWorker(ParserWorkT work, atomic<int>* next, Arena* nodes)
+{
+	ActiveScope<Arena> workerNodes(*nodes);
+	ActiveScope<TypeTable> workerTypes(types);
+	ActiveScope<LiteralPool> workerLiterals(*literals);
+	ActiveScope<Interner> workerNames(*names);
+	ActiveScope<SourceMap> workerSources(*sources);
+	(this->*work)(next);
+}
+
+void Parser::parseDeferred(atomic<int>* next)
+{
+	Parser worker(this);
+	for (int i = (*next)++; i < deferred.size(); i = (*next)++)
+		worker.parseDeferredBody(deferred[i]);
+}
+
+void Parser::parseDeferredBody(DeferredBodyT& body)
+{
+	lexer.seek(body.start);
+	tableStack = body.scope;
+	nameCounter = body.nameCounter;
+	stringsBase = body.stringsBase;
+	floatsBase = body.floatsBase;
+	stringConsts.clear();
+	floatConsts.clear();
+	try {
+		parsingFunc = body.func;
+		body.block = parseBlock(true);
+		body.diverged = lexer.position() != body.end || nameCounter - body.nameCounter != body.unnamedStructs 
+			|| stringConsts.size() != body.strings || floatConsts.size() != body.floats;
+	} catch (const DivergenceT&) {
+		body.diverged = true;
+	} catch (...) {
+		body.error = current_exception();
+	}
+	parsingFunc = 0;
+	parsingCycle = 0;
+	blocks = stack<Block*>();
+	body.stringConsts.swap(stringConsts);
+	body.floatConsts.swap(floatConsts);
+}
+
+// Parses the deferred bodies and takes them in source order as if each had been parsed in place.
+// Throws the error of the first that failed; for the first that diverged, puts the state back to
+// where it started and throws DivergenceT
+void Parser::settleDeferred()
+{
+	if (deferred.empty())
+		return;
+	runWorkers(min(threadsCount, (int) deferred.size()), &Parser::parseDeferred);
+
+	vector<DeferredBodyT> bodies;
+	bodies.swap(deferred);
+	for (int i = 0; i < bodies.size(); i++)
+	{
+		DeferredBodyT& body = bodies[i];
+		if (body.error)
+			rethrow_exception(body.error);
+		if (body.diverged)
+		{
+			tableStack.rollback(body.scope);
+			nameCounter = body.nameCounter;
+			stringConsts.resize(body.stringsBase);
+			floatConsts.resize(body.floatsBase);
+			parsingFunc = 0; // a body parsed in place may have been interrupted
+			parsingCycle = 0;
+			blocks = stack<Block*>();
+			lexer.seek(body.start);
+			DivergenceT divergence = { body.sym, body.func };
+			throw divergence;
+		}
+		body.func->body = body.block;
+		copy(body.stringConsts.begin(), body.stringConsts.end(), stringConsts.begin() + body.stringsBase);
+		copy(body.floatConsts.begin(), body.floatConsts.end(), floatConsts.begin() + body.floatsBase);
+	}
+}
+
 void Parser::print() const
 {
 	tableStack.print();
 }
 
-void Parser::generateCode() 
+void Parser::printLayout()
+{
+	tableStack.top()->printLayout();
+}
+
+// Dumps the SSA form of every function, each checked after it is printed
+void Parser::printIR()
+{
+	vector<VarSym*> defined = tableStack.top()->functions();
+	for (int i = 0; i < defined.size(); i++)
+	{
+		IRFunction* ir = IRBuilder().build(cast<FuncSym>(defined[i]->type), defined[i]->name);
+		ir->print(cout);
+		ir->verify();
+		delete ir;
+	}
+}
+
+// Each function goes to code of its own, so threads threads can generate them
+void Parser::generateCode(int threads) 
 {
 	for (int i = 0; i < stringConsts.size(); i++)
 		stringConsts[i]->generateData(generator.data);
@@ -805,15 +980,52 @@ void Parser::generateCode()
 	tableStack.top()->generateGlobals(generator.data);
 	generator.data.add(cmdREAL4, makeArgMemory("tmp4"), makeFloat(0))
 		.add(cmdREAL8, makeArgMemory("tmp8"), makeFloat(0));
-	tableStack.top()->generateCode(generator.code);
+	functions = tableStack.top()->functions();
+	generator.functions.assign(functions.size(), AsmCode());
+	functionErrors.assign(functions.size(), exception_ptr());
+	runWorkers(min(threads, (int) functions.size()), &Parser::generateFunctions);
+	for (int i = 0; i < functionErrors.size(); i++)
+		if (functionErrors[i])
+			rethrow_exception(functionErrors[i]);
 	generator.code.add(makeLabel("start"))
 		.add(cmdCALL, makeLabel("f_main"))
 		.add(cmdRET, makeArg(0));
 }
 
-void Parser::optimize()
+void Parser::generateFunctions(atomic<int>* next)
+{
+	for (int i = (*next)++; i < functions.size(); i = (*next)++)
+		try {
+			if (throughIR)
+			{
+				IRFunction* ir = IRBuilder().build(cast<FuncSym>(functions[i]->type), functions[i]->name);
+				ir->verify();
+				IRLowering(*ir, generator.functions[i]).lower();
+				delete ir;
+			} else
+				cast<FuncSym>(functions[i]->type)->generate(generator.functions[i], functions[i]->name);
+		} catch (...) {
+			functionErrors[i] = current_exception();
+		}
+}
+
+// Optimizes the code of every function, and the code after them, on its own. Labels called from
+// anywhere are kept in all of them
+void Parser::optimize(int threads)
+{
+	calledLabels.clear();
+	for (int i = 0; i < generator.functions.size(); i++)
+		Optimizer::collectCalls(generator.functions[i], calledLabels);
+	Optimizer::collectCalls(generator.code, calledLabels);
+	runWorkers(min(threads, (int) generator.functions.size() + 1), &Parser::optimizeFunctions);
+}
+
+void Parser::optimizeFunctions(atomic<int>* next)
 {
-	optimizer.optimize(generator.code);
+	Optimizer optimizer;
+	int count = generator.functions.size();
+	for (int i = (*next)++; i <= count; i = (*next)++)
+		optimizer.optimize(i < count ? generator.functions[i] : generator.code, calledLabels);
 }
 
 void Parser::fflush()
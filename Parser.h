@@ -2,31 +2,78 @@
 #define PARSER_H_INCLUDED
 
 #include <map>
+#include <set>
 #include <stack>
 #include <vector>
+#include <deque>
+#include <atomic>
+#include <exception>
 #include "Scanner.h"
 #include "Symbols.h"
 #include "CodeGenerator.h"
 #include "Optimizer.h"
+#include "Arena.h"
+#include "SourceMap.h"
+#include "TypeTable.h"
+#include "IRBuilder.h"
+#include "IRLowering.h"
 
 using namespace std;
 
+// A function body parseParallel skipped on its top-level pass, with the state the serial parser
+// would have started it from and what the pass reserved for it
+typedef struct {
+	VarSym* sym;
+	FuncSym* func;
+	int start; // position of the opening brace
+	int end; // position after the closing one
+	SymTableStack scope;
+	int nameCounter;
+	int stringsBase;
+	int floatsBase;
+	int unnamedStructs;
+	int strings;
+	int floats;
+	Block* block;
+	vector<StringNode*> stringConsts;
+	vector<FloatNode*> floatConsts;
+	exception_ptr error;
+	bool diverged; // parsed differently than reserved, or would have changed the globals
+} DeferredBodyT;
+
+class Parser;
+typedef void (Parser::*ParserWorkT)(atomic<int>* next);
+
 class Parser
 {
 private:
+	Arena arena; // first, so the tree outlives every other member
+	TypeTable types; // shared with the worker parsers and threads
+	shared_ptr<LiteralPool> literals; // of the lexer's tokens
+	Interner* names; // current on the thread that made the parser
+	SourceMap* sources;
+	deque<Arena> workerArenas; // one per worker thread
 	int nameCounter;
 	Scanner lexer;		
 	CodeGenerator generator;
-	Optimizer optimizer;
 	SymTableStack tableStack;
 	FuncSym* parsingFunc;
 	CycleStatement* parsingCycle;
 	stack<Block*> blocks;
-	map<OperationsT, int> priorityTable;
-	map<OperationsT, bool> unaryOps;
-	map<OperationsT, bool> rightAssocOps;
 	vector<StringNode*> stringConsts;
 	vector<FloatNode*> floatConsts;
+	int stringsBase; // index of stringConsts[0]
+	int floatsBase;
+	const Parser* owner; // of the worker parsers of parseParallel
+	bool deferring;
+	int threadsCount;
+	bool packStructs; // reorder the fields of anonymous structs for the least padding
+	bool throughIR; // generate the functions from their SSA form
+	vector<DeferredBodyT> deferred;
+	vector<VarSym*> functions; // defined functions in declaration order
+	vector<exception_ptr> functionErrors;
+	set<NameIdT> calledLabels;
+	Parser(const Parser* owner);
 	VarSym* parseComplexDecl(TypeSym* baseType);
 	VarSym* parseIdentifier(TypeSym* baseType);
 	VarSym* parseDirectDecl();
@@ -48,6 +95,15 @@ private:
 	void parseFuncCall(NodeP& root);
 	void parseArrIndex(NodeP& root);
 	void parseDeclaration();
+	void parseBody(VarSym* sym, FuncSym* func);
+	bool deferBody(VarSym* sym, FuncSym* func);
+	void runWorkers(int threads, ParserWorkT work);
+	void runWorker(ParserWorkT work, atomic<int>* next, Arena* nodes);
+	void parseDeferred(atomic<int>* next);
+	void parseDeferredBody(DeferredBodyT& body);
+	void settleDeferred();
+	void generateFunctions(atomic<int>* next);
+	void optimizeFunctions(atomic<int>* next);
 	void parseTypeDef();
 	void throwException(bool condition, const char* msg);
 	void initBlock();
@@ -56,11 +112,17 @@ private:
 	void parseParam();
 public:
 	Parser(Scanner& scanner, CodeGenerator& codeGen);
+	~Parser();
 	Node* parseExpression(int priority = 0);	
 	void parse();
+	void parseParallel(int threads);
+	void packAnonymousStructs() { packStructs = true; }
+	void generateThroughIR() { throughIR = true; }
 	void print() const;
-	void generateCode();
-	void optimize();
+	void printLayout();
+	void printIR();
+	void generateCode(int threads = 1);
+	void optimize(int threads = 1);
 	void fflush();
 };
 
@@ -0,0 +1,646 @@
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include "Preprocessor.h"
+#include "Scanner.h"
+
+using namespace std;
+
+static const int maxIncludeDepth = 200;
+
+static void fail(const SourceFileT& file, const Token& at, const string& msg)
+{
+	throw PreprocessorException((msg + " in " + file.path).c_str(), &at);
+}
+
+// Both tokens are from one file, next after first
+static bool sameLine(const Token& first, const Token& next)
+{
+	const char* end = first.source + first.length;
+	return memchr(end, '\n', next.source - end) == 0;
+}
+
+static PendingTokenT pendingToken(const Token& token)
+{
+	PendingTokenT pending;
+	pending.token = token;
+	pending.endOf = noName;
+	pending.painted = false;
+	return pending;
+}
+
+const SourceFileT* HeaderCache::find(const string& path)
+{
+	lock_guard<mutex> guard(lock);
+	map<string, SourceFileT*>::iterator it = files.find(path);
+	return it != files.end() ? it->second : 0;
+}
+
+// Takes file over; if another thread cached the same path meanwhile, that one is kept
+const SourceFileT* HeaderCache::add(SourceFileT* file)
+{
+	lock_guard<mutex> guard(lock);
+	SourceFileT*& cached = files[file->path];
+	if (cached)
+		delete file;
+	else
+		cached = file;
+	return cached;
+}
+
+void HeaderCache::clear()
+{
+	lock_guard<mutex> guard(lock);
+	for (map<string, SourceFileT*>::iterator it = files.begin(); it != files.end(); it++)
+		delete it->second;
+	files.clear();
+}
+
+int HeaderCache::size()
+{
+	lock_guard<mutex> guard(lock);
+	return files.size();
+}
+
+Preprocessor::Preprocessor(HeaderCache* headers): headers(headers ? headers : &ownHeaders), texts(0), literals(0), depth(0)
+{
+	definedId = Interner::current().intern("defined", 7);
+}
+
+// Directories separated by ';', as in the INCLUDE environment variable
+void Preprocessor::addIncludePath(const string& paths)
+{
+	size_t start = 0;
+	while (start <= paths.length())
+	{
+		size_t end = paths.find(';', start);
+		if (end == string::npos)
+			end = paths.length();
+		string dir = paths.substr(start, end - start);
+		if (!dir.empty())
+		{
+			if (dir[dir.length() - 1] != '/' && dir[dir.length() - 1] != '\\')
+				dir += '/';
+			includeDirs.push_back(dir);
+		}
+		start = end + 1;
+	}
+}
+
+void Preprocessor::run(const char* filename, deque<Token>& out, vector<shared_ptr<string>>& sources, LiteralPool& values)
+{
+	macros.clear();
+	expanding.clear();
+	included.clear();
+	depth = 0;
+	texts = &sources;
+	literals = &values;
+	SourceFileT file; // the translation unit itself is not cached
+	load(filename, file);
+	process(file, out);
+	out.push_back(file.eof);
+}
+
+// The literals of a file belong to the compilation that lexed it, so a string gets its value again
+void Preprocessor::emit(Token token, deque<Token>& out)
+{
+	if (token == STRING)
+		token.strVal = literals->add(token.source + 1, token.source + token.length - 1);
+	out.push_back(token);
+}
+
+void Preprocessor::load(const string& path, SourceFileT& file)
+{
+	Scanner scanner(path.c_str());
+	try {
+		Token* token = scanner.next();
+		for (; *token != END_OF_FILE; token = scanner.next())
+			file.tokens.push_back(*token);
+		file.eof = *token;
+	} catch (...) {
+		file.error = current_exception();
+	}
+	file.path = path;
+	size_t slash = path.find_last_of("/\\");
+	file.directory = slash == string::npos ? string() : path.substr(0, slash + 1);
+	file.text = scanner.sourceText();
+	file.guard = findGuard(file.tokens);
+	file.pragmaOnce = false;
+	NameIdT once = Interner::current().intern("once", 4);
+	for (int i = 0; i + 1 < file.tokens.size(); i++)
+		if (file.tokens[i] == PREPROCESSOR_DIRECTIVE && file.tokens[i].directive == PP_PRAGMA
+			&& file.tokens[i + 1] == IDENTIFIER && file.tokens[i + 1].nameId == once)
+			file.pragmaOnce = true;
+}
+
+// A file that is one #ifndef X ... #endif block adds nothing once X is defined,
+// so it need not be processed again
+NameIdT Preprocessor::findGuard(const vector<Token>& tokens)
+{
+	if (tokens.size() < 3 || tokens[0] != PREPROCESSOR_DIRECTIVE || tokens[0].directive != PP_IFNDEF
+		|| tokens[1] != IDENTIFIER || !sameLine(tokens[0], tokens[1]))
+		return noName;
+	int nesting = 0;
+	for (int i = 0; i < tokens.size(); i++)
+	{
+		if (tokens[i] != PREPROCESSOR_DIRECTIVE)
+			continue;
+		DirectivesT directive = tokens[i].directive;
+		if (directive == PP_IF || directive == PP_IFDEF || directive == PP_IFNDEF)
+			nesting++;
+		else if ((directive == PP_ELSE || directive == PP_ELIF) && nesting == 1)
+			return noName;
+		else if (directive == PP_ENDIF && --nesting == 0)
+			return i + 1 == tokens.size() ? tokens[1].nameId : noName;
+	}
+	return noName;
+}
+
+bool Preprocessor::fileExists(const string& path)
+{
+	ifstream input(path.c_str());
+	return input.good();
+}
+
+// Candidate paths are looked up in the cache first, so a known header is never opened again.
+// A new one is lexed with no lock held
+const SourceFileT* Preprocessor::resolve(const string& name, bool quoted, const SourceFileT& from)
+{
+	vector<string> candidates;
+	if (name[0] == '/' || name[0] == '\\' || name.find(':') != string::npos)
+		candidates.push_back(name);
+	else
+	{
+		if (quoted)
+			candidates.push_back(from.directory + name);
+		for (int i = 0; i < includeDirs.size(); i++)
+			candidates.push_back(includeDirs[i] + name);
+	}
+	for (int i = 0; i < candidates.size(); i++)
+	{
+		const SourceFileT* cached = headers->find(candidates[i]);
+		if (cached)
+			return cached;
+		if (fileExists(candidates[i]))
+		{
+			SourceFileT* file = new SourceFileT();
+			load(candidates[i], *file);
+			return headers->add(file);
+		}
+	}
+	return 0;
+}
+
+int Preprocessor::directiveEnd(const SourceFileT& file, int pos) const
+{
+	const vector<Token>& tokens = file.tokens;
+	int end = pos + 1;
+	while (end < tokens.size() && sameLine(tokens[end - 1], tokens[end]) && tokens[end] != PREPROCESSOR_DIRECTIVE)
+		end++;
+	return end;
+}
+
+void Preprocessor::process(const SourceFileT& file, deque<Token>& out)
+{
+	const vector<Token>& tokens = file.tokens;
+	if (++depth > maxIncludeDepth)
+		fail(file, tokens.empty() ? file.eof : tokens[0], "Includes are nested too deeply");
+	if (find(texts->begin(), texts->end(), file.text) == texts->end())
+		texts->push_back(file.text);
+	included.insert(&file);
+	vector<ConditionalT> conditionals;
+	int pos = 0;
+	while (pos < tokens.size())
+	{
+		bool active = conditionals.empty() || conditionals.back().active;
+		if (tokens[pos] != PREPROCESSOR_DIRECTIVE)
+		{
+			int end = pos;
+			while (end < tokens.size() && tokens[end] != PREPROCESSOR_DIRECTIVE)
+				end++;
+			if (active && macros.empty())
+				for (int i = pos; i < end; i++)
+					emit(tokens[i], out);
+			else if (active)
+			{
+				deque<PendingTokenT> input;
+				for (int i = pos; i < end; i++)
+					input.push_back(pendingToken(tokens[i]));
+				vector<PendingTokenT> expanded;
+				expand(input, expanded);
+				for (int i = 0; i < expanded.size(); i++)
+					emit(expanded[i].token, out);
+			}
+			pos = end;
+			continue;
+		}
+		const Token& directive = tokens[pos];
+		int end = directiveEnd(file, pos);
+		bool enclosing = conditionals.size() < 2 || conditionals[conditionals.size() - 2].active;
+		switch (directive.directive)
+		{
+		case PP_IF:
+		case PP_IFDEF:
+		case PP_IFNDEF:
+			{
+				ConditionalT conditional;
+				conditional.active = false;
+				if (active && directive.directive == PP_IF)
+					conditional.active = condition(file, pos + 1, end);
+				else if (active)
+				{
+					if (end != pos + 2 || tokens[pos + 1] != IDENTIFIER)
+						fail(file, directive, "Expected a macro name");
+					conditional.active = (macros.count(tokens[pos + 1].nameId) != 0) == (directive.directive == PP_IFDEF);
+				}
+				conditional.taken = conditional.active || !active;
+				conditional.sawElse = false;
+				conditionals.push_back(conditional);
+			}
+			break;
+		case PP_ELIF:
+			if (conditionals.empty() || conditionals.back().sawElse)
+				fail(file, directive, "#elif without #if");
+			if (conditionals.back().taken || !enclosing)
+				conditionals.back().active = false;
+			else
+				conditionals.back().taken = conditionals.back().active = condition(file, pos + 1, end);
+			break;
+		case PP_ELSE:
+			if (conditionals.empty() || conditionals.back().sawElse)
+				fail(file, directive, "#else without #if");
+			conditionals.back().active = enclosing && !conditionals.back().taken;
+			conditionals.back().taken = true;
+			conditionals.back().sawElse = true;
+			break;
+		case PP_ENDIF:
+			if (conditionals.empty())
+				fail(file, directive, "#endif without #if");
+			conditionals.pop_back();
+			break;
+		default:
+			if (!active)
+				break;
+			if (directive.directive == PP_DEFINE)
+				define(file, pos + 1, end);
+			else if (directive.directive == PP_UNDEF)
+			{
+				if (end != pos + 2 || tokens[pos + 1] != IDENTIFIER)
+					fail(file, directive, "Expected a macro name");
+				macros.erase(tokens[pos + 1].nameId);
+			}
+			else if (directive.directive == PP_INCLUDE)
+				include(file, pos + 1, end, out);
+			else if (directive.directive == PP_ERROR)
+			{
+				const char* from = directive.source + directive.length;
+				const char* to = end > pos + 1 ? tokens[end - 1].source + tokens[end - 1].length : from;
+				fail(file, directive, "#error" + string(from, to));
+			}
+		}
+		pos = end;
+	}
+	if (file.error)
+		rethrow_exception(file.error);
+	if (!conditionals.empty())
+		fail(file, file.eof, "Unterminated conditional directive");
+	depth--;
+}
+
+void Preprocessor::include(const SourceFileT& file, int begin, int end, deque<Token>& out)
+{
+	const vector<Token>& tokens = file.tokens;
+	const Token& directive = tokens[begin - 1];
+	string name;
+	bool quoted;
+	if (end == begin + 1 && tokens[begin] == STRING && tokens[begin].length > 2)
+	{
+		name = string(tokens[begin].source + 1, tokens[begin].length - 2);
+		quoted = true;
+	}
+	else if (end > begin + 2 && tokens[begin] == LESS && tokens[end - 1] == GREATER)
+	{
+		name = string(tokens[begin].source + 1, tokens[end - 1].source);
+		quoted = false;
+	}
+	else
+		fail(file, directive, "Expected \"file\" or <file> after #include");
+	const SourceFileT* header = resolve(name, quoted, file);
+	if (!header)
+		fail(file, directive, "Cannot open include file " + name);
+	if (header->pragmaOnce && included.count(header))
+		return;
+	if (header->guard != noName && macros.count(header->guard))
+		return;
+	process(*header, out);
+}
+
+void Preprocessor::define(const SourceFileT& file, int begin, int end)
+{
+	const vector<Token>& tokens = file.tokens;
+	if (begin == end || tokens[begin] != IDENTIFIER)
+		fail(file, tokens[begin - 1], "Expected a macro name");
+	const Token& name = tokens[begin];
+	MacroT macro;
+	macro.functionLike = false;
+	int pos = begin + 1;
+	// Only a parenthesis right after the name starts a parameter list
+	if (pos < end && tokens[pos] == PARENTHESIS_FRONT && tokens[pos].source == name.source + name.length)
+	{
+		macro.functionLike = true;
+		pos++;
+		if (pos < end && tokens[pos] == PARENTHESIS_BACK)
+			pos++;
+		else
+			while (true)
+			{
+				if (pos >= end || tokens[pos] != IDENTIFIER)
+					fail(file, name, "Expected a macro parameter");
+				macro.params.push_back(tokens[pos++].nameId);
+				if (pos < end && tokens[pos] == COMMA)
+					pos++;
+				else if (pos < end && tokens[pos] == PARENTHESIS_BACK)
+				{
+					pos++;
+					break;
+				}
+				else
+					fail(file, name, "Expected ',' or ')' in macro parameters");
+			}
+	}
+	macro.body.assign(tokens.begin() + pos, tokens.begin() + end);
+	macros[name.nameId] = macro;
+}
+
+// Rescans input until it is empty. A macro's replacement is pushed back in front of
+// the input followed by an end marker; while the marker is ahead the macro stays disabled
+void Preprocessor::expand(deque<PendingTokenT>& input, vector<PendingTokenT>& out)
+{
+	while (!input.empty())
+	{
+		PendingTokenT pending = input.front();
+		input.pop_front();
+		if (pending.endOf != noName)
+		{
+			expanding.pop_back();
+			continue;
+		}
+		map<NameIdT, MacroT>::const_iterator macro;
+		if (pending.token != IDENTIFIER || pending.painted || (macro = macros.find(pending.token.nameId)) == macros.end())
+		{
+			out.push_back(pending);
+			continue;
+		}
+		if (find(expanding.begin(), expanding.end(), pending.token.nameId) != expanding.end())
+		{
+			pending.painted = true;
+			out.push_back(pending);
+			continue;
+		}
+		vector<vector<PendingTokenT>> args;
+		if (macro->second.functionLike && !collectArgs(input, pending.token, args))
+		{
+			out.push_back(pending);
+			continue;
+		}
+		substitute(macro->second, pending.token, args, input);
+		expanding.push_back(pending.token.nameId);
+	}
+}
+
+// False if no argument list follows, then the name is left as it is
+bool Preprocessor::collectArgs(deque<PendingTokenT>& input, const Token& call, vector<vector<PendingTokenT>>& args)
+{
+	int ahead = 0;
+	while (ahead < input.size() && input[ahead].endOf != noName)
+		ahead++;
+	if (ahead == input.size() || input[ahead].token != PARENTHESIS_FRONT)
+		return false;
+	for (; ahead > 0; ahead--)
+	{
+		input.pop_front();
+		expanding.pop_back();
+	}
+	input.pop_front();
+	args.push_back(vector<PendingTokenT>());
+	int nesting = 0;
+	while (true)
+	{
+		if (input.empty())
+			throw PreprocessorException("Unterminated macro call", &call);
+		PendingTokenT pending = input.front();
+		input.pop_front();
+		if (pending.endOf != noName)
+		{
+			expanding.pop_back();
+			continue;
+		}
+		if (pending.token == PARENTHESIS_BACK && nesting-- == 0)
+			break;
+		if (pending.token == PARENTHESIS_FRONT)
+			nesting++;
+		if (pending.token == COMMA && nesting == 0)
+			args.push_back(vector<PendingTokenT>());
+		else
+			args.back().push_back(pending);
+	}
+	return true;
+}
+
+void Preprocessor::substitute(const MacroT& macro, const Token& call, vector<vector<PendingTokenT>>& args, deque<PendingTokenT>& input)
+{
+	if (macro.functionLike)
+	{
+		if (macro.params.empty() && args.size() == 1 && args[0].empty())
+			args.clear();
+		if (args.size() != macro.params.size())
+			throw PreprocessorException("Wrong number of macro arguments", &call);
+		for (int i = 0; i < args.size(); i++)
+		{
+			deque<PendingTokenT> arg(args[i].begin(), args[i].end());
+			vector<PendingTokenT> expanded;
+			expand(arg, expanded);
+			args[i].swap(expanded);
+		}
+	}
+	PendingTokenT marker = pendingToken(call);
+	marker.endOf = call.nameId;
+	input.push_front(marker);
+	for (int i = (int) macro.body.size() - 1; i >= 0; i--)
+	{
+		const Token& token = macro.body[i];
+		int param = -1;
+		for (int j = 0; token == IDENTIFIER && j < macro.params.size(); j++)
+			if (macro.params[j] == token.nameId)
+				param = j;
+		if (param != -1)
+		{
+			input.insert(input.begin(), args[param].begin(), args[param].end());
+			continue;
+		}
+		input.push_front(pendingToken(token));
+	}
+}
+
+static int conditionPriority(OperationsT op)
+{
+	switch (op)
+	{
+	case LOGICAL_OR:
+		return 1;
+	case LOGICAL_AND:
+		return 2;
+	case BITWISE_OR:
+		return 3;
+	case BITWISE_XOR:
+		return 4;
+	case BITWISE_AND:
+		return 5;
+	case EQUAL:
+	case NOT_EQUAL:
+		return 6;
+	case LESS:
+	case LESS_OR_EQUAL:
+	case GREATER:
+	case GREATER_OR_EQUAL:
+		return 7;
+	case BITWISE_SHIFT_LEFT:
+	case BITWISE_SHIFT_RIGHT:
+		return 8;
+	case PLUS:
+	case MINUS:
+		return 9;
+	case MULT:
+	case DIV:
+	case MOD:
+		return 10;
+	}
+	return -1;
+}
+
+static const Token& conditionToken(const vector<PendingTokenT>& tokens, int pos)
+{
+	return tokens[pos < tokens.size() ? pos : tokens.size() - 1].token;
+}
+
+static long long evaluateCondition(const vector<PendingTokenT>& tokens, int& pos, int minPriority);
+
+static void expectInCondition(const vector<PendingTokenT>& tokens, int& pos, OperationsT op)
+{
+	if (pos >= tokens.size() || tokens[pos].token != op)
+	{
+		const Token& at = conditionToken(tokens, pos);
+		throw PreprocessorException(op == COLON ? "Expected ':' in #if expression" : "Expected ')' in #if expression", &at);
+	}
+	pos++;
+}
+
+static long long evaluatePrimary(const vector<PendingTokenT>& tokens, int& pos)
+{
+	const Token& token = conditionToken(tokens, pos);
+	if (pos++ >= tokens.size())
+		throw PreprocessorException("Unexpected end of #if expression", &token);
+	if (token == INTEGER)
+		return token.intVal;
+	if (token == CHARACTER)
+		return token.charVal;
+	if (token == IDENTIFIER)
+		return 0;
+	if (token == PARENTHESIS_FRONT)
+	{
+		long long value = evaluateCondition(tokens, pos, 0);
+		expectInCondition(tokens, pos, PARENTHESIS_BACK);
+		return value;
+	}
+	if (token == MINUS)
+		return -evaluatePrimary(tokens, pos);
+	if (token == PLUS)
+		return evaluatePrimary(tokens, pos);
+	if (token == LOGICAL_NOT)
+		return !evaluatePrimary(tokens, pos);
+	if (token == BITWISE_NOT)
+		return ~evaluatePrimary(tokens, pos);
+	throw PreprocessorException("Invalid token in #if expression", &token);
+}
+
+static long long evaluateCondition(const vector<PendingTokenT>& tokens, int& pos, int minPriority)
+{
+	long long left = evaluatePrimary(tokens, pos);
+	while (pos < tokens.size() && tokens[pos].token == OPERATION)
+	{
+		const Token& token = tokens[pos].token;
+		if (token == QUESTION)
+		{
+			if (minPriority > 0)
+				break;
+			pos++;
+			long long then = evaluateCondition(tokens, pos, 0);
+			expectInCondition(tokens, pos, COLON);
+			long long otherwise = evaluateCondition(tokens, pos, 0);
+			left = left ? then : otherwise;
+			continue;
+		}
+		int priority = conditionPriority(token.op);
+		if (priority == -1 || priority < minPriority)
+			break;
+		pos++;
+		long long right = evaluateCondition(tokens, pos, priority + 1);
+		if ((token == DIV || token == MOD) && right == 0)
+			throw PreprocessorException("Division by zero in #if expression", &token);
+		switch (token.op)
+		{
+		case LOGICAL_OR: left = left || right; break;
+		case LOGICAL_AND: left = left && right; break;
+		case BITWISE_OR: left |= right; break;
+		case BITWISE_XOR: left ^= right; break;
+		case BITWISE_AND: left &= right; break;
+		case EQUAL: left = left == right; break;
+		case NOT_EQUAL: left = left != right; break;
+		case LESS: left = left < right; break;
+		case LESS_OR_EQUAL: left = left <= right; break;
+		case GREATER: left = left > right; break;
+		case GREATER_OR_EQUAL: left = left >= right; break;
+		case BITWISE_SHIFT_LEFT: left <<= right; break;
+		case BITWISE_SHIFT_RIGHT: left >>= right; break;
+		case PLUS: left += right; break;
+		case MINUS: left -= right; break;
+		case MULT: left *= right; break;
+		case DIV: left /= right; break;
+		case MOD: left %= right; break;
+		}
+	}
+	return left;
+}
+
+// defined is resolved before expansion, identifiers left after it count as 0
+bool Preprocessor::condition(const SourceFileT& file, int begin, int end)
+{
+	const vector<Token>& tokens = file.tokens;
+	deque<PendingTokenT> input;
+	for (int i = begin; i < end; i++)
+	{
+		if (tokens[i] != IDENTIFIER || tokens[i].nameId != definedId)
+		{
+			input.push_back(pendingToken(tokens[i]));
+			continue;
+		}
+		bool paren = i + 1 < end && tokens[i + 1] == PARENTHESIS_FRONT;
+		int name = i + 1 + paren;
+		if (name >= end || tokens[name] != IDENTIFIER || paren && (name + 1 >= end || tokens[name + 1] != PARENTHESIS_BACK))
+			fail(file, tokens[i], "Expected a macro name after defined");
+		PendingTokenT value = pendingToken(tokens[i]);
+		value.token.type = INTEGER;
+		value.token.intVal = macros.count(tokens[name].nameId) != 0;
+		input.push_back(value);
+		i = name + paren;
+	}
+	vector<PendingTokenT> expanded;
+	expand(input, expanded);
+	if (expanded.empty())
+		fail(file, tokens[begin - 1], "Expected an expression after #if");
+	int pos = 0;
+	long long value = evaluateCondition(expanded, pos, 0);
+	if (pos != expanded.size())
+		fail(file, expanded[pos].token, "Unexpected token in #if expression");
+	return value != 0;
+}
@@ -0,0 +1,98 @@
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include "Tokens.h"
+#include "Exceptions.h"
+
+using namespace std;
+
+// A file lexed once; a header kept in a HeaderCache is read and scanned only the first time
+typedef struct {
+	string path;
+	string directory;
+	shared_ptr<string> text;
+	vector<Token> tokens;
+	Token eof;
+	NameIdT guard; // macro of an #ifndef guard around the whole file, noName if there is none
+	bool pragmaOnce;
+	exception_ptr error; // set if the scanner failed; tokens hold what came before
+} SourceFileT;
+
+typedef struct {
+	bool functionLike;
+	vector<NameIdT> params;
+	vector<Token> body;
+} MacroT;
+
+// Token waiting to be rescanned; endOf != noName marks where the expansion of that macro ends
+typedef struct {
+	Token token;
+	NameIdT endOf;
+	bool painted; // met inside its own expansion, never expanded again
+} PendingTokenT;
+
+typedef struct {
+	bool active;
+	bool taken;
+	bool sawElse;
+} ConditionalT;
+
+// Headers found by #include, shared by the translation units of one BatchCompiler run or kept
+// by one Preprocessor. A name that was not found is looked for again the next time
+class HeaderCache
+{
+private:
+	map<string, SourceFileT*> files;
+	mutex lock;
+	HeaderCache(const HeaderCache&);
+	HeaderCache& operator = (const HeaderCache&);
+public:
+	HeaderCache() {}
+	~HeaderCache() { clear(); }
+	const SourceFileT* find(const string& path);
+	const SourceFileT* add(SourceFileT* file);
+	void clear();
+	int size();
+};
+
+class Preprocessor
+{
+private:
+	HeaderCache ownHeaders;
+	HeaderCache* headers; // ownHeaders unless one is shared
+	vector<string> includeDirs;
+	map<NameIdT, MacroT> macros;
+	vector<NameIdT> expanding;
+	set<const SourceFileT*> included;
+	vector<shared_ptr<string>>* texts;
+	LiteralPool* literals; // of the tokens out gets
+	int depth;
+	NameIdT definedId;
+	static void load(const string& path, SourceFileT& file);
+	static NameIdT findGuard(const vector<Token>& tokens);
+	static bool fileExists(const string& path);
+	const SourceFileT* resolve(const string& name, bool quoted, const SourceFileT& from);
+	void process(const SourceFileT& file, deque<Token>& out);
+	void emit(Token token, deque<Token>& out);
+	int directiveEnd(const SourceFileT& file, int pos) const;
+	void include(const SourceFileT& file, int begin, int end, deque<Token>& out);
+	void define(const SourceFileT& file, int begin, int end);
+	bool condition(const SourceFileT& file, int begin, int end);
+	void expand(deque<PendingTokenT>& input, vector<PendingTokenT>& out);
+	bool collectArgs(deque<PendingTokenT>& input, const Token& call, vector<vector<PendingTokenT>>& args);
+	void substitute(const MacroT& macro, const Token& call, vector<vector<PendingTokenT>>& args, deque<PendingTokenT>& input);
+public:
+	Preprocessor(HeaderCache* headers = 0);
+	void addIncludePath(const string& paths);
+	void run(const char* filename, deque<Token>& out, vector<shared_ptr<string>>& sources, LiteralPool& values);
+};
+
+#endif
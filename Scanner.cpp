@@ -1,21 +1,363 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <map>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
 #include "Scanner.h"
+#include "Preprocessor.h"
+#include "SourceMap.h"
 
 using namespace std;
 
-Scanner::Scanner(const char* filename): input(filename), filename(filename), line(1), col(1),
-	cur_tok(0), cur_state(START), buffer(""), transitions(0)
+// Event for every byte value; 0xff doubles as EOF, just like char(-1) from get()
+static const LexerEventsT charClasses[256] = {
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // 00-07
+	UNKNOWN, SPACE_FOUNDED, NEWLINE_FOUDED, SPACE_FOUNDED, SPACE_FOUNDED, SPACE_FOUNDED, UNKNOWN, UNKNOWN, // 08-0f
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // 10-17
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // 18-1f
+	SPACE_FOUNDED, EXCLAMATION_MARK_FOUNDED, DOUBLE_QUOTE_FOUNDED, GRID_FOUNDED, UNKNOWN, PERCENT_FOUNDED, AMP_FOUNDED, QUOTE_FOUNDED, // 20 ! " # $ % & '
+	OP_FOUNDED, OP_FOUNDED, ASTERISK_FOUNDED, PLUS_FOUNDED, OP_FOUNDED, MINUS_FOUNDED, DOT_FOUNDED, SLASH_FOUNDED, // ( ) * + , - . /
+	DIGIT_FOUNDED, DIGIT_FOUNDED, DIGIT_FOUNDED, DIGIT_FOUNDED, DIGIT_FOUNDED, DIGIT_FOUNDED, DIGIT_FOUNDED, DIGIT_FOUNDED, // 0 1 2 3 4 5 6 7
+	DIGIT_FOUNDED, DIGIT_FOUNDED, COLON_FOUNDED, SEPARATOR_FOUNDED, LESS_OP_FOUNDED, EQUAL_OP_FOUNDED, GREATER_OP_FOUNDED, QUESTION_MARK_FOUNDED, // 8 9 : ; < = > ?
+	UNKNOWN, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, // @ A B C D E F G
+	LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, // H I J K L M N O
+	LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, // P Q R S T U V W
+	LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, OP_FOUNDED, BACKSLASH_FOUNDED, OP_FOUNDED, CIRCUMFLEX_FOUNDED, UNDERSCOPE_FOUNDED, // X Y Z [ \ ] ^ _
+	UNKNOWN, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, E_CHAR_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, // ` a b c d e f g
+	LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, // h i j k l m n o
+	LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, // p q r s t u v w
+	LETTER_FOUNDED, LETTER_FOUNDED, LETTER_FOUNDED, SEPARATOR_FOUNDED, PIPE_FOUNDED, SEPARATOR_FOUNDED, OP_FOUNDED, UNKNOWN, // x y z { | } ~ 7f
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // 80-87
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // 88-8f
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // 90-97
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // 98-9f
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // a0-a7
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // a8-af
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // b0-b7
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // b8-bf
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // c0-c7
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // c8-cf
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // d0-d7
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // d8-df
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // e0-e7
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // e8-ef
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, // f0-f7
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, EOF_FOUNDED // f8-ff
+};
+
+static const char* const reservedWords[] = { "break", "char", "const", "continue", "do", "else", "float", "for", 
+	"if", "int", "return", "struct", "sizeof", "typedef", "void",  "while", "printf", "scanf" };
+
+static const char* const operations[] = { "+", "-", "*", "/", "%", "++", "--", "+=", "-=", "*=", "/=", "%=", "?", ":",
+	"&", "|", "&&", "||", "!", "^", "&=", "|=", "^=", "=", "==", "!=", ">", "<", ">=", "<=", "<<", ">>", ".", "->",
+	"<<=", ">>=", "(", ")", "[", "]", ",", "~" };
+
+static const char* const directives[] = { "#define", "#undef", "#include", "#if", "#ifdef", "#ifndef", "#else",
+	"#elif", "#endif", "#line", "#error", "#pragma", "#" };
+
+// Slot -> word index, -1 for empty slots. Multipliers were found by an offline search
+// so that every word of a table lands in its own slot; see perfectHashFind
+static const signed char reservedWordSlots[32] = {
+	9, 8, -1, -1, -1, -1, 5, -1, 3, 1, -1, 7, 16, 11, 17, 12,
+	-1, 13, -1, -1, -1, -1, 10, -1, -1, 15, 0, -1, 2, 4, 14, 6
+};
+
+static const signed char operationSlots[128] = {
+	29, 34, 23, 24, -1, -1, 28, 35, 0, 5, 4, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, 26, 31, -1, -1, -1, -1, 40, -1, 14,
+	16, -1, 39, -1, -1, -1, -1, -1, -1, -1, -1, -1, 12, 15, 17, 25,
+	-1, -1, 1, 6, -1, -1, 18, 19, -1, -1, -1, 11, -1, -1, 20, -1,
+	21, -1, -1, 13, -1, -1, -1, 32, -1, 36, 9, -1, -1, 7, -1, -1,
+	-1, -1, -1, 8, -1, -1, -1, 41, -1, 10, -1, -1, 3, -1, 37, -1,
+	-1, -1, -1, -1, -1, 33, 22, -1, -1, -1, -1, -1, -1, 27, 30, -1,
+	-1, -1, -1, 2, -1, -1, -1, -1, 38, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const signed char directiveSlots[32] = {
+	6, -1, -1, 9, 1, 3, -1, -1, 4, 5, -1, -1, 12, 11, -1, -1,
+	-1, -1, -1, 7, 8, -1, -1, 2, 10, -1, -1, -1, -1, 0, -1, -1
+};
+
+static const PerfectHashT reservedWordsHash = { reservedWords, reservedWordSlots, 31, 1, 0, 25 };
+static const PerfectHashT operationsHash = { operations, operationSlots, 127, 3, 0, 18 };
+static const PerfectHashT directivesHash = { directives, directiveSlots, 31, 1, 5, 19 };
+
+// slot = (first * a + second * b + last * c + length) & mask, then one compare confirms the hit
+static int perfectHashFind(const PerfectHashT& table, const char* word, size_t length)
 {
+	if (length == 0)
+		return -1;
+	const unsigned char* s = (const unsigned char*) word;
+	unsigned slot = (s[0] * table.first + s[length > 1 ? 1 : 0] * table.second 
+		+ s[length - 1] * table.last + length) & table.mask;
+	int idx = table.slots[slot];
+	if (idx == -1)
+		return -1;
+	const char* candidate = table.words[idx];
+	return strlen(candidate) == length && memcmp(candidate, s, length) == 0 ? idx : -1;
+}
+
+// Bytes that can move the DFA out of IN_COMMENT, IN_INLINE_COMMENT and STR; 0xff reads as EOF.
+// '\n' stops every search so lex() sees every line start
+static const char commentStops[4] = { '*', '\n', (char) 0xff, '*' };
+static const char inlineCommentStops[4] = { '\n', (char) 0xff, '\n', '\n' };
+static const char stringStops[4] = { '"', '\\', '\n', (char) 0xff };
+
+TransitionTableT Scanner::transitions;
+bool Scanner::transitionsReady = Scanner::initTransitions();
+FindStopCharT Scanner::findStopChar = selectFindStopChar();
+
+Scanner::Scanner(const char* filename): filename(filename), source(new string()), literals(new LiteralPool()), 
+	cursor(0), sourceEnd(0), tokenStart(0), tokenEnd(0), colOrigin(0), pastEnd(0), cur_tok(0), current(0), cur_state(START), 
+	replayed(-1), editable(false), replaying(&tokens)
+{
+	loadFile(filename);
+	SourceMap::current().add(source);
+	lineStart = cursor = source->data();
+	sourceEnd = cursor + source->length();
+}
+
+// Takes the whole preprocessed stream up front; next() then only walks it
+Scanner::Scanner(const char* filename, Preprocessor& preprocessor): filename(filename), literals(new LiteralPool()), 
+	tokenStart(0), tokenEnd(0), colOrigin(0), pastEnd(0), cur_tok(0), current(0), cur_state(END), 
+	replayed(0), editable(false), replaying(&tokens)
+{
+	try {
+		preprocessor.run(filename, tokens, includedSources, *literals);
+	} catch (...) {
+		if (includedSources.empty())
+			throw;
+		lexError = current_exception(); // raised when next() gets this far, as a lexing scanner would
+	}
+	source = includedSources[0];
+	lineStart = cursor = sourceEnd = source->data() + source->length();
+}
+
+Scanner::Scanner(const Scanner& clone): cur_tok(0), current(0), source(clone.source), literals(clone.literals), 
+	cursor(clone.source->data()), sourceEnd(clone.sourceEnd), lineStart(clone.source->data()), tokenStart(0), tokenEnd(0), 
+	filename(clone.filename), cur_state(START), colOrigin(0), pastEnd(0), replayed(-1), editable(false), replaying(&tokens)
+{
+	if (clone.replayed == -1)
+		return;
+	tokens = *clone.replaying;
+	includedSources = clone.includedSources;
+	lexError = clone.lexError;
+	cursor = sourceEnd;
+	cur_state = END;
+	replayed = 0;
+}
+
+// Replays the tokens of whole from position on without copying them; whole must replay and outlive the view
+Scanner::Scanner(const Scanner& whole, int position): filename(whole.filename), source(whole.source), 
+	literals(whole.literals), cursor(whole.sourceEnd), sourceEnd(whole.sourceEnd), lineStart(whole.sourceEnd), 
+	tokenStart(0), tokenEnd(0), colOrigin(0), pastEnd(0), cur_tok(0), current(0), cur_state(END), 
+	replayed(0), editable(false), replaying(whole.replaying), lexError(whole.lexError)
+{
+	seek(position);
+}
+
+// Tokens point into the input, so a stream is read up front as well
+Scanner::Scanner(istream& in): filename(""), source(new string(istreambuf_iterator<char>(in), istreambuf_iterator<char>())), 
+	literals(new LiteralPool()), tokenStart(0), tokenEnd(0), colOrigin(0), pastEnd(0), cur_tok(0), current(0), 
+	cur_state(START), replayed(-1), editable(false), replaying(&tokens)
+{
+	SourceMap::current().add(source);
+	lineStart = cursor = source->data();
+	sourceEnd = cursor + source->length();
+}
+
+// Column 1 is where the next lex() call treats the column specially
+static bool startsLine(const string& text, unsigned offset)
+{
+	return offset == 0 || offset <= text.length() && text[offset - 1] == '\n';
+}
+
+// Lexes old's input with [editStart, editEnd) replaced by text. Tokens before the edit are copied,
+// the DFA resumes from the last checkpoint before it and stops as soon as it is back in a state old 
+// passed through after the edit; the rest of old's tokens are then shifted into place.
+// old must have been lexed after trackEdits(), or this lexes the new input from the start
+Scanner::Scanner(const Scanner& old, size_t editStart, size_t editEnd, const string& text): filename(old.filename), 
+	source(new string(*old.source, 0, editStart)), literals(old.literals), tokenStart(0), tokenEnd(0), colOrigin(0), 
+	pastEnd(0), cur_tok(0), current(0), cur_state(START), replayed(-1), editable(true), replaying(&tokens)
+{
+	source->append(text).append(*old.source, editEnd, string::npos);
+	SourceMap::current().add(source);
+	lineStart = cursor = source->data();
+	sourceEnd = cursor + source->length();
+	long long shift = (long long) text.length() - (long long) (editEnd - editStart);
+
+	bool complete = !old.checkpoints.empty() && old.checkpoints[0].cursor == 0; // nothing dropped
+	int resume = 0;
+	while (complete && resume < old.checkpoints.size() && old.checkpoints[resume].cursor <= editStart 
+		&& old.checkpoints[resume].state != END)
+		resume++;
+	resume = max(resume - 1, 0);
+	if (complete)
+	{
+		appendRebased(old, 0, resume, 0);
+		restore(old.checkpoints[resume]);
+	}
+
+	size_t editEndNow = editStart + text.length();
+	while (!current || *current != END_OF_FILE)
+	{
+		ScanCheckpointT point = checkpoint();
+		if (complete && point.cursor >= editEndNow && (point.tokenStart == -1 || point.tokenStart >= editEndNow))
+		{
+			int same = old.findCheckpoint((unsigned) (point.cursor - shift));
+			if (same != -1)
+			{
+				const ScanCheckpointT& was = old.checkpoints[same];
+				if (was.state == point.state && was.colOrigin + shift == point.colOrigin
+					&& startsLine(*old.source, was.colOrigin) == startsLine(*source, point.colOrigin)
+					&& (was.tokenStart == -1 ? point.tokenStart == -1 : was.tokenStart + shift == point.tokenStart))
+				{
+					appendRebased(old, same, old.tokens.size(), shift);
+					cursor = old.cursor - old.source->data() + shift + source->data();
+					tokenStart = old.tokenStart ? old.tokenStart - old.source->data() + shift + source->data() : 0;
+					cur_state = old.cur_state;
+					colOrigin = old.colOrigin + shift;
+					pastEnd = old.pastEnd;
+					findLineStart();
+					current = &tokens.back();
+					break;
+				}
+			}
+		}
+		current = lex();
+	}
+}
+
+ScanCheckpointT Scanner::checkpoint() const
+{
+	ScanCheckpointT point;
+	point.cursor = cursor - source->data();
+	point.tokenStart = tokenStart ? tokenStart - source->data() : -1;
+	point.state = cur_state;
+	point.colOrigin = colOrigin;
+	return point;
+}
+
+void Scanner::restore(const ScanCheckpointT& point)
+{
+	cursor = source->data() + point.cursor;
+	tokenStart = point.tokenStart == -1 ? 0 : source->data() + point.tokenStart;
+	cur_state = point.state;
+	colOrigin = point.colOrigin;
+	pastEnd = 0;
+	findLineStart();
+	cur_tok = 0;
+}
+
+void Scanner::findLineStart()
+{
+	lineStart = cursor;
+	while (lineStart > source->data() && lineStart[-1] != '\n')
+		lineStart--;
+}
+
+static bool checkpointBefore(const ScanCheckpointT& a, const ScanCheckpointT& b)
+{
+	return a.cursor < b.cursor;
+}
+
+// Index of the checkpoint taken at the given input offset, -1 if there is none
+int Scanner::findCheckpoint(unsigned cursor) const
+{
+	ScanCheckpointT key;
+	key.cursor = cursor;
+	vector<ScanCheckpointT>::const_iterator it = lower_bound(checkpoints.begin(), checkpoints.end(), key, checkpointBefore);
+	return it != checkpoints.end() && it->cursor == cursor ? it - checkpoints.begin() : -1;
+}
+
+void Scanner::appendRebased(const Scanner& old, int from, int to, long long shift)
+{
+	const char* oldBase = old.source->data();
+	for (int i = from; i < to; i++)
+	{
+		Token token = old.tokens[i];
+		token.source = source->data() + (token.source - oldBase) + shift;
+		token.offset += shift;
+		tokens.push_back(token);
+		ScanCheckpointT point = old.checkpoints[i];
+		point.cursor += shift;
+		if (point.tokenStart != -1)
+			point.tokenStart += shift;
+		point.colOrigin += shift;
+		checkpoints.push_back(point);
+	}
+}
+
+void Scanner::loadFile(const char* filename)
+{
+	ifstream input(filename);
 	if (!input)
 		throw exception("Illegal filename");
+	input.seekg(0, ios::end);
+	streamoff size = input.tellg();
+	input.seekg(0, ios::beg);
+	source->resize(size > 0 ? (size_t) size : 0);
+	if (size > 0)
+	{
+		input.read(&(*source)[0], size);
+		source->resize(input.gcount()); // text mode may shrink line endings
+	}
+}
 
-	transitions.resize(STATES_COUNT);
-	for (int i = 0; i < STATES_COUNT; i++)
-		transitions[i].resize(EVENTS_COUNT);	
-	
+// Reads past the end count too, as each of them moves the column on
+char Scanner::readChar()
+{
+	if (cursor < sourceEnd)
+		return *cursor++;
+	pastEnd++;
+	return -1;
+}
+
+void Scanner::skipPlainChars()
+{
+	const char* stops = cur_state == STR ? stringStops : cur_state == IN_COMMENT ? commentStops : inlineCommentStops;
+	cursor = findStopChar(cursor, sourceEnd, stops);
+}
+
+int Scanner::currentLine() const
+{
+	int line, col;
+	SourceMap::current().locate(tokenEnd, colOrigin, line, col);
+	return line;
+}
+
+int Scanner::currentCol() const
+{
+	int line, col;
+	SourceMap::current().locate(tokenEnd, colOrigin, line, col);
+	return col;
+}
+
+string Scanner::tokenText() const
+{
+	return tokenStart ? string(tokenStart, tokenEnd - tokenStart) : string();
+}
+
+Token* Scanner::addToken(TokenTypesT type)
+{
+	size_t length = tokenStart ? tokenEnd - tokenStart : 0;
+	if (length > maxTokenLength)
+		throw ScannerException("Token is too long", currentLine(), currentCol());
+	Token token;
+	token.source = tokenStart ? tokenStart : tokenEnd;
+	token.offset = colOrigin;
+	token.length = (unsigned) length;
+	token.type = type;
+	token.intVal = 0;
+	tokens.push_back(token);
+	tokenStart = 0;
+	cur_tok = &tokens.back();
+	return cur_tok;
+}
+
+bool Scanner::initTransitions()
+{
 	addDefaultTransition(START);
 	addAnyEventTransition(END, END, &Scanner::EOFDetected);
 
@@ -156,6 +498,15 @@ Scanner::Scanner(const char* filename): input(filename), filename(filename), lin
 	addAnyEventTransition(SINGLE_CHAR_CLOSE, ERROR, &Scanner::ParseError);
 	addTransition(SINGLE_CHAR_CLOSE, QUOTE_FOUNDED, CHAR_END, 0);
 	addTransition(ESC_IN_CHAR, BACKSLASH_FOUNDED, SINGLE_CHAR_CLOSE, 0);
+	// \n, \0, \101, \x41: the escape is checked when the char is detected
+	addTransition(ESC_IN_CHAR, LETTER_FOUNDED, ESC_SEQ_IN_CHAR, 0);
+	addTransition(ESC_IN_CHAR, E_CHAR_FOUNDED, ESC_SEQ_IN_CHAR, 0);
+	addTransition(ESC_IN_CHAR, DIGIT_FOUNDED, ESC_SEQ_IN_CHAR, 0);
+	addAnyEventTransition(ESC_SEQ_IN_CHAR, ERROR, &Scanner::ParseError);
+	addTransition(ESC_SEQ_IN_CHAR, LETTER_FOUNDED, ESC_SEQ_IN_CHAR, 0);
+	addTransition(ESC_SEQ_IN_CHAR, E_CHAR_FOUNDED, ESC_SEQ_IN_CHAR, 0);
+	addTransition(ESC_SEQ_IN_CHAR, DIGIT_FOUNDED, ESC_SEQ_IN_CHAR, 0);
+	addTransition(ESC_SEQ_IN_CHAR, QUOTE_FOUNDED, CHAR_END, 0);
 
 	// String
 	lockItself(STR);
@@ -199,114 +550,93 @@ Scanner::Scanner(const char* filename): input(filename), filename(filename), lin
 	addDefaultTransition(ASSING_OP, &Scanner::OperationDetected);
 	addTransition(ASSING_OP, EQUAL_OP_FOUNDED, EQUAL_OP, 0);
 	addDefaultTransition(EQUAL_OP, &Scanner::OperationDetected);
+	return true;
 }
 
 Token* Scanner::next()
 {
+	if (replayed != -1)
+	{
+		if (replayed < replaying->size())
+			return current = &(*replaying)[replayed++];
+		if (lexError)
+			rethrow_exception(lexError);
+		return current;
+	}
+	return current = lex();
+}
+
+Token* Scanner::lex()
+{
+	if (editable)
+		checkpoints.push_back(checkpoint());
 	LexerStatesT tmp = cur_state;
-	int shift = col == 1 ? -1 : 0;
-	bool nl = false;
+	unsigned start = cursor - source->data() + pastEnd;
+	unsigned startOrigin = colOrigin;
+	bool atLineStart = source->data() + colOrigin == lineStart;
+	bool newLine = false;
 	bool loop = true;
 	while (loop)
 	{
-		char c;
-		c = input.get();
-		shift++;
-		LexerEventsT event;
-		if (c == -1)
-			event = EOF_FOUNDED;
-		else if (c == '#')
-			event = GRID_FOUNDED;
-		else if (c == 'e')
-			event = E_CHAR_FOUNDED;
-		else if (isalpha(c))
-			event = LETTER_FOUNDED;
-		else if (isalnum(c))
-			event = DIGIT_FOUNDED;
-		else if (c == '_')
-			event = UNDERSCOPE_FOUNDED;
-		else if (c == '.')
-			event = DOT_FOUNDED;
-		else if (c == '/')
-			event = SLASH_FOUNDED;
-		else if (c == '\\')
-			event = BACKSLASH_FOUNDED;
-		else if (c == '*')
-			event = ASTERISK_FOUNDED;
-		else if (c == '+') 
-			event = PLUS_FOUNDED;
-		else if (c == '-') 
-			event = MINUS_FOUNDED;
-		else if (c == '\'')
-			event = QUOTE_FOUNDED;
-		else if (c == '"')
-			event = DOUBLE_QUOTE_FOUNDED;
-		else if (c == '&')
-			event = AMP_FOUNDED;
-		else if (c == '|')
-			event = PIPE_FOUNDED;
-		else if (c == '%') 
-			event = PERCENT_FOUNDED;
-		else if(c == '^')
-			event = CIRCUMFLEX_FOUNDED;
-		else if (c == '{' || c == '}' || c == ';')
-			event = SEPARATOR_FOUNDED;
-		else if (c == '(' || c == ')' || c == '[' 
-				|| c == ']' || c == ',' || c == '~')
-			event = OP_FOUNDED;
-		else if (c == ':')
-			event = COLON_FOUNDED;
-		else if (c == '\n') 
-		{
-			event = NEWLINE_FOUDED;
-			nl = true;
-		} else if (isspace(c))
-			event = SPACE_FOUNDED;
-		else if (c == '?')
-			event = QUESTION_MARK_FOUNDED;
-		else if (c == '!')
-			event = EXCLAMATION_MARK_FOUNDED;
-		else if (c == '>')
-			event = GREATER_OP_FOUNDED;
-		else if (c == '<')
-			event = LESS_OP_FOUNDED;
-		else if (c == '=')
-			event = EQUAL_OP_FOUNDED;
-		else
-			event = UNKNOWN;
+		if (cur_state == IN_COMMENT || cur_state == IN_INLINE_COMMENT || cur_state == STR)
+			skipPlainChars();
+		tokenEnd = cursor;
+		char c = readChar();
+		LexerEventsT event = charClasses[(unsigned char) c];
+		bool nl = event == NEWLINE_FOUDED;
 		LexerTransitionT& trans = transitions[cur_state][event];
 		cur_state = trans.targetState;
 		if (tmp == START)
 			tmp = cur_state;
 		if (trans.action)
 		{
+			cur_tok = 0;
 			(this->*(trans.action))();
-			loop = false;
+			loop = !cur_tok; // comments produce no token
 		}		
-		if (!isspace(c) || cur_state == IN_COMMENT || cur_state == IN_INLINE_COMMENT || cur_state == STR)
-			buffer.push_back(c);
+		if (!tokenStart && (!nl && event != SPACE_FOUNDED || cur_state == IN_COMMENT || cur_state == IN_INLINE_COMMENT || cur_state == STR))
+			tokenStart = tokenEnd;
 		if (nl)
 		{
-			line++;
-			col = 1;
-			shift = 0;
-			nl = false;
+			lineStart = cursor;
+			colOrigin = cursor - source->data(); // tokens after a newline report column 1
+			newLine = true;
 		}
-		if (dynamic_cast<CommentToken*>(cur_tok))
-			loop = true;
 	}
-	col += shift;
+	// The column advances by the bytes read, one less when the call began at column 1,
+	// and starts over after a newline
+	unsigned end = cursor - source->data() + pastEnd;
+	colOrigin = newLine ? end : startOrigin + (end - start) - atLineStart;
 	return cur_tok;
 }
 
+// Frees the tokens scanned so far; only for callers that keep no Token* around
+void Scanner::dropTokens()
+{
+	if (replayed != -1)
+		return;
+	tokens.clear();
+	checkpoints.clear();
+	cur_tok = current = 0;
+}
+
 bool Scanner::hasNext() const
 {
+	if (replayed != -1)
+		return !current || *current != END_OF_FILE;
 	return cur_state != END;
 }
 
+// Makes the token at position current again; only for scanners that replay
+void Scanner::seek(int position)
+{
+	current = &(*replaying)[position];
+	replayed = position + 1;
+}
+
 Token* Scanner::get() 
 {
-	return cur_tok;
+	return current;
 }
 
 void Scanner::addDefaultTransition(LexerStatesT state, LexerActionT action)
@@ -418,66 +748,29 @@ void Scanner::addTransition(LexerStatesT fromState, LexerEventsT event, LexerSta
 	trans.action = act;
 }
 
-char Scanner::escapingChar(const string& key)
+int Scanner::reservedWordIndex(const string& word)
 {
-	map<string, char> table;
-	table["\\n"] = '\n';
-	table["\\t"] = '\t';
-	table["\\\\"] = '\\';
-	table["\'"] = '\'';
-	return table[key];
+	return perfectHashFind(reservedWordsHash, word.data(), word.length());
 }
 
-string Scanner::prepareStrVal(const string& val)
+void Scanner::IdentifierDetected()
 {
-	string res;
-	bool esc = false;
-	for (int i = 1; i < val.length() - 1; i++)
+	int word = perfectHashFind(reservedWordsHash, tokenStart, tokenEnd - tokenStart);
+	if (word == -1)
 	{
-		char c = val[i];
-		if (val[i] == '\\')
-		{
-			string key;
-			key.push_back(val[i]);
-			key.push_back(val[i + 1]);
-			c = escapingChar(key);		
-			i++;
-		}
-		res.push_back(c);
+		NameIdT name = Interner::current().intern(tokenStart, tokenEnd - tokenStart);
+		addToken(IDENTIFIER)->nameId = name;
 	}
-	return res;
-}
-
-void Scanner::IdentifierDetected()
-{
-	char a[][10] = { "break", "char", "const", "continue", "do", "else", "float", "for", 
-		"if", "int", "return", "struct", "sizeof", "typedef", "void",  "while" };
-	vector<string> keywords;
-	for (int i = 0; i < 21; i++)
-		keywords.push_back(string(a[i]));
-	bool isKeyword = false;
-	int keyword = -1;
-	for (int i = 0; i < keywords.size(); i++)
-		if (keywords[i] == buffer)
-		{
-			isKeyword = true;
-			keyword = i;
-		}
-	if (isKeyword)
-		cur_tok = new KeywordToken(line, col, buffer, (KeywordsT) keyword);
-	else if (buffer == "scanf")
-		cur_tok = new OpToken(line, col, buffer, SCANF);
-	else if (buffer == "printf")
-		cur_tok = new OpToken(line, col, buffer, PRINTF);
+	else if (word <= WHILE)
+		addToken(KEYWORD)->keyword = (KeywordsT) word;
 	else 
-		cur_tok = new IdentifierToken(line, col, buffer);
-	buffer.clear();
+		addToken(OPERATION)->op = word == WHILE + 1 ? PRINTF : SCANF;
 }
 
 void Scanner::EOFDetected()
 {
-	cur_tok = new EOFToken(line, col);
-	buffer.clear();
+	tokenStart = 0;
+	addToken(END_OF_FILE);
 }
 
 void Scanner::SeparatorDetected()
@@ -485,98 +778,77 @@ void Scanner::SeparatorDetected()
 	char separators[] = { '{', '}', ';' };
 	int sep = -1;
 	for (int i = 0; i < SEPARATORS_COUNT; i++)
-		if (buffer[0] == separators[i])
+		if (*tokenStart == separators[i])
 			sep = i;
-	cur_tok = new SepToken(line, col, buffer, (SeparatorsT) sep);
-	buffer.clear();
+	addToken(SEPARATOR)->sep = (SeparatorsT) sep;
 }
 
 void Scanner::IntegerDetected()
 {
 	try {
-		int val = stoi(buffer);
-		cur_tok = new IntegerToken(line, col, buffer, val);
-		buffer.clear();
+		int val = stoi(tokenText());
+		addToken(INTEGER)->intVal = val;
 	} catch (out_of_range& e) {
-		throw ScannerException("Integer is out of range", line, col);
+		throw ScannerException("Integer is out of range", currentLine(), currentCol());
 	}
 }
 
 void Scanner::FloatDetected()
 {
 	try {
-		float val = stof(buffer);
-		cur_tok = new FloatToken(line, col, buffer, val);
-		buffer.clear();
+		float val = stof(tokenText());
+		addToken(REAL_NUMBER)->floatVal = val;
 	} catch (out_of_range& e) {
-		throw ScannerException("Float is out of range", line, col);
+		throw ScannerException("Float is out of range", currentLine(), currentCol());
 	}
 }
 
 void Scanner::OperationDetected()
 {
-	char operations[][5] = { "+", "-", "*", "/", "%", "++", "--", "+=", "-=", "*=", "/=", "%=", "?", ":",
-		"&", "|", "&&", "||", "!", "^", "&=", "|=", "^=", "=", "==", "!=", ">", "<", ">=", "<=", "<<", ">>", ".", "->",
-		"<<=", ">>=", "(", ")", "[", "]", ",", "~" };
-	int op = -1;
-	for (int i = 0; i < OPERATIONS_COUNT; i++)
-		if (buffer == operations[i])
-			op = i;
+	int op = perfectHashFind(operationsHash, tokenStart, tokenEnd - tokenStart);
 	if (op == -1)
-		throw ScannerException("Invalid operation", line, col);
-	cur_tok = new OpToken(line, col, buffer, (OperationsT) op);
-	buffer.clear();
+		throw ScannerException("Invalid operation", currentLine(), currentCol());
+	addToken(OPERATION)->op = (OperationsT) op;
 }
 
 void Scanner::CommentDetected()
 {
-	cur_tok = new CommentToken(line, col, buffer);
-	buffer.clear();
+	tokenStart = 0;
 }
 
 void Scanner::CharDetected()
 {
-	char val;
-	if (buffer.length() == 3)
-		val = buffer[1];
-	 else {
-		string key;
-		key.push_back(buffer[1]);
-		key.push_back(buffer[2]);
-		val = escapingChar(key);
-	}
-	cur_tok = new CharToken(line, col, buffer, val);
-	buffer.clear();
+	char val = tokenStart[1];
+	const char* c = tokenStart + 2;
+	if (val == '\\' && (!decodeEscape(c, tokenEnd - 1, val) || c != tokenEnd - 1))
+		throw ScannerException("Invalid escape sequence", currentLine(), currentCol());
+	addToken(CHARACTER)->charVal = val;
 }
 
 void Scanner::StringDetected()
 {
-	cur_tok = new StringToken(STRING, line, col, buffer, prepareStrVal(buffer));
-	buffer.clear();
+	LiteralIdT val = literals->add(tokenStart + 1, tokenEnd - 1);
+	if (val == noLiteral)
+		throw ScannerException("Invalid escape sequence", currentLine(), currentCol());
+	addToken(STRING)->strVal = val;
 }
 
 void Scanner::PreprocDirectiveDetected()
 {
-	char directives[][10] = {"#define", "#undef", "#include", "#if", "#ifdef", "#ifndef", "#else",
-		"#elif", "#endif", "#line", "#error", "#pragma", "#"};
-	bool correct = false;
-	for (int i = 0; i < 13; i++)
-		if (buffer == directives[i])
-			correct = true;
-	if (!correct)
+	int directive = perfectHashFind(directivesHash, tokenStart, tokenEnd - tokenStart);
+	if (directive == -1)
 		ParseError();
-	cur_tok = new StringValToken(PREPROCESSOR_DIRECTIVE, line, col, buffer);
-	buffer.clear();
+	addToken(PREPROCESSOR_DIRECTIVE)->directive = (DirectivesT) directive;
 }
 
 void Scanner::ParseError()
 {
+	string buffer = tokenText();
 	char* msg;
 	int size = buffer.length() + resourceSize;
 	msg = (char*) malloc(sizeof(char) * size);
-	sprintf(msg, "Invalid last character in line %d: %s", line, buffer.c_str());
+	sprintf(msg, "Invalid last character in line %d: %s", currentLine(), buffer.c_str());
 	string what(msg);
 	free(msg);
-	throw ScannerException(what.c_str(), line, col);	
-}
-
+	throw ScannerException(what.c_str(), currentLine(), currentCol());	
+}
\ No newline at end of file
@@ -5,8 +5,12 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <exception>
 #include "Tokens.h"
 #include "Exceptions.h"
+#include "CharSearch.h"
 
 using namespace std;
 
@@ -28,6 +32,7 @@ typedef enum {
 	OP,
 	SLASH,
 	ESC_IN_CHAR,
+	ESC_SEQ_IN_CHAR,
 	ESC_IN_STRING,
 	DOT_OP,
 	PLUS_OP,
@@ -105,6 +110,8 @@ typedef enum {
 } LexerEventsT;
 
 class Scanner;
+class Preprocessor;
+class SourceMap;
 
 typedef void (Scanner::*LexerActionT)();
 
@@ -113,25 +120,69 @@ typedef struct {
 	LexerActionT action;
 } LexerTransitionT;
 
-typedef vector<LexerTransitionT> TransitionsRowT;
-typedef vector<TransitionsRowT> TransitionTableT;
+typedef LexerTransitionT TransitionTableT[STATES_COUNT][EVENTS_COUNT];
+
+typedef struct {
+	const char* const* words;
+	const signed char* slots;
+	unsigned mask;
+	unsigned first;
+	unsigned second;
+	unsigned last;
+} PerfectHashT;
+
+// Scanner state before the lex() call that produced a token; offsets are into the input
+typedef struct {
+	unsigned cursor;
+	int tokenStart;
+	LexerStatesT state;
+	unsigned colOrigin;
+} ScanCheckpointT;
 
 class Scanner
 {
 private:	
-	int line;
-	int col;
 	string filename;
-	ifstream input;
+	shared_ptr<string> source;
+	shared_ptr<LiteralPool> literals; // shared by the copies, views and edits of the scanner that made it
+	const char* cursor;
+	const char* sourceEnd;
+	const char* lineStart;
+	unsigned colOrigin; // offset whose column the next token reports, see lex()
+	unsigned pastEnd;
+	const char* tokenStart;
+	const char* tokenEnd;
+	deque<Token> tokens;
+	vector<ScanCheckpointT> checkpoints; // one per token, only when editable
+	bool editable;
+	vector<shared_ptr<string>> includedSources;
+	int replayed; // index of the next preprocessed token, -1 when the scanner lexes its input
+	deque<Token>* replaying; // the tokens replayed: tokens, or those of the scanner this one views
 	Token* cur_tok;
+	Token* current;
 	LexerStatesT cur_state;
-	TransitionTableT transitions;
-	string buffer;
-	void addDefaultTransition(LexerStatesT state, LexerActionT action = 0);
-	void addAnyEventTransition(LexerStatesT fromState, LexerStatesT toState, LexerActionT action = 0);
-	void addTransition(LexerStatesT fromState, LexerEventsT event, LexerStatesT toState, LexerActionT act);
-	void lockItself(LexerStatesT state);
-	void pushData();
+	exception_ptr lexError;
+	static TransitionTableT transitions;
+	static bool transitionsReady;
+	static FindStopCharT findStopChar;
+	static void addDefaultTransition(LexerStatesT state, LexerActionT action = 0);
+	static void addAnyEventTransition(LexerStatesT fromState, LexerStatesT toState, LexerActionT action = 0);
+	static void addTransition(LexerStatesT fromState, LexerEventsT event, LexerStatesT toState, LexerActionT act);
+	static bool initTransitions();
+	static void lockItself(LexerStatesT state);
+	void loadFile(const char* filename);
+	Token* lex();
+	ScanCheckpointT checkpoint() const;
+	void restore(const ScanCheckpointT& point);
+	int findCheckpoint(unsigned cursor) const;
+	void appendRebased(const Scanner& old, int from, int to, long long shift);
+	void findLineStart();
+	char readChar();
+	void skipPlainChars();
+	int currentLine() const;
+	int currentCol() const;
+	string tokenText() const;
+	Token* addToken(TokenTypesT type);
 	void PreprocDirectiveDetected();
 	void IdentifierDetected();
 	void SeparatorDetected();
@@ -143,16 +194,28 @@ private:
 	void CharDetected();
 	void ParseError();	
 	void EOFDetected();
-	char escapingChar(const string& key);
-	string prepareStrVal(const string& val);
 public:	
 	friend class Parser;
 	Scanner(const char* filename);
-	Scanner(const Scanner& clone): cur_tok(0), transitions(clone.transitions), input(clone.filename),
-		filename(clone.filename), cur_state(START), line(clone.line), col(clone.col) {}
+	Scanner(istream& in);
+	Scanner(const char* filename, Preprocessor& preprocessor);
+	Scanner(const Scanner& clone);
+	Scanner(const Scanner& old, size_t editStart, size_t editEnd, const string& text);
+	Scanner(const Scanner& whole, int position);
+	void dropTokens();
+	void trackEdits() { editable = tokens.empty(); } // before the first token, for Scanner(old, ...) on this one
+	long long sourceSize() const { return sourceEnd - source->data(); }
+	shared_ptr<string> sourceText() const { return source; }
+	LiteralPool& literalPool() const { return *literals; } // values of the string tokens, to activate where they are read
+	int tokensCount() const { return tokens.size(); }
+	Token* token(int index) { return &tokens[index]; }
 	Token* get();
 	Token* next();
+	bool replays() const { return replayed != -1; }
+	int position() const { return replayed - 1; }
+	void seek(int position);
 	bool hasNext() const;
+	static int reservedWordIndex(const string& word);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cstring>
+#include "SourceMap.h"
+
+SourceMap& SourceMap::shared()
+{
+	static SourceMap sourceMap;
+	return sourceMap;
+}
+
+SourceMap& SourceMap::current()
+{
+	return active() ? *active() : shared();
+}
+
+// Texts that were freed are dropped here; their memory may now hold the new text
+void SourceMap::add(const shared_ptr<string>& text)
+{
+	lock_guard<mutex> guard(lock);
+	for (map<const char*, SourceTextT>::iterator it = texts.begin(); it != texts.end();)
+		if (it->second.text.expired())
+			texts.erase(it++);
+		else
+			it++;
+	SourceTextT& source = texts[text->data()];
+	source.text = text;
+	source.lineStarts.clear();
+}
+
+// Called with lock held. The end of a text belongs to it as well, as end of file tokens point there
+map<const char*, SourceTextT>::iterator SourceMap::entry(const char* position)
+{
+	map<const char*, SourceTextT>::iterator it = texts.upper_bound(position);
+	if (it == texts.begin())
+		return texts.end();
+	it--;
+	shared_ptr<string> text = it->second.text.lock();
+	if (!text || position > it->first + text->length())
+		return texts.end();
+	return it;
+}
+
+shared_ptr<string> SourceMap::textOf(const char* position)
+{
+	lock_guard<mutex> guard(lock);
+	map<const char*, SourceTextT>::iterator it = entry(position);
+	return it == texts.end() ? shared_ptr<string>() : it->second.text.lock();
+}
+
+int SourceMap::lineIndex(const vector<unsigned>& lineStarts, unsigned offset)
+{
+	return upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin() - 1;
+}
+
+// Line of position and column of the origin offset in the same text; false for unknown texts
+bool SourceMap::locate(const char* position, unsigned origin, int& line, int& col)
+{
+	lock_guard<mutex> guard(lock);
+	line = col = 0;
+	map<const char*, SourceTextT>::iterator it = entry(position);
+	if (it == texts.end())
+		return false;
+	vector<unsigned>& lineStarts = it->second.lineStarts;
+	if (lineStarts.empty())
+	{
+		shared_ptr<string> text = it->second.text.lock();
+		lineStarts.push_back(0);
+		for (const char* c = text->data(); (c = (const char*) memchr(c, '\n', text->data() + text->length() - c)) != 0; c++)
+			lineStarts.push_back(c + 1 - text->data());
+	}
+	line = lineIndex(lineStarts, position - it->first) + 1;
+	col = origin - lineStarts[lineIndex(lineStarts, origin)] + 1;
+	return true;
+}
@@ -0,0 +1,40 @@
+#ifndef SOURCE_MAP_H
+#define SOURCE_MAP_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "ActiveStack.h"
+
+using namespace std;
+
+// Offsets where the lines of one text start; built on the first position asked for
+typedef struct {
+	weak_ptr<string> text;
+	vector<unsigned> lineStarts;
+} SourceTextT;
+
+// Every text the scanner reads is registered here, so a token only keeps offsets
+// and its line and column are worked out when a diagnostic needs them. A BatchCompiler run
+// keeps one of its own; anything else registers in the shared one
+class SourceMap : public ActiveStack<SourceMap>
+{
+private:
+	map<const char*, SourceTextT> texts;
+	mutex lock;
+	map<const char*, SourceTextT>::iterator entry(const char* position);
+	static int lineIndex(const vector<unsigned>& lineStarts, unsigned offset);
+	SourceMap(const SourceMap&);
+	SourceMap& operator = (const SourceMap&);
+public:
+	SourceMap() {}
+	void add(const shared_ptr<string>& text);
+	shared_ptr<string> textOf(const char* position);
+	bool locate(const char* position, unsigned origin, int& line, int& col);
+	static SourceMap& shared();
+	static SourceMap& current();
+};
+
+#endif
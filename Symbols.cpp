@@ -1,5 +1,7 @@
 #include <iostream>
+#include <algorithm>
 #include "Symbols.h"
+#include "TypeTable.h"
 
 static const int M = 2;
 
@@ -11,7 +13,7 @@ void Symbol::print(int deep) const
 void VarSym::print(int deep) const
 {
 	cout << string(M * deep, ' ') << name;
-	if (dynamic_cast<FuncSym*>(type) && dynamic_cast<FuncSym*>(type)->blockDefined())
+	if (isa<FuncSym>(type) && cast<FuncSym>(type)->blockDefined())
 		type->print(deep + 1);
 	else if (type->typeName().length() > 0)
 		cout << ' ' << type->typeName() << endl;
@@ -38,20 +40,9 @@ bool TypeSym::operator==(const string& o) const
 
 bool ScalarSym::canConvertTo(TypeSym* to) 
 {
-	if (dynamic_cast<PointerSym*>(to) || dynamic_cast<FuncSym*>(to))
+	if (isa<PointerSym>(to) || isa<FuncSym>(to))
 		return false;
-	return typePriority[this] <= typePriority[to]; // how to do it with const-modifier?
-}
-
-int ScalarSym::byteSize() const
-{
-	if (name == "void")
-		return 0;
-	if (name == "char")
-		return 1;
-	if (name == "int" || name == "float")
-		return 4;
-	throw CompilerException("unknown base type", 0, 0);
+	return priorityOf(this) <= priorityOf(to);
 }
 
 string ConstTypeSym::typeName() const
@@ -69,61 +60,33 @@ void ArraySym::generate(AsmCode& code) const
 
 }
 
-bool ArraySym::operator==(TypeSym* o) const
-{
-	ArraySym* arr = dynamic_cast<ArraySym*>(o);
-	if (!arr)
-		return false;
-	return size == arr->size && *type == arr->type;
-}
-
 bool ArraySym::canConvertTo(TypeSym* to)
 {
 	if (to == intType)
 		return true;
-	PointerSym* p = dynamic_cast<PointerSym*>(to);
-	if (p && *p->type == type)
+	PointerSym* p = dyn_cast<PointerSym>(to);
+	if (p && p->type == type)
 		return true;
 	return false;
 }
 
-string PointerSym::typeName() const
+PointerSym* ArraySym::convertToPointer() const
 {
-	return "pointer to " + type->typeName();
+	return TypeTable::current().pointerTo(type);
 }
 
-bool PointerSym::operator==(TypeSym* o) const
+string PointerSym::typeName() const
 {
-	PointerSym* p = dynamic_cast<PointerSym*>(o);
-	if (!p)
-		return false;
-	TypeSym* type1 = nextType();
-	TypeSym* type2 = p->nextType();
-	while (true)
-	{
-		if (*type1 != type2)
-			return false;
-		TypeSym* tmp1 = type1->nextType();
-		TypeSym* tmp2 = type2->nextType();
-		if (tmp1 == 0 || tmp2 == 0)
-		{
-			if (tmp1 != 0 || tmp2 != 0)
-				return false;
-			return true;
-		} else {
-			type1 = tmp1;
-			type2 = tmp2;
-		}
-	}
+	return "pointer to " + type->typeName();
 }
 
 bool PointerSym::canConvertTo(TypeSym* to)
 {
 	if (to == intType)
 		return true;
-	PointerSym* pointer = dynamic_cast<PointerSym*>(to);
+	PointerSym* pointer = dyn_cast<PointerSym>(to);
 	if (pointer)
-		return *this == pointer;
+		return this == pointer;
 	return false;
 }
 
@@ -146,20 +109,15 @@ void StructSym::print(int deep) const
 
 bool StructSym::canConvertTo(TypeSym* to) 
 {
-	StructSym* struc = dynamic_cast<StructSym*>(to);
+	StructSym* struc = dyn_cast<StructSym>(to);
 	if (!struc || *fields != struc->fields)
 		return false;
+	for (int i = 0; i < fields->size(); i++) // packed, the same fields may be laid out differently
+		if ((*fields)[i]->offset != (*struc->fields)[i]->offset)
+			return false;
 	return true;
 }
 
-int StructSym::getShiftForBase() const
-{
-	TypeSym* type = (*fields)[0]->getType();
-	while (!dynamic_cast<ScalarSym*>(type))
-		type = type->nextType();
-	return type->byteSize();
-}
-
 string StructSym::typeName() const
 {
 	return "struct " + name;
@@ -172,7 +130,7 @@ bool FuncSym::canConvertTo(TypeSym* o)
 
 bool FuncSym::operator==(TypeSym* o) const
 {
-	FuncSym* func = dynamic_cast<FuncSym*>(o);
+	FuncSym* func = dyn_cast<FuncSym>(o);
 	if (!func)
 		return false;
 	return *params == func->params && *val == func->val;
@@ -200,7 +158,7 @@ string FuncSym::typeName() const
 	string str = "function(";
 	for (int i = 0; i < params->size(); i++)
 	{
-		str += dynamic_cast<VarSym*>(params->symbols[i])->type->typeName();
+		str += cast<VarSym>(params->symbols[i])->type->typeName();
 		if (i < params->size() - 1)
 			str += ", "; 
 	}
@@ -208,8 +166,12 @@ string FuncSym::typeName() const
 	return str;
 }
 
+// ebx, esi and edi are not saved: functions are called only from one another and from start,
+// none keeps a value in them across a call, each loads them right before a copy.
+// The CRT functions called save them, start returns to end the process
 void FuncSym::generate(AsmCode& code, const string& name) const
 {
+	code.startLabels("_" + name + "_");
 	code.add(makeLabel("f_" + name))
 		.add(cmdPUSH, EBP)
 		.add(cmdMOV, EBP, ESP);
@@ -220,55 +182,100 @@ void FuncSym::generate(AsmCode& code, const string& name) const
 		.add(cmdRET, makeArg(0));
 }
 
-Symbol* SymTable::find(const string& name) const
+// Looks among the first count symbols only, so it finds what find did when the table was that long
+Symbol* SymTable::find(NameIdT name, int count) const
+{
+	int at = position(name, count);
+	if (at == -1)
+		at = position(Interner::current().decorated(name), count);
+	return at != -1 ? symbols[at] : 0;
+}
+
+// Index of the last symbol named name among the first count, -1 if there is none
+int SymTable::position(NameIdT name, int count) const
 {
-	if (index.count(name))
-		return symbols[index.at(name)];
-	else if (index.count('$' + name))
-		return symbols[index.at('$' + name)];
-	return 0;
+	map<NameIdT, int>::const_iterator it = index.find(name);
+	if (it == index.end())
+		return -1;
+	if (it->second < count)
+		return it->second;
+	for (int i = min(count, (int) symbols.size()) - 1; i >= 0; i--) // redefined past count
+		if (symbols[i]->id == name)
+			return i;
+	return -1;
 }
 
 void SymTable::add(Symbol* symbol)
 {
 	symbols.push_back(symbol);
-	names.push_back(symbol->name);
-	index[symbol->name] = symbols.size() - 1;
+	index[symbol->id] = symbols.size() - 1;
+	place(symbol);
 }
 
-void SymTableForLocals::add(Symbol* symbol)
+// Forgets the symbols added after the first count and lays the others out again
+void SymTable::truncate(int count)
 {
-	SymTable::add(symbol);
-	VarSym* vp = dynamic_cast<VarSym*>(symbol);
-	if (vp)
-	{
-		TypeSym* type = vp->getType();
-		if (dynamic_cast<ArraySym*>(type))
-			symbol->offset = -(shift + offset + type->byteSize() - type->nextType()->byteSize());
-		else if (dynamic_cast<StructSym*>(type))
-			symbol->offset = -(shift + offset + type->byteSize() - dynamic_cast<StructSym*>(type)->getShiftForBase());
-		else
-			symbol->offset = -(shift + offset);
-		offset += symbol->byteSize();
-		vp->global = false;
-	}
+	if (count >= symbols.size())
+		return;
+	vector<Symbol*> kept(symbols.begin(), symbols.begin() + count);
+	symbols.clear();
+	index.clear();
+	bytes = 0;
+	align = 1;
+	offset = 0;
+	for (int i = 0; i < count; i++)
+		add(kept[i]);
 }
 
-void SymTableForParams::add(Symbol* symbol)
+// Each variable takes whole dwords below the one before, since locals are pushed and popped as dwords
+void SymTableForLocals::place(Symbol* symbol)
 {
-	SymTable::add(symbol);
-	if (dynamic_cast<StructSym*>(symbol->getType()))
-		symbol->offset = offset + dynamic_cast<StructSym*>(symbol->getType())->getShiftForBase();
-	else 
-		symbol->offset = offset + symbol->byteSize();	
-	offset += symbol->byteSize();
+	VarSym* vp = dyn_cast<VarSym>(symbol);
+	if (!vp)
+		return;
+	offset += symbol->stackSize();
+	symbol->offset = -(shift + offset);
+	align = 4;
+	bytes = offset;
+	vp->global = false;
+}
+
+// The arguments were pushed in whole dwords, the first one last
+void SymTableForParams::place(Symbol* symbol)
+{
+	symbol->offset = frameLinkSize + offset;
+	offset += symbol->stackSize();
+	align = 4;
+	bytes = offset;
 }
 
-void SymTableForFields::add(Symbol* symbol)
+void SymTableForFields::place(Symbol* symbol)
 {
-	SymTable::add(symbol);
+	if (!isa<VarSym>(symbol)) // a struct declared among the fields takes no room
+		return;
+	offset = alignUp(offset, symbol->alignment());
 	symbol->offset = offset;
 	offset += symbol->byteSize();
+	align = max(align, symbol->alignment());
+	bytes = alignUp(offset, align);
+}
+
+static bool moreAligned(Symbol* a, Symbol* b)
+{
+	return a->alignment() > b->alignment();
+}
+
+// Lays the fields out again from the most aligned down, which leaves the least padding. They keep
+// their order in the table, so only code that reads the layout sees it
+void SymTableForFields::pack()
+{
+	vector<Symbol*> order(symbols);
+	stable_sort(order.begin(), order.end(), moreAligned);
+	bytes = 0;
+	align = 1;
+	offset = 0;
+	for (int i = 0; i < order.size(); i++)
+		place(order[i]);
 }
 
 void SymTable::print(int deep) const
@@ -280,17 +287,27 @@ void SymTable::print(int deep) const
 	}
 }
 
-int SymTable::size() const
+// Size and alignment of every struct declared here and the offset of each of its fields;
+// the tables one level down are fields
+void SymTable::printLayout(int deep) const
 {
-	return symbols.size();
+	for (int i = 0; i < symbols.size(); i++)
+	{
+		StructSym* struc = dyn_cast<StructSym>(symbols[i]);
+		VarSym* var = dyn_cast<VarSym>(symbols[i]);
+		if (struc && struc->fields)
+		{
+			cout << string(M * deep, ' ') << "struct " << struc->name << " size " << struc->byteSize() 
+				<< " align " << struc->alignment() << endl;
+			struc->fields->printLayout(deep + 1);
+		} else if (var && deep > 0)
+			cout << string(M * deep, ' ') << var->offset << ' ' << var->name << ' ' << var->type->typeName() << endl;
+	}
 }
 
-int SymTable::byteSize() const
+int SymTable::size() const
 {
-	int bytes = 0;
-	for (int i = 0; i < size(); i++)
-		bytes += symbols[i]->byteSize();
-	return bytes;
+	return symbols.size();
 }
 
 bool SymTable::exists(const string& name) 
@@ -303,7 +320,7 @@ bool SymTable::operator==(SymTable* o) const
 	if (size() != o->size())
 		return false;
 	for (int i = 0; i < size(); i++)
-		if (*dynamic_cast<VarSym*>(symbols[i])->type != dynamic_cast<VarSym*>(o->symbols[i])->type)
+		if (*cast<VarSym>(symbols[i])->type != cast<VarSym>(o->symbols[i])->type)
 			return false;
 	return true;
 }
@@ -312,48 +329,169 @@ void SymTable::generateGlobals(AsmCode& code) const
 {
 	for (int i = 0; i < size(); i++)
 	{
-		VarSym* sym = dynamic_cast<VarSym*>(symbols[i]);
-		if (sym && !dynamic_cast<FuncSym*>(sym->type))
+		VarSym* sym = dyn_cast<VarSym>(symbols[i]);
+		if (sym && !isa<FuncSym>(sym->type))
 			sym->generate(code);
 	}
 }
 
-void SymTable::generateCode(AsmCode& code) const
+// The functions with a body; one only declared has no code of its own
+vector<VarSym*> SymTable::functions() const
 {
+	vector<VarSym*> result;
 	for (int i = 0; i < size(); i++)
 	{
-		VarSym* sym = dynamic_cast<VarSym*>(symbols[i]);
-		if (sym && dynamic_cast<FuncSym*>(sym->type))
-			dynamic_cast<FuncSym*>(sym->type)->generate(code, sym->name);
+		VarSym* sym = dyn_cast<VarSym>(symbols[i]);
+		if (sym && isa<FuncSym>(sym->type) && cast<FuncSym>(sym->type)->blockDefined())
+			result.push_back(sym);
 	}
+	return result;
 }
 
 void SymTableStack::push(SymTable* table)
 {
 	tables.push_back(table);
+	marks.push_back(bindings.size());
+	for (int i = 0; i < table->size(); i++)
+		bind((*table)[i]);
 }
 
 void SymTableStack::pop()
 {
+	unbind(marks.back());
+	marks.pop_back();
 	tables.pop_back();
 }
 
+// Undoes the bindings made after the first count
+void SymTableStack::unbind(int count)
+{
+	while (bindings.size() > count)
+	{
+		slots[bindings.back().slot].binding = bindings.back().shadowed;
+		bindings.pop_back();
+	}
+}
+
+// A stack over the same tables that goes on finding what this one finds now, whatever is added
+// to this one later. This one must not change while the frozen one is used
+SymTableStack SymTableStack::frozen() const
+{
+	SymTableStack view;
+	view.tables = tables;
+	view.base = this;
+	view.baseBindings = bindings.size();
+	for (int i = 0; i < tables.size(); i++)
+	{
+		view.marks.push_back(0);
+		view.frozenSizes.push_back(tables[i]->size());
+	}
+	return view;
+}
+
+// Back to where frozen was taken: the tables pushed since go, the others lose the symbols added since
+void SymTableStack::rollback(const SymTableStack& frozen)
+{
+	while (tables.size() > frozen.tables.size())
+		pop();
+	unbind(frozen.baseBindings);
+	for (int i = 0; i < tables.size(); i++)
+		tables[i]->truncate(frozen.frozenSizes[i]);
+}
+
 SymTable* SymTableStack::top()
 {
 	return tables.size() > 0 ? tables.back() : 0;
 }
 
-Symbol* SymTableStack::find(const string& name) const
+// Slot of name, or the free one where it would go
+int SymTableStack::slotOf(NameIdT name) const
+{
+	int mask = slots.size() - 1;
+	int slot = (name * 2654435769u) & mask;
+	while (slots[slot].name != name && slots[slot].name != noName)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+int SymTableStack::insertSlot(NameIdT name)
 {
-	Symbol* sym = 0;
-	for (int i = tables.size() - 1; i >= 0 && !sym; i--)
-		sym = tables[i]->find(name);
-	return sym;
+	int slot = slotOf(name);
+	if (slots[slot].name == name)
+		return slot;
+	if ((slotsUsed + 1) * 2 > slots.size())
+	{
+		grow();
+		slot = slotOf(name);
+	}
+	slots[slot].name = name;
+	slotsUsed++;
+	return slot;
+}
+
+// Bindings and decorated links keep slot numbers, so they move along
+void SymTableStack::grow()
+{
+	vector<ScopeSlotT> old(slots.size() * 2, freeScopeSlot);
+	old.swap(slots);
+	vector<int> moved(old.size(), -1);
+	for (int i = 0; i < old.size(); i++)
+		if (old[i].name != noName)
+		{
+			moved[i] = slotOf(old[i].name);
+			slots[moved[i]] = old[i];
+		}
+	for (int i = 0; i < slots.size(); i++)
+		if (slots[i].name != noName && slots[i].decorated != -1)
+			slots[i].decorated = moved[slots[i].decorated];
+	for (int i = 0; i < bindings.size(); i++)
+		bindings[i].slot = moved[bindings[i].slot];
+}
+
+// A '$' name is found by its plain one too, so that slot links to it
+void SymTableStack::bind(Symbol* symbol)
+{
+	int slot = insertSlot(symbol->id);
+	ScopeBindingT binding = { symbol, (int) tables.size() - 1, slots[slot].binding, slot };
+	slots[slot].binding = bindings.size();
+	bindings.push_back(binding);
+	if (symbol->name.length() > 1 && symbol->name[0] == '$')
+	{
+		int plain = insertSlot(Interner::current().intern(symbol->name.substr(1)));
+		slots[plain].decorated = slotOf(symbol->id);
+	}
+}
+
+// The innermost table with name or '$' + name, as a walk over the tables trying both in each
+Symbol* SymTableStack::find(NameIdT name) const
+{
+	const ScopeBindingT* binding = lookup(name, bindings.size());
+	if (!binding && base)
+		binding = base->lookup(name, baseBindings);
+	return binding ? binding->symbol : 0;
+}
+
+// Among the first count bindings only
+const ScopeBindingT* SymTableStack::lookup(NameIdT name, int count) const
+{
+	int slot = slotOf(name);
+	if (slots[slot].name == noName)
+		return 0;
+	int plain = slots[slot].binding;
+	int decorated = slots[slot].decorated != -1 ? slots[slots[slot].decorated].binding : -1;
+	while (plain >= count)
+		plain = bindings[plain].shadowed;
+	while (decorated >= count)
+		decorated = bindings[decorated].shadowed;
+	if (decorated != -1 && (plain == -1 || bindings[decorated].depth > bindings[plain].depth))
+		return &bindings[decorated];
+	return plain != -1 ? &bindings[plain] : 0;
 }
 
 void SymTableStack::add(Symbol* symbol)
 {
 	top()->add(symbol);
+	bind(symbol);
 }
 
 void SymTableStack::print(int deep) const
@@ -421,7 +559,7 @@ void WhilePreCondStatement::print(int deep) const
 
 void WhilePreCondStatement::generate(AsmCode& code) const
 {
-	string key = to_string(rand());
+	string key = code.labelKey();
 	startLabel = makeLabel("prewhile" + key + "_start");
 	endLabel = makeLabel("prewhile" + key + "_end");
 	AsmArgLabel* cond = makeLabel("prewhile" + key + "_cond");
@@ -444,7 +582,7 @@ void WhilePostCondStatement::print(int deep) const
 
 void WhilePostCondStatement::generate(AsmCode& code) const
 {
-	string key = to_string(rand());
+	string key = code.labelKey();
 	startLabel = makeLabel("postwhile" + key + "_start");
 	endLabel = makeLabel("postwhile" + key + "_end");
 	code.add(startLabel);
@@ -472,7 +610,7 @@ void ForStatement::print(int deep) const
 
 void ForStatement::generate(AsmCode& code) const
 {
-	string key = to_string(rand());
+	string key = code.labelKey();
 	startLabel = makeLabel("for" + key + "_start");
 	endLabel = makeLabel("for" + key + "_end");
 	incrementLabel = makeLabel("for" + key + "_inc");
@@ -507,7 +645,7 @@ void IfStatement::print(int deep) const
 
 void IfStatement::generate(AsmCode& code) const
 {
-	string key = to_string(rand());
+	string key = code.labelKey();
 	AsmArgLabel* trueLabel = makeLabel("if" + key + "_true");
 	AsmArgLabel* falseLabel = makeLabel("if" + key + "_false");
 	AsmArgLabel* endLabel = makeLabel("if" + key + "_end");
@@ -532,11 +670,7 @@ void ContinueStatement::print(int deep) const
 
 void ContinueStatement::generate(AsmCode& code) const
 {
-	ForStatement* forCycle = dynamic_cast<ForStatement*>(owner);
-	if (forCycle)
-		code.add(cmdJMP, forCycle->incrementLabel);
-	else
-		code.add(cmdJMP, owner->startLabel);
+	code.add(cmdJMP, owner->continueLabel());
 }
 
 void BreakStatement::print(int deep) const
@@ -560,12 +694,28 @@ void ReturnStatement::generate(AsmCode& code) const
 {
 	if (arg)
 	{
-		arg->generate(code);
-		int size = owner->val->byteSize();
-		int steps = size / 4 + (size % 4 != 0);
-		for (int i = 0; i < steps; i++)
-			code.add(cmdPOP, EAX)
-				.add(cmdMOV, makeIndirectArg(EBP, 4 + owner->params->byteSize() + size - 4 * (steps - i - 1)), makeArg(EAX));
+		TypeSym* type = owner->val;
+		int slot = frameLinkSize + owner->params->byteSize(); // the caller reserved it above the arguments
+		if (!isBlockCopied(type))
+		{
+			arg->generate(code);
+			for (int i = 0; i < type->stackSize() / 4; i++)
+				code.add(cmdPOP, EAX)
+					.add(cmdMOV, makeIndirectArg(EBP, slot + 4 * i), makeArg(EAX));
+		} else if (arg->hasAddress()) {
+			arg->generateLvalue(code);
+			code.add(cmdPOP, ESI)
+				.add(cmdMOV, EDI, EBP)
+				.add(cmdADD, EDI, slot);
+			generateBlockCopy(code, type->byteSize());
+		} else {
+			arg->generate(code);
+			code.add(cmdMOV, ESI, ESP)
+				.add(cmdMOV, EDI, EBP)
+				.add(cmdADD, EDI, slot);
+			generateBlockCopy(code, type->byteSize());
+			code.add(cmdADD, ESP, type->stackSize());
+		}
 	}
 	code.add(cmdJMP, owner->endLabel);
 }
@@ -8,18 +8,53 @@
 
 using namespace std;
 
+typedef struct {
+	NameIdT name; // noName if the slot is free
+	int binding; // innermost binding of name, -1 if it has none now
+	int decorated; // slot of '$' + name, -1 if that was never bound
+} ScopeSlotT;
+
+static const ScopeSlotT freeScopeSlot = { noName, -1, -1 };
+
+typedef struct {
+	Symbol* symbol;
+	int depth; // of the table the symbol is in
+	int shadowed; // binding of the same name it hides, -1 if none
+	int slot;
+} ScopeBindingT;
+
+// Every name in scope sits in one open-addressing table keyed by interned name, whose slot heads
+// the chain of bindings it shadows. The bindings are also the undo log: pop unbinds the ones its
+// table made, so find costs the same at any depth
 class SymTableStack : public SymInterface
 {
 private:
 	vector<SymTable*> tables;	
+	vector<ScopeSlotT> slots;
+	int slotsUsed;
+	vector<ScopeBindingT> bindings;
+	vector<int> marks; // bindings made before each table was pushed
+	const SymTableStack* base; // of a frozen stack, which sees its first baseBindings under its own
+	int baseBindings;
+	vector<int> frozenSizes;
+	int slotOf(NameIdT name) const;
+	int insertSlot(NameIdT name);
+	void grow();
+	void bind(Symbol* symbol);
+	void unbind(int count);
+	const ScopeBindingT* lookup(NameIdT name, int count) const;
 public:
-	Symbol* find(const string& name) const;
+	SymTableStack(): slots(64, freeScopeSlot), slotsUsed(0), base(0), baseBindings(0) {}
+	Symbol* find(NameIdT name) const;
+	Symbol* find(const string& name) const { return find(Interner::current().intern(name)); }
 	SymTable* top();
 	bool existsInLastNamespace(const string& name);	
 	void add(Symbol* s);
 	void print(int deep = 0) const;
 	void push(SymTable* table);
 	void pop();
+	SymTableStack frozen() const;
+	void rollback(const SymTableStack& frozen);
 };
 
 class SingleStatement : public Statement
@@ -30,6 +65,7 @@ public:
 	SingleStatement(Node* e): expr(e) {}
 	void print(int deep) const { expr->print(deep); }
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 class CondStatement : public Statement
@@ -50,6 +86,7 @@ public:
 	IfStatement(Node* cond, Statement* tB, Statement* fB): CondStatement(cond), trueBranch(tB), falseBranch(fB) {}
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 class CycleStatement : public CondStatement
@@ -61,6 +98,7 @@ public:
 	mutable AsmArgLabel* endLabel;
 	CycleStatement(Node* cond, Statement* b): CondStatement(cond), body(b), startLabel(0), endLabel(0) {}
 	virtual void print(int deep) const;
+	virtual AsmArgLabel* continueLabel() const { return startLabel; }
 };
 
 class WhilePreCondStatement : public CycleStatement
@@ -70,6 +108,7 @@ public:
 	WhilePreCondStatement(Node* cond, Statement* b): CycleStatement(cond, b) {}
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 class WhilePostCondStatement : public CycleStatement
@@ -79,6 +118,7 @@ public:
 	WhilePostCondStatement(Node* cond, Statement* b): CycleStatement(cond, b) {}
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 class ForStatement : public CycleStatement
@@ -92,7 +132,9 @@ public:
 	ForStatement(Node* initial, Node* condition, Node* inc, Statement* block): 
 		CycleStatement(condition, block), initialization(initial), increment(inc), incrementLabel(0) {}
 	void print(int deep) const;
+	AsmArgLabel* continueLabel() const { return incrementLabel; }
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 class JumpStatement : public Statement
@@ -112,6 +154,7 @@ public:
 	BreakStatement(CycleStatement* cycle): CycleJumpStatement(cycle) {}
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 class ContinueStatement : public CycleJumpStatement
@@ -120,6 +163,7 @@ public:
 	ContinueStatement(CycleStatement* cycle): CycleJumpStatement(cycle) {}
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 class ReturnStatement : public JumpStatement
@@ -131,6 +175,7 @@ public:
 	ReturnStatement(Node* a, FuncSym* o): arg(a), owner(o) {}
 	void print(int deep) const;
 	void generate(AsmCode& code) const;
+	void lower(IRBuilder& builder) const;
 };
 
 
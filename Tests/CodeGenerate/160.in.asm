@@ -0,0 +1,167 @@
+.686
+.model flat, stdcall
+include c:\masm32\include\msvcrt.inc
+includelib c:\masm32\lib\msvcrt.lib
+.data
+	str0 db "%c %d %c %c %d", 0dh, 0ah, 0
+	str1 db "%c %d %c %c %d", 0dh, 0ah, 0
+	var_$g dd 4 dup(0)
+	tmp4 real4 0.000000
+	tmp8 real8 0.000000
+.code
+f_main:
+	push ebp
+	mov ebp, esp
+	sub esp, 16
+	mov eax, offset var_$g
+	mov ebx, 4
+	add eax, ebx
+	mov ebx, 1000
+	mov dword ptr [eax + 0], ebx
+	mov eax, offset var_$g
+	mov ebx, 120
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$g
+	mov ebx, 12
+	add eax, ebx
+	mov ebx, -1
+	mov dword ptr [eax + 0], ebx
+	mov eax, offset var_$g
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 97
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$g
+	mov ebx, 9
+	add eax, ebx
+	mov ebx, 98
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$g
+	mov ebx, 9
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	mov ebx, eax
+	mov eax, offset var_$g
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$g
+	mov ebx, 12
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, offset var_$g
+	mov ebx, 9
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$g
+	mov ebx, 8
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$g
+	mov ebx, 4
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, offset var_$g
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	invoke crt_printf, addr str0
+	add esp, 20
+	push dword ptr 7
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 12
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	push dword ptr 113
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 9
+	add eax, ebx
+	pop ebx
+	mov byte ptr [eax + 0], bl
+	push dword ptr 112
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 8
+	add eax, ebx
+	pop ebx
+	mov byte ptr [eax + 0], bl
+	push dword ptr 300
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 4
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	push dword ptr 122
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	pop ebx
+	mov byte ptr [eax + 0], bl
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 4
+	add eax, ebx
+	pop ebx
+	mov eax, dword ptr [eax + 0]
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 4
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 12
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 9
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 8
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, 4
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	invoke crt_printf, addr str1
+	add esp, 20
+	mov esp, ebp
+	pop ebp
+	ret 0
+start:
+	call f_main
+	ret 0
+end start
\ No newline at end of file
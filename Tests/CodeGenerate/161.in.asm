@@ -0,0 +1,378 @@
+.686
+.model flat, stdcall
+include c:\masm32\include\msvcrt.inc
+includelib c:\masm32\lib\msvcrt.lib
+.data
+	str0 db "%c", 0dh, 0ah, 0
+	str1 db "%s", 0dh, 0ah, 0
+	str2 db "%s", 0dh, 0ah, 0
+	str3 db "%s %c", 0dh, 0ah, 0
+	str4 db "%c%c%c %c %d", 0dh, 0ah, 0
+	str5 db "%d %d %d %d %d", 0dh, 0ah, 0
+	str6 db "%c", 0
+	str7 db "", 0dh, 0ah, 0
+	var_$x dd 2 dup(0)
+	var_$y dd 2 dup(0)
+	var_s dd 2 dup(0)
+	tmp4 real4 0.000000
+	tmp8 real8 0.000000
+.code
+f_main:
+	push ebp
+	mov ebp, esp
+	sub esp, 16
+	push dword ptr 1
+	mov eax, ebp
+	mov ebx, -8
+	add eax, ebx
+	pop ebx
+	mov byte ptr [eax + 0], bl
+	push dword ptr 65
+	mov eax, ebp
+	mov ebx, -4
+	add eax, ebx
+	pop ebx
+	mov byte ptr [eax + 0], bl
+	mov eax, ebx
+	movsx eax, byte ptr [ebp + -8]
+	push eax
+	mov eax, ebp
+	mov ebx, -4
+	add eax, ebx
+	pop ebx
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	add eax, ebx
+	pop ebx
+	mov byte ptr [ebx + 0], al
+	movsx eax, byte ptr [ebp + -8]
+	push eax
+	mov eax, ebp
+	mov ebx, -4
+	add eax, ebx
+	pop ebx
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	sub eax, ebx
+	pop ebx
+	mov byte ptr [ebx + 0], al
+	movsx eax, byte ptr [ebp + -4]
+	push eax
+	invoke crt_printf, addr str0
+	add esp, 4
+	mov eax, offset var_s
+	mov ebx, 104
+	mov byte ptr [eax + 0], bl
+	mov eax, 1
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, 101
+	mov byte ptr [eax + 0], bl
+	mov eax, 2
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, 108
+	mov byte ptr [eax + 0], bl
+	mov eax, 3
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, 108
+	mov byte ptr [eax + 0], bl
+	mov eax, 4
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, 111
+	mov byte ptr [eax + 0], bl
+	mov eax, 5
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, 0
+	mov byte ptr [eax + 0], bl
+	mov eax, ebx
+	push offset var_s
+	invoke crt_printf, addr str1
+	add esp, 4
+	movsx eax, byte ptr [ebp + -8]
+	push eax
+	mov eax, 1
+	mov ebx, offset var_s
+	add eax, ebx
+	pop ebx
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	add eax, ebx
+	pop ebx
+	mov byte ptr [ebx + 0], al
+	mov eax, 2
+	mov ebx, offset var_s
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	inc eax
+	push eax
+	mov eax, 2
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, eax
+	pop eax
+	mov byte ptr [ebx + 0], al
+	mov eax, 3
+	mov ebx, offset var_s
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	dec eax
+	push eax
+	mov eax, 3
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, eax
+	pop eax
+	mov byte ptr [ebx + 0], al
+	push offset var_s
+	invoke crt_printf, addr str2
+	add esp, 4
+	mov eax, 4
+	mov ebx, offset var_s
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, -12
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, dword ptr [ebp + -12]
+	mov ebx, 79
+	mov byte ptr [eax + 0], bl
+	mov eax, ebp
+	mov ebx, -4
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, -12
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, dword ptr [ebp + -12]
+	mov ebx, 122
+	mov byte ptr [eax + 0], bl
+	mov eax, ebx
+	movsx eax, byte ptr [ebp + -4]
+	push eax
+	push offset var_s
+	invoke crt_printf, addr str3
+	add esp, 8
+	mov eax, offset var_$x
+	mov ebx, 49
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$x
+	mov ebx, 1
+	add eax, ebx
+	mov ebx, 50
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$x
+	mov ebx, 2
+	add eax, ebx
+	mov ebx, 51
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$x
+	mov ebx, 3
+	add eax, ebx
+	mov ebx, 52
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$x
+	mov ebx, 4
+	add eax, ebx
+	mov ebx, 77
+	mov dword ptr [eax + 0], ebx
+	mov eax, offset var_$y
+	mov ebx, 3
+	add eax, ebx
+	mov ebx, 57
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$y
+	mov ebx, 4
+	add eax, ebx
+	mov ebx, 5
+	mov dword ptr [eax + 0], ebx
+	mov eax, offset var_$x
+	mov ebx, dword ptr [eax + 0]
+	mov eax, offset var_$y
+	mov ecx, ebx
+	mov byte ptr [eax + 0], cl
+	shr ecx, 8
+	mov byte ptr [eax + 1], cl
+	shr ecx, 8
+	mov byte ptr [eax + 2], cl
+	mov eax, offset var_$y
+	mov ebx, 4
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, offset var_$y
+	mov ebx, 3
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$y
+	mov ebx, 2
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$y
+	mov ebx, 1
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$y
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	invoke crt_printf, addr str4
+	add esp, 20
+	mov eax, offset var_$x
+	mov ebx, 3
+	add eax, ebx
+	mov ebx, -3
+	mov byte ptr [eax + 0], bl
+	mov eax, offset var_$x
+	mov ebx, 3
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$x
+	mov ebx, 3
+	add eax, ebx
+	pop ebx
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	imul eax, ebx
+	pop ebx
+	mov byte ptr [ebx + 0], al
+	mov eax, offset var_$x
+	mov ebx, 3
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$x
+	mov ebx, 3
+	add eax, ebx
+	pop ebx
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	cdq
+	idiv ebx
+	pop ebx
+	mov byte ptr [ebx + 0], al
+	movsx eax, byte ptr [ebp + -8]
+	push eax
+	mov eax, offset var_$x
+	mov ebx, 1
+	add eax, ebx
+	pop ebx
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	mov ecx, ebx
+	pop ebx
+	shl eax, cl
+	mov byte ptr [ebx + 0], al
+	mov eax, offset var_$x
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$x
+	mov ebx, 2
+	add eax, ebx
+	pop ebx
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	cdq
+	idiv ebx
+	pop ebx
+	mov eax, edx
+	mov byte ptr [ebx + 0], al
+	movsx eax, byte ptr [ebp + -8]
+	mov ebx, eax
+	mov eax, offset var_$x
+	movsx ecx, byte ptr [eax + 0]
+	push eax
+	mov eax, ecx
+	xor eax, ebx
+	pop ebx
+	mov byte ptr [ebx + 0], al
+	mov eax, offset var_$x
+	mov ebx, 4
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, offset var_$x
+	mov ebx, 2
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$x
+	mov ebx, 1
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$x
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, offset var_$x
+	mov ebx, 3
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	invoke crt_printf, addr str5
+	add esp, 20
+	push dword ptr 0
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, ebx
+for_main_0_cond:
+	push eax
+	mov eax, dword ptr [ebp + -16]
+	mov ebx, 1
+	imul eax, ebx
+	mov ebx, offset var_s
+	add eax, ebx
+	mov ebx, 0
+	movsx eax, byte ptr [eax + 0]
+	cmp eax, ebx
+	mov eax, 0
+	setne al
+	cmp eax, 0
+	je for_main_0_end
+	mov eax, dword ptr [ebp + -16]
+	mov ebx, 1
+	imul eax, ebx
+	mov ebx, offset var_s
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	invoke crt_printf, addr str6
+	add esp, 4
+	mov eax, dword ptr [ebp + -16]
+	inc eax
+	push eax
+	mov eax, ebp
+	mov ebx, -16
+	add eax, ebx
+	mov ebx, eax
+	pop eax
+	mov dword ptr [ebx + 0], eax
+	jmp for_main_0_cond
+for_main_0_end:
+	push eax
+	invoke crt_printf, addr str7
+	mov esp, ebp
+	pop ebp
+	ret 0
+start:
+	call f_main
+	ret 0
+end start
\ No newline at end of file
@@ -0,0 +1,441 @@
+.686
+.model flat, stdcall
+include c:\masm32\include\msvcrt.inc
+includelib c:\masm32\lib\msvcrt.lib
+.data
+	str0 db "%d %d %d %d %d %c", 0dh, 0ah, 0
+	str1 db "%d %d %d", 0dh, 0ah, 0
+	str2 db "%d", 0dh, 0ah, 0
+	str3 db "%d", 0dh, 0ah, 0
+	str4 db "%d", 0dh, 0ah, 0
+	str5 db "%d %d", 0dh, 0ah, 0
+	str6 db "%d %d %d", 0dh, 0ah, 0
+	str7 db "%d %d %d", 0dh, 0ah, 0
+	str8 db "%d", 0dh, 0ah, 0
+	var_$g dd 6 dup(0)
+	tmp4 real4 0.000000
+	tmp8 real8 0.000000
+.code
+f_sum:
+	push ebp
+	mov ebp, esp
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 20
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 12
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 8
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 4
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	pop ebx
+	mov eax, dword ptr [eax + 0]
+	add eax, ebx
+	pop ebx
+	add eax, ebx
+	pop ebx
+	add eax, ebx
+	pop ebx
+	add eax, ebx
+	pop ebx
+	add eax, ebx
+	mov dword ptr [ebp + 32], eax
+	mov esp, ebp
+	pop ebp
+	ret 0
+f_make:
+	push ebp
+	mov ebp, esp
+	sub esp, 24
+	push dword ptr [ebp + 8]
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, dword ptr [ebp + 8]
+	mov ebx, 1
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 4
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, dword ptr [ebp + 8]
+	mov ebx, 2
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 8
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, dword ptr [ebp + 8]
+	mov ebx, 3
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 12
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, dword ptr [ebp + 8]
+	mov ebx, 4
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	push dword ptr 65
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 20
+	add eax, ebx
+	pop ebx
+	mov byte ptr [eax + 0], bl
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov esi, eax
+	mov edi, ebp
+	add edi, 12
+	mov ecx, 6
+	rep movsd
+	mov esp, ebp
+	pop ebp
+	ret 0
+f_pass:
+	push ebp
+	mov ebp, esp
+	push dword ptr 10
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	pop ebx
+	mov eax, dword ptr [eax + 0]
+	imul eax, ebx
+	push eax
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, ebp
+	mov ebx, 8
+	add eax, ebx
+	mov esi, eax
+	mov edi, ebp
+	add edi, 32
+	mov ecx, 6
+	rep movsd
+	mov esp, ebp
+	pop ebp
+	ret 0
+f_keep:
+	push ebp
+	mov ebp, esp
+	mov eax, ebp
+	mov ebx, 12
+	add eax, ebx
+	mov edi, dword ptr [ebp + 8]
+	mov esi, eax
+	mov ecx, 6
+	rep movsd
+	mov esi, dword ptr [ebp + 8]
+	mov edi, ebp
+	add edi, 36
+	mov ecx, 6
+	rep movsd
+	mov esp, ebp
+	pop ebp
+	ret 0
+f_main:
+	push ebp
+	mov ebp, esp
+	sub esp, 72
+	sub esp, 24
+	push dword ptr 1
+	call f_make
+	add esp, 4
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov edi, eax
+	mov esi, esp
+	mov ecx, 6
+	rep movsd
+	add esp, 24
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 20
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 12
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 8
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov ebx, 4
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	push dword ptr [eax + 0]
+	invoke crt_printf, addr str0
+	add esp, 24
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	pop esi
+	mov ebx, -48
+	add eax, ebx
+	mov edi, eax
+	mov ecx, 6
+	rep movsd
+	push dword ptr 100
+	mov eax, ebp
+	mov ebx, -48
+	add eax, ebx
+	pop ebx
+	mov dword ptr [eax + 0], ebx
+	mov eax, ebp
+	mov ebx, -48
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -48
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	push dword ptr [eax + 0]
+	invoke crt_printf, addr str1
+	add esp, 12
+	sub esp, 4
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	mov esi, eax
+	sub esp, 24
+	mov edi, esp
+	mov ecx, 6
+	rep movsd
+	call f_sum
+	add esp, 24
+	invoke crt_printf, addr str2
+	add esp, 4
+	sub esp, 4
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	pop esi
+	mov ebx, -48
+	add eax, ebx
+	mov edi, eax
+	mov ecx, 6
+	rep movsd
+	mov eax, ebp
+	mov ebx, -48
+	add eax, ebx
+	mov esi, eax
+	sub esp, 24
+	mov edi, esp
+	mov ecx, 6
+	rep movsd
+	call f_sum
+	add esp, 24
+	invoke crt_printf, addr str3
+	add esp, 4
+	mov eax, ebp
+	mov ebx, -48
+	add eax, ebx
+	push dword ptr [eax + 0]
+	invoke crt_printf, addr str4
+	add esp, 4
+	sub esp, 24
+	sub esp, 24
+	push dword ptr 10
+	call f_make
+	add esp, 4
+	call f_pass
+	add esp, 24
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	mov edi, eax
+	mov esi, esp
+	mov ecx, 6
+	rep movsd
+	add esp, 24
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	push dword ptr [eax + 0]
+	invoke crt_printf, addr str5
+	add esp, 8
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	push eax
+	mov eax, ebp
+	pop esi
+	mov ebx, -48
+	add eax, ebx
+	mov edi, eax
+	mov ecx, 6
+	rep movsd
+	mov eax, ebp
+	mov ebx, -48
+	add eax, ebx
+	mov edi, offset var_$g
+	mov esi, eax
+	mov ecx, 6
+	rep movsd
+	mov eax, offset var_$g
+	mov ebx, 20
+	add eax, ebx
+	movsx eax, byte ptr [eax + 0]
+	push eax
+	mov eax, ebp
+	mov ebx, -48
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, offset var_$g
+	mov ebx, 16
+	add eax, ebx
+	push dword ptr [eax + 0]
+	invoke crt_printf, addr str6
+	add esp, 12
+	sub esp, 24
+	sub esp, 24
+	push dword ptr 20
+	call f_make
+	add esp, 4
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	push eax
+	call f_keep
+	add esp, 28
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	mov edi, eax
+	mov esi, esp
+	mov ecx, 6
+	rep movsd
+	add esp, 24
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	mov ebx, 16
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	push dword ptr [eax + 0]
+	mov eax, ebp
+	mov ebx, -24
+	add eax, ebx
+	push dword ptr [eax + 0]
+	invoke crt_printf, addr str7
+	add esp, 12
+	sub esp, 4
+	sub esp, 24
+	mov eax, ebp
+	mov ebx, -72
+	add eax, ebx
+	mov esi, eax
+	sub esp, 24
+	mov edi, esp
+	mov ecx, 6
+	rep movsd
+	call f_pass
+	add esp, 24
+	call f_sum
+	add esp, 24
+	invoke crt_printf, addr str8
+	add esp, 4
+	mov esp, ebp
+	pop ebp
+	ret 0
+start:
+	call f_main
+	ret 0
+end start
\ No newline at end of file
@@ -0,0 +1,8 @@
+#ifndef GUARD_H
+#define GUARD_H
+#ifdef GUARD_SEEN
+int twice;
+#endif
+#define GUARD_SEEN
+int guarded;
+#endif
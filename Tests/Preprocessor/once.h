@@ -0,0 +1,6 @@
+#pragma once
+#ifdef ONCE_SEEN
+int twice;
+#endif
+#define ONCE_SEEN
+int once;
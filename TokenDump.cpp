@@ -0,0 +1,226 @@
+#include <cstring>
+#include <cstdio>
+#include <sstream>
+#include "TokenDump.h"
+
+static const size_t flushSize = 1 << 16;
+
+static void putWord(string& buffer, unsigned word)
+{
+	char bytes[4] = { (char) word, (char) (word >> 8), (char) (word >> 16), (char) (word >> 24) };
+	buffer.append(bytes, 4);
+}
+
+static void putRecord(string& buffer, unsigned char kind, int line, int col, unsigned payload, const char* text, size_t length)
+{
+	buffer.push_back((char) kind);
+	putWord(buffer, line);
+	putWord(buffer, col);
+	putWord(buffer, payload);
+	putWord(buffer, length);
+	buffer.append(text, length);
+}
+
+void dumpTokensBinary(Scanner& scanner, ostream& out)
+{
+	string buffer("CTOK");
+	putWord(buffer, tokenDumpVersion);
+	try {
+		while (scanner.hasNext())
+		{
+			Token* token = scanner.next();
+			if (*token != END_OF_FILE)
+			{
+				unsigned payload = 0;
+				if (*token != IDENTIFIER && *token != STRING) // ids are only meaningful inside one process
+					memcpy(&payload, &token->intVal, sizeof(payload));
+				putRecord(buffer, token->type, token->line(), token->col(), payload, token->source, token->length);
+			}
+			if (buffer.length() >= flushSize)
+			{
+				out.write(buffer.data(), buffer.length());
+				buffer.clear();
+				scanner.dropTokens();
+			}
+		}
+	} catch (exception& e) {
+		putRecord(buffer, errorRecord, 0, 0, 0, e.what(), strlen(e.what()));
+	}
+	out.write(buffer.data(), buffer.length());
+	out.flush();
+}
+
+static void putJsonString(string& buffer, const char* text, size_t length)
+{
+	buffer.push_back('"');
+	for (size_t i = 0; i < length; i++)
+	{
+		unsigned char c = text[i];
+		if (c == '"' || c == '\\')
+		{
+			buffer.push_back('\\');
+			buffer.push_back(c);
+		} else if (c == '\n')
+			buffer += "\\n";
+		else if (c == '\t')
+			buffer += "\\t";
+		else if (c < 0x20 || c >= 0x7f)
+		{
+			char escaped[8];
+			sprintf(escaped, "\\u%04x", c);
+			buffer += escaped;
+		} else
+			buffer.push_back(c);
+	}
+	buffer.push_back('"');
+}
+
+void dumpTokensJson(Scanner& scanner, ostream& out)
+{
+	string buffer("[");
+	const char* separator = "\n";
+	try {
+		while (scanner.hasNext())
+		{
+			Token* token = scanner.next();
+			if (*token != END_OF_FILE)
+			{
+				char head[100];
+				sprintf(head, "%s\t{ \"kind\": \"%s\", \"line\": %d, \"col\": %d, \"text\": ", separator, 
+					tokenTypeName(token->type).c_str(), token->line(), token->col());
+				buffer += head;
+				putJsonString(buffer, token->source, token->length);
+				buffer += " }";
+				separator = ",\n";
+			}
+			if (buffer.length() >= flushSize)
+			{
+				out.write(buffer.data(), buffer.length());
+				buffer.clear();
+				scanner.dropTokens();
+			}
+		}
+	} catch (exception& e) {
+		buffer += separator;
+		buffer += "\t{ \"error\": ";
+		putJsonString(buffer, e.what(), strlen(e.what()));
+		buffer += " }";
+	}
+	buffer += "\n]\n";
+	out.write(buffer.data(), buffer.length());
+	out.flush();
+}
+
+static bool sameToken(Token* a, Token* b)
+{
+	return a->type == b->type && a->text() == b->text() && a->line() == b->line() && a->col() == b->col();
+}
+
+// Tokens of filename after the edit its first line asks for, "// relex start end text" with text
+// in C escapes, re-lexed from the tokens before the edit; then whether a full lex gives the same
+void dumpRelexed(const char* filename, ostream& out)
+{
+	Scanner old(filename);
+	ActiveScope<LiteralPool> values(old.literalPool()); // the edit shares them, the full lex has its own
+	old.trackEdits();
+	while (old.hasNext())
+		old.next();
+	const string& text = *old.sourceText();
+	string line = text.substr(0, text.find('\n'));
+	if (!line.empty() && line.back() == '\r')
+		line.pop_back();
+	unsigned start, end;
+	int skip = 0;
+	if (sscanf(line.c_str(), "// relex %u %u%n", &start, &end, &skip) != 2 || start > end || end > text.length())
+		throw exception("Expected // relex start end text on the first line");
+	if (skip < line.length())
+		skip++;
+	string replacement(line.length() - skip, '\0');
+	char* replacementEnd = decodeLiteral(line.data() + skip, line.data() + line.length(), &replacement[0]);
+	if (!replacementEnd)
+		throw exception("Invalid escape sequence");
+	replacement.resize(replacementEnd - &replacement[0]);
+
+	Scanner* edited = 0;
+	string editedError, wholeError;
+	try {
+		edited = new Scanner(old, start, end, replacement);
+	} catch (exception& e) {
+		editedError = e.what();
+	}
+	int differs = -1;
+	{
+		istringstream input(text.substr(0, start) + replacement + text.substr(end));
+		Scanner whole(input);
+		try {
+			while (whole.hasNext())
+				whole.next();
+		} catch (exception& e) {
+			wholeError = e.what();
+		}
+		if (!edited && editedError != wholeError || edited && !wholeError.empty())
+			differs = 0;
+		for (int i = 0; edited && differs == -1 && i < edited->tokensCount(); i++)
+			if (i >= whole.tokensCount() || !sameToken(edited->token(i), whole.token(i)))
+				differs = i;
+		if (edited && differs == -1 && edited->tokensCount() != whole.tokensCount())
+			differs = edited->tokensCount();
+	}
+	if (!edited)
+		out << lineSeparator << editedError << endl << lineSeparator;
+	for (int i = 0; edited && i < edited->tokensCount(); i++)
+		if (*edited->token(i) != END_OF_FILE)
+			out << edited->token(i)->info() << endl << lineSeparator;
+	if (differs == -1)
+		out << "relex matches full lex" << endl;
+	else
+		out << "relex differs at token " << differs << endl;
+	delete edited;
+}
+
+TokenDumpReader::TokenDumpReader(istream& input): in(input)
+{
+	char magic[4];
+	in.read(magic, 4);
+	if (!in || memcmp(magic, "CTOK", 4) != 0 || readWord() != tokenDumpVersion)
+		throw exception("Not a token dump");
+}
+
+unsigned TokenDumpReader::readWord()
+{
+	unsigned char bytes[4];
+	in.read((char*) bytes, 4);
+	if (!in)
+		throw exception("Truncated token dump");
+	return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (unsigned) bytes[3] << 24;
+}
+
+// Returns 0 at the end of the dump; the token is valid until the next call.
+// Its text is not one the SourceMap knows, so its position comes from line() and col()
+Token* TokenDumpReader::next()
+{
+	int kind = in.get();
+	if (kind == EOF)
+		return 0;
+	tokenLine = readWord();
+	tokenCol = readWord();
+	unsigned payload = readWord();
+	unsigned length = readWord();
+	spelling.resize(length);
+	if (length > 0)
+		in.read(&spelling[0], length);
+	if (!in)
+		throw exception("Truncated token dump");
+	if (kind == errorRecord)
+		throw exception(spelling.c_str());
+	token.type = (TokenTypesT) kind;
+	token.source = spelling.data();
+	token.offset = 0;
+	token.length = length;
+	memcpy(&token.intVal, &payload, sizeof(payload));
+	if (kind == IDENTIFIER)
+		token.nameId = Interner::current().intern(spelling);
+	else if (kind == STRING && (length < 2 || (token.strVal = literals.add(spelling.data() + 1, spelling.data() + length - 1)) == noLiteral))
+		throw exception("Invalid string literal in token dump");
+	return &token;
+}
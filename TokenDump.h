@@ -0,0 +1,38 @@
+#ifndef TOKEN_DUMP_H
+#define TOKEN_DUMP_H
+
+#include <iostream>
+#include <string>
+#include "Scanner.h"
+
+using namespace std;
+
+// Binary dump: the header "CTOK" and a version word, then one record per token
+// (u8 kind, u32 line, u32 col, u32 payload, u32 length, spelling bytes), all little-endian.
+// A lexer error ends the stream with a record of kind errorRecord whose spelling is the message
+static const unsigned tokenDumpVersion = 1;
+static const unsigned char errorRecord = 0xff;
+
+void dumpTokensBinary(Scanner& scanner, ostream& out);
+void dumpTokensJson(Scanner& scanner, ostream& out);
+void dumpRelexed(const char* filename, ostream& out);
+
+class TokenDumpReader
+{
+private:
+	istream& in;
+	LiteralPool literals;
+	string spelling;
+	Token token;
+	int tokenLine;
+	int tokenCol;
+	unsigned readWord();
+public:
+	TokenDumpReader(istream& input);
+	LiteralPool& literalPool() { return literals; }
+	Token* next();
+	int line() const { return tokenLine; }
+	int col() const { return tokenCol; }
+};
+
+#endif
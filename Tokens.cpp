@@ -1,6 +1,11 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "Tokens.h"
+#include "SourceMap.h"
+#include "LiteralPool.h"
 
-string Token::tokenTypeName(TokenTypesT type)
+string tokenTypeName(TokenTypesT type)
 {
 	switch(type) 
 	{
@@ -25,75 +30,150 @@ string Token::tokenTypeName(TokenTypesT type)
 	case COMMENT:
 		return "Comment";
 	}
+	return string();
 }
 
-string Token::info()
+// What follows a backslash: the character a simple escape stands for, or how to read a numeric one
+static const short octalEscape = 256, hexEscape = 257, badEscape = -1;
+static short escapeValues[256];
+static signed char hexDigits[256];
+
+static bool initEscapes()
 {
-	char info[500];
-	sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%s", tokenTypeName(type).c_str(), line, col, text.c_str(), text.c_str());
-	return string(info);
+	for (int i = 0; i < 256; i++)
+	{
+		escapeValues[i] = badEscape;
+		hexDigits[i] = -1;
+	}
+	const char* letters = "ntrabfv\\'\"?";
+	const char* values = "\n\t\r\a\b\f\v\\'\"?";
+	for (int i = 0; letters[i]; i++)
+		escapeValues[(unsigned char) letters[i]] = (unsigned char) values[i];
+	for (int i = 0; i < 10; i++)
+	{
+		hexDigits['0' + i] = i;
+		if (i < 8)
+			escapeValues['0' + i] = octalEscape;
+	}
+	for (int i = 0; i < 6; i++)
+		hexDigits['a' + i] = hexDigits['A' + i] = 10 + i;
+	escapeValues['x'] = hexEscape;
+	return true;
 }
 
-string StringValToken::info()
+static bool escapesReady = initEscapes();
+
+// c points past the backslash and is left past the escape; false if it is not a valid one
+bool decodeEscape(const char*& c, const char* end, char& value)
 {
-	char* info;
-	int length = val.length() + text.length() + resourceSize;
-	info = (char*) malloc(sizeof(char) * length);
-	sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%s", tokenTypeName(type).c_str(), line, col, text.c_str(), val.c_str());
-	string res(info);
-	free(info);
-	return res;
+	if (c == end)
+		return false;
+	short kind = escapeValues[(unsigned char) *c++];
+	if (kind == badEscape)
+		return false;
+	if (kind < octalEscape)
+	{
+		value = (char) kind;
+		return true;
+	}
+	unsigned code = 0;
+	if (kind == octalEscape)
+	{
+		code = c[-1] - '0';
+		for (int digits = 1; digits < 3 && c < end && *c >= '0' && *c <= '7'; digits++)
+			code = code * 8 + *c++ - '0';
+	}
+	else
+	{
+		const char* digits = c;
+		for (; c < end && hexDigits[(unsigned char) *c] >= 0; c++)
+			if ((code = code * 16 + hexDigits[(unsigned char) *c]) > 0xff)
+				return false;
+		if (c == digits)
+			return false;
+	}
+	if (code > 0xff)
+		return false;
+	value = (char) code;
+	return true;
 }
 
-string IntegerToken::info()
+// Writes the value of literal text found between the quotes to out, which has room for
+// end - begin chars as a value is never longer than its text. Returns the end of the value, 0 on an invalid escape
+char* decodeLiteral(const char* begin, const char* end, char* out)
 {
-	char* info;
-	int length = text.length() * 2 + resourceSize;
-	info = (char*) malloc(sizeof(char) * length);
-	sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%d", tokenTypeName(type).c_str(), line, col, text.c_str(), val);
-	string res(info);
-	free(info);
-	return res;
+	short kind;
+	for (const char* c = begin; c < end;)
+	{
+		if (*c != '\\')
+			*out++ = *c++;
+		else if (c + 1 < end && (kind = escapeValues[(unsigned char) c[1]]) >= 0 && kind < octalEscape)
+		{
+			// one character escapes, by far the most common, are read right here
+			*out++ = (char) kind;
+			c += 2;
+		}
+		else if (!decodeEscape(++c, end, *out++))
+			return 0;
+	}
+	return out;
 }
 
-string FloatToken::info()
+string Token::stringVal() const
 {
-	char* info;
-	int length = text.length() * 2 + resourceSize;
-	info = (char*) malloc(sizeof(char) * length);
-	sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%f", tokenTypeName(type).c_str(), line, col, text.c_str(), val);
-	string res(info);
-	free(info);
-	return res;
+	if (type != STRING)
+		return text();
+	return LiteralPool::current().value(strVal);
 }
 
-string CharToken::info()
+// Identifiers are interned by the scanner; any other token is only looked up, 
+// so type keywords find their symbols and the rest get noName
+NameIdT Token::name() const
 {
-	char* info;
-	int length = text.length() * 2 + resourceSize;
-	info = (char*) malloc(sizeof(char) * length);
-	sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%c", tokenTypeName(type).c_str(), line, col, text.c_str(), val);
-	string res(info);
-	free(info);
-	return res;
+	if (type == IDENTIFIER)
+		return nameId;
+	return Interner::current().find(source, length);
 }
 
-bool OpToken::operator==(OperationsT o) const 
+int Token::line() const
 {
-	return o == val;
+	int line, col;
+	SourceMap::current().locate(source + length, offset, line, col);
+	return line;
 }
 
-bool OpToken::operator!=(OperationsT o) const
+int Token::col() const
 {
-	return o != val;
+	int line, col;
+	SourceMap::current().locate(source + length, offset, line, col);
+	return col;
 }
 
-bool KeywordToken::operator==(KeywordsT o) const 
+string Token::info() const
 {
-	return o == val;
+	int line, col;
+	SourceMap::current().locate(source + length, offset, line, col);
+	return info(line, col);
 }
 
-bool KeywordToken::operator!=(KeywordsT o) const
+string Token::info(int line, int col) const
 {
-	return o != val;
+	if (type == END_OF_FILE)
+		return string();
+	string txt = text();
+	string val = stringVal();
+	char* info;
+	int size = txt.length() + val.length() + resourceSize;
+	info = (char*) malloc(sizeof(char) * size);
+	if (type == INTEGER)
+		sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%d", tokenTypeName(type).c_str(), line, col, txt.c_str(), intVal);
+	else if (type == REAL_NUMBER)
+		sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%f", tokenTypeName(type).c_str(), line, col, txt.c_str(), floatVal);
+	else if (type == CHARACTER)
+		sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%c", tokenTypeName(type).c_str(), line, col, txt.c_str(), charVal);
+	else
+		sprintf(info, "%s\t\t%d\t\t%d\t\t%s\t\t%s", tokenTypeName(type).c_str(), line, col, txt.c_str(), val.c_str());
+	string res(info);
+	free(info);
+	return res;
 }
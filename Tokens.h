@@ -2,6 +2,8 @@
 #define TOKEN_H_INCLUDED
 
 #include <string>
+#include "Interner.h"
+#include "LiteralPool.h"
 
 using namespace std;
 
@@ -98,138 +100,64 @@ typedef enum {
 	SCANF
 } OperationsT;
 
-class Token
+typedef enum {
+	PP_DEFINE,
+	PP_UNDEF,
+	PP_INCLUDE,
+	PP_IF,
+	PP_IFDEF,
+	PP_IFNDEF,
+	PP_ELSE,
+	PP_ELIF,
+	PP_ENDIF,
+	PP_LINE,
+	PP_ERROR,
+	PP_PRAGMA,
+	PP_NULL
+} DirectivesT;
+
+// Tokens are plain values kept by the scanner: text is a view into the scanner input
+// and the kind tag says which member of the payload union is valid. The line is the one
+// the scanner was on when the token ended, offset is where its reported column points;
+// both are looked up in the SourceMap only when asked for
+struct Token
 {
-protected:	
-	TokenTypesT type;	
-	string tokenTypeName(TokenTypesT type);	
-public:	
-	int line;
-	int col;
-	string text;
-	friend class Parser;	
-	friend class BinaryOpNode;
-	friend class UnaryOpNode;
-	friend class KeywordNode;
-	Token(TokenTypesT t, int l, int c, const string& str): type(t), line(l), col(c), text(str) {}
+	const char* source;
+	unsigned offset;
+	unsigned length : 24;
+	TokenTypesT type : 8;
+	union {
+		int intVal;
+		float floatVal;
+		char charVal;
+		OperationsT op;
+		KeywordsT keyword;
+		SeparatorsT sep;
+		DirectivesT directive;
+		NameIdT nameId;
+		LiteralIdT strVal; // decoded value of a string literal in the LiteralPool
+	};
+	string text() const { return string(source, length); }
+	string stringVal() const;
+	NameIdT name() const;
 	bool operator == (TokenTypesT o) const { return type == o; }
 	bool operator != (TokenTypesT o) const { return type != o; }
-	virtual bool operator == (OperationsT o) const { return false; }
-	virtual bool operator != (OperationsT o) const { return true; }
-	virtual bool operator == (SeparatorsT o) const { return false; }
-	virtual bool operator != (SeparatorsT o) const { return true; }	
-	virtual bool operator == (string o) const { return false; }
-	virtual bool operator == (KeywordsT o) const { return false; }
-	virtual bool operator != (KeywordsT o) const { return true; }
-	virtual string info();
-};
-
-class EOFToken : public Token
-{
-public:
-	EOFToken(int l, int c): Token(END_OF_FILE, l, c, "") {}
-	string info() { return string(); }
-};
-
-class StringValToken : public Token
-{
-protected:
-	string val;
-public:
-	friend class Parser;
-	friend class IdentifierNode;
-	StringValToken(TokenTypesT t, int l, int c, const string& str): Token(t, l, c, str), val(str) {}
-	string info();
-};
-
-class CommentToken : public StringValToken
-{
-public:
-	CommentToken(int l, int c, const string& str): StringValToken(COMMENT, l, c, str) {}
-};
-
-class StringToken : public StringValToken
-{
-public:
-	friend class Parser;
-	friend class StringNode;
-	StringToken(TokenTypesT t, int l, int c, const string& str, const string& v): StringValToken(t, l, c, str) 
-	{
-		val = string(v);
-	}
-};
-
-class IdentifierToken : public StringValToken
-{
-public:
-	friend class Parser;
-	IdentifierToken(int l, int c, const string& str): StringValToken(IDENTIFIER, l, c, str) {}
+	bool operator == (OperationsT o) const { return type == OPERATION && op == o; }
+	bool operator != (OperationsT o) const { return type != OPERATION || op != o; }
+	bool operator == (SeparatorsT o) const { return type == SEPARATOR && sep == o; }
+	bool operator != (SeparatorsT o) const { return type != SEPARATOR || sep != o; }
+	bool operator == (KeywordsT o) const { return type == KEYWORD && keyword == o; }
+	bool operator != (KeywordsT o) const { return type != KEYWORD || keyword != o; }
+	int line() const;
+	int col() const;
+	string info() const;
+	string info(int line, int col) const;
 };
 
-class IntegerToken : public Token
-{
-private:
-	int val;
-public:
-	friend class Parser;
-	friend class IntNode;
-	IntegerToken(int l, int c, const string& str, int v): Token(INTEGER, l, c, str), val(v) {}
-	string info();
-};
-
-class FloatToken : public Token
-{
-private:
-	float val;
-public:
-	friend class Parser;
-	friend class FloatNode;
-	FloatToken(int l, int c, const string& str, float v): Token(REAL_NUMBER, l, c, str), val(v) {}
-	string info();
-};
-
-class CharToken : public Token 
-{
-private:
-	char val;
-public:
-	friend class Parser;
-	friend class CharNode;
-	CharToken(int l, int c, const string& str, char v): Token(CHARACTER, l, c, str), val(v) {}
-	string info();
-};
+static const unsigned maxTokenLength = (1 << 24) - 1;
 
-class OpToken : public Token
-{
-public:
-	friend class IOOperatorNode;
-	OperationsT val;
-	OpToken(int l, int c, const string& str, OperationsT op): Token(OPERATION, l, c, str), val(op) {}
-	bool operator == (OperationsT o) const;
-	bool operator != (OperationsT o) const;
-};
-
-class SepToken : public Token
-{
-private:
-	SeparatorsT val;
-public:
-	friend class Parser;
-	SepToken(int l, int c, const string& str, SeparatorsT sep): Token(SEPARATOR, l, c, str), val(sep) {}
-	bool operator == (SeparatorsT o) const { return o == val; }
-	bool operator != (SeparatorsT o) const { return o != val; }
-};
-
-class KeywordToken : public Token
-{
-private:
-	KeywordsT val;
-public:
-	friend class Parser;
-	friend class KeywordNode;
-	KeywordToken(int l, int c, const string& str, KeywordsT keyword): Token(KEYWORD, l, c, str), val(keyword) {}
-	bool operator == (KeywordsT o) const;
-	bool operator != (KeywordsT o) const;
-};
+bool decodeEscape(const char*& c, const char* end, char& value);
+char* decodeLiteral(const char* begin, const char* end, char* out);
+string tokenTypeName(TokenTypesT type);
 
 #endif
\ No newline at end of file
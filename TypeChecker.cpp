@@ -0,0 +1,157 @@
+#include "TypeChecker.h"
+#include "TypeTable.h"
+#include "Exceptions.h"
+
+using namespace std;
+
+TypeSym* TypeChecker::visitBinaryOp(const BinaryOpNode* node)
+{
+	TypeSym* leftType = node->left->getType();
+	TypeSym* rightType = node->right->getType();
+	if (isa<AliasSym>(leftType))
+		leftType = leftType->getType();
+	if (isa<AliasSym>(rightType))
+		rightType = rightType->getType();
+	OperationsT op = node->token->op;
+	TypeSym* maxTypeOfArgs = typeOfOperation(operationTypeOperands, op);
+	if (!maxTypeOfArgs)
+		maxTypeOfArgs = priorityOf(leftType) > priorityOf(rightType) ? leftType : rightType;
+	PointerSym* lp = dyn_cast<PointerSym>(leftType);
+	PointerSym* rp = dyn_cast<PointerSym>(rightType);
+	ArraySym* la = dyn_cast<ArraySym>(leftType);
+	ArraySym* ra = dyn_cast<ArraySym>(rightType);
+	switch (op)
+	{
+	case MOD_ASSIGN:
+	case AND_ASSIGN:
+	case OR_ASSIGN:
+	case XOR_ASSIGN:
+	case BITWISE_SHIFT_LEFT_ASSIGN:
+	case BITWISE_SHIFT_RIGHT_ASSIGN:	
+		if (!leftType->canConvertTo(intType) || !rightType->canConvertTo(intType))
+			throw CompilerException("Invalid operator arguments type (required int in both sides)", node->token);
+		// fallthrough
+	case ASSIGN:
+		if (leftType->isStruct() && *leftType == rightType)
+			return leftType;
+		// fallthrough
+	case MULT_ASSIGN:
+	case PLUS_ASSIGN:
+	case MINUS_ASSIGN:
+	case DIV_ASSIGN:		
+		if (!node->left->isModifiableLvalue())
+			throw CompilerException("Left argument of assignment must be modifiable lvalue", node->left->token);
+		node->right = Node::makeTypeCoerce(node->right, rightType, leftType);
+		return leftType;
+	case DOT:
+		if (!isa<StructSym>(leftType))
+			throw CompilerException("Left operand of . must be a structure", node->left->token);
+		return rightType;
+	case ARROW:
+		if (!lp || (!isa<StructSym>(lp->type) && !isa<StructSym>(dyn_cast<AliasSym>(lp->type)->type)))
+			throw CompilerException("Left operand of -> must be of pointer-to-structure type", node->left->token);
+		return rightType;		
+	case MINUS:		
+		if (lp && rp || la && ra)
+		{
+			if (lp && rp && lp->type != rp->type 
+				|| la && ra && la->type != ra->type)
+				throw CompilerException("Operand types are incompatible", node->token);
+			return intType;
+		}			
+	case PLUS:
+		if (lp && rp || la && ra)
+			throw CompilerException("Cannot add two pointers", node->token);
+		if (lp || rp)
+			return lp == 0 ? rightType : leftType;
+		if (la || ra)
+			return TypeTable::current().pointerTo(la == 0 ? ra->type : la->type);
+	default:
+		if (leftType->isStruct() || rightType->isStruct())
+			throw CompilerException("Cannot perform operation over two structures", node->token);
+		if (priorityOf(maxTypeOfArgs) < max(priorityOf(leftType), priorityOf(rightType)))
+			throw CompilerException("Invalid type of operands", node->token);
+		node->left = Node::makeTypeCoerce(node->left, leftType, maxTypeOfArgs);
+		node->right = Node::makeTypeCoerce(node->right, rightType, maxTypeOfArgs);
+		TypeSym* returning = typeOfOperation(operationReturningType, op);
+		return returning ? returning : maxTypeOfArgs;
+	}	
+}
+
+TypeSym* TypeChecker::visitUnaryOp(const UnaryOpNode* node)
+{
+	TypeSym* type = node->operand->getType();
+	OperationsT op = node->token->op;
+	switch (op)
+	{
+	case MULT:
+		if (!isa<PointerSym>(type))
+			throw CompilerException("Type of unary operation is not a pointer", node->token);
+		return cast<PointerSym>(type)->type;
+	case BITWISE_AND:
+		if (!node->operand->isLvalue())
+			throw CompilerException("Expression must have lvalue", node->token);
+		if (isa<IdentifierNode>(node->operand) && !cast<IdentifierNode>(node->operand)->sym->global)
+			cast<IdentifierNode>(node->operand)->sym->addressTaken = true;
+		return TypeTable::current().pointerTo(type);
+		break;
+	case BITWISE_NOT:
+		node->operand = Node::makeTypeCoerce(node->operand, type, intType);
+		break;
+	case LOGICAL_NOT:
+		if (isa<StructSym>(type))
+			throw CompilerException("Cannot perform logical not operation over structure", node->token);
+		break;
+	case DEC:
+	case INC:
+		if (!node->operand->isModifiableLvalue())
+			throw CompilerException("Expression must have modifiable lvalue", node->token);
+		break;
+	case MINUS:
+		if (!type->canConvertTo(floatType))
+			throw CompilerException("Expression must have arithmetic type", node->token);
+	}
+	return type;	
+}
+
+TypeSym* TypeChecker::visitFuncCall(const FuncCallNode* node)
+{
+	FuncSym* sym = node->symbol;
+	int formalParametersCount = sym->params->size();
+	int realParametersCount = node->args.size();
+	if (formalParametersCount != realParametersCount)
+		throw CompilerException("Incorrect parameters count", node->token);
+	for (int i = 0; i < formalParametersCount; i++)
+	{
+		TypeSym* realParamType = node->args[i]->getType();
+		TypeSym* formalParamType = (*sym->params)[i]->getType();
+		if (isa<AliasSym>(realParamType))
+			realParamType = realParamType->getType();
+		if (isa<AliasSym>(formalParamType))
+			formalParamType = formalParamType->getType();
+		if (!realParamType->canConvertTo(formalParamType))
+			throw CompilerException("Invalid type of parameter", node->args[i]->token);
+		node->args[i] = Node::makeTypeCoerce(node->args[i], realParamType, formalParamType);
+	}
+	return node->symbol->getType();
+}
+
+TypeSym* TypeChecker::visitArr(const ArrNode* node)
+{
+	TypeSym* sym = dyn_cast<ArraySym>(node->name->getType());
+	if (!sym)
+		sym = dyn_cast<PointerSym>(node->name->getType());
+	if (!sym)
+		throw CompilerException("Expression must have a pointer-to-object type", node->name->token);
+	TypeSym* type = sym;
+	for (int i = 0; i < node->args.size(); i++)
+	{
+		type = type->nextType();
+		if (type == 0)
+			throw CompilerException("Expression must have a pointer-to-object type", node->args[i]->token);
+		if (!node->args[i]->getType()->canConvertTo(intType))
+			throw CompilerException("Expression must have integral type", node->args[i]->token);
+		node->args[i] = Node::makeTypeCoerce(node->args[i], node->args[i]->getType(), intType);			
+	}
+	return type;
+}
@@ -0,0 +1,24 @@
+#ifndef TYPE_CHECKER_H
+#define TYPE_CHECKER_H
+
+#include "NodeVisitor.h"
+
+// Semantic check of one node whose operands are already checked: resolves its type, reports
+// invalid operands and wraps them in the coercions they need. Node::getType runs it once per
+// node and keeps the result, so the parser and code generator only read the annotation
+class TypeChecker : public NodeVisitor<TypeChecker, TypeSym*>
+{
+public:
+	TypeSym* visitUnaryOp(const UnaryOpNode* node);
+	TypeSym* visitCoerce(const CoerceNode* node) { return node->type; }
+	TypeSym* visitBinaryOp(const BinaryOpNode* node);
+	TypeSym* visitInt(const IntNode* node) { return intType; }
+	TypeSym* visitFloat(const FloatNode* node) { return floatType; }
+	TypeSym* visitIdentifier(const IdentifierNode* node) { return node->sym->getType(); }
+	TypeSym* visitFuncCall(const FuncCallNode* node);
+	TypeSym* visitArr(const ArrNode* node);
+	TypeSym* visitChar(const CharNode* node) { return charType; }
+	TypeSym* visitString(const StringNode* node) { return stringType; }
+};
+
+#endif
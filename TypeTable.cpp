@@ -0,0 +1,82 @@
+#include "TypeTable.h"
+
+// String literals are typed by the one shared stringType, so it is this table's pointer to char
+TypeTable::TypeTable()
+{
+	pointers[charType] = stringType;
+}
+
+PointerSym* TypeTable::pointerTo(TypeSym* type)
+{
+	if (isa<FuncSym>(type))
+		type = functionOf(cast<FuncSym>(type));
+	lock_guard<mutex> guard(lock);
+	PointerSym*& pointer = pointers[type];
+	if (!pointer)
+		pointer = create<PointerSym>(type);
+	return pointer;
+}
+
+ArraySym* TypeTable::arrayOf(TypeSym* type, int size)
+{
+	lock_guard<mutex> guard(lock);
+	ArraySym*& array = arrays[make_pair(type, size)];
+	if (!array)
+		array = create<ArraySym>(type, size);
+	return array;
+}
+
+ConstTypeSym* TypeTable::constOf(TypeSym* type)
+{
+	lock_guard<mutex> guard(lock);
+	ConstTypeSym*& constType = consts[type];
+	if (!constType)
+		constType = create<ConstTypeSym>(type);
+	return constType;
+}
+
+// The function type of func's signature. The first of each signature gets a FuncSym of its own
+// that shares the parameters of func, so a function body never stands for the type
+FuncSym* TypeTable::functionOf(FuncSym* func)
+{
+	SignatureT signature(canonical(func->val), vector<TypeSym*>());
+	for (int i = 0; i < func->params->size(); i++)
+		signature.second.push_back(canonical((*func->params)[i]->getType()));
+	lock_guard<mutex> guard(lock);
+	FuncSym*& function = functions[signature];
+	if (!function)
+	{
+		function = create<FuncSym>(signature.first);
+		function->params = func->params;
+	}
+	return function;
+}
+
+// The shared object of a type built from fresh ones, as a declarator is
+TypeSym* TypeTable::canonical(TypeSym* type)
+{
+	if (!type)
+		return type;
+	switch (type->kind)
+	{
+	case symPointer:
+		return pointerTo(canonical(cast<PointerSym>(type)->type));
+	case symArray:
+		return arrayOf(canonical(cast<ArraySym>(type)->type), cast<ArraySym>(type)->size);
+	case symConst:
+		return constOf(canonical(cast<ConstTypeSym>(type)->type));
+	case symFunc:
+		return functionOf(cast<FuncSym>(type));
+	}
+	return type;
+}
+
+// The type a symbol is declared with: a function keeps its own FuncSym for its parameters and body
+TypeSym* TypeTable::declared(TypeSym* type)
+{
+	FuncSym* func = dyn_cast<FuncSym>(type);
+	if (!func)
+		return canonical(type);
+	func->val = canonical(func->val);
+	return func;
+}
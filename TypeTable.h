@@ -0,0 +1,39 @@
+#ifndef TYPE_TABLE_H
+#define TYPE_TABLE_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include "BaseSymbols.h"
+#include "ActiveStack.h"
+
+using namespace std;
+
+// Derived types of one compilation, made once per distinct shape, so two types are equal exactly
+// when they are the same object. Every component of a key is itself unique. A declared function
+// keeps its own FuncSym, which holds its parameters and body; anywhere else a function type
+// stands for the first one of its signature. The Parser owns one and makes it active on its
+// threads, the worker threads of parseParallel and generateCode included
+class TypeTable : public ActiveStack<TypeTable>
+{
+private:
+	typedef pair<TypeSym*, vector<TypeSym*> > SignatureT; // value and parameter types
+	map<TypeSym*, PointerSym*> pointers;
+	map<pair<TypeSym*, int>, ArraySym*> arrays;
+	map<TypeSym*, ConstTypeSym*> consts;
+	map<SignatureT, FuncSym*> functions;
+	mutex lock;
+	TypeTable(const TypeTable&);
+	TypeTable& operator = (const TypeTable&);
+public:
+	TypeTable();
+	PointerSym* pointerTo(TypeSym* type);
+	ArraySym* arrayOf(TypeSym* type, int size);
+	ConstTypeSym* constOf(TypeSym* type);
+	FuncSym* functionOf(FuncSym* func);
+	TypeSym* canonical(TypeSym* type);
+	TypeSym* declared(TypeSym* type);
+	static TypeTable& current() { return running(); }
+};
+
+#endif
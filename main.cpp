@@ -3,6 +3,15 @@
 #include <string>
 #include "Scanner.h"
 #include "Parser.h"
+#include "Benchmark.h"
+#include "TokenDump.h"
+#include "Preprocessor.h"
+#include "Batch.h"
+#include "IR.h"
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 using namespace std;
 
@@ -14,7 +23,8 @@ int main(int argc, char* argv[])
 			cout << "C Compiler v0.3" << endl << "Design by Khoschenko Artem" << endl;
 			return 0;
 		} else if (argc == 2) {
-			Scanner scanner((char*) argv[1]);
+			Scanner scanner = strcmp((char*) argv[1], "-") == 0 ? Scanner(cin) : Scanner((char*) argv[1]);
+			ActiveScope<LiteralPool> values(scanner.literalPool());
 			while (scanner.hasNext())
 			{
 				Token* token = scanner.next();
@@ -23,17 +33,122 @@ int main(int argc, char* argv[])
 			}
 		} else {
 			string asmOut(string((char*) argv[2]) + ".asm");
-			if (strcmp((char*) argv[1], "-table") == 0)
+			Preprocessor preprocessor;
+			if (getenv("INCLUDE"))
+				preprocessor.addIncludePath(getenv("INCLUDE"));
+			// -table-parallel and -code-parallel take the threads count after the file
+			int threadsCount = argc > 3 ? atoi((char*) argv[3]) : thread::hardware_concurrency();
+			if (strcmp((char*) argv[1], "-tokens-bin") == 0)
 			{
-				Parser parser(Scanner((char*) argv[2]), CodeGenerator(asmOut));
+#ifdef _WIN32
+				_setmode(_fileno(stdout), _O_BINARY);
+#endif
+				Scanner scanner((char*) argv[2]);
+				dumpTokensBinary(scanner, cout);
+			} else if (strcmp((char*) argv[1], "-tokens-json") == 0) {
+				Scanner scanner((char*) argv[2]);
+				dumpTokensJson(scanner, cout);
+			} else if (strcmp((char*) argv[1], "-relex") == 0)
+				dumpRelexed((char*) argv[2], cout);
+			else if (strcmp((char*) argv[1], "-tokens-read") == 0) {
+				ifstream input((char*) argv[2], ios::binary);
+				TokenDumpReader reader(input);
+				ActiveScope<LiteralPool> values(reader.literalPool());
+				while (Token* token = reader.next())
+					cout << token->info(reader.line(), reader.col()) << endl << lineSeparator;
+			} else if (strcmp((char*) argv[1], "-preprocess") == 0) {
+				Scanner scanner((char*) argv[2], preprocessor);
+				ActiveScope<LiteralPool> values(scanner.literalPool());
+				while (scanner.hasNext())
+				{
+					Token* token = scanner.next();
+					if (*token != END_OF_FILE)
+						cout << token->info() << endl << lineSeparator;
+				}
+			} else if (strcmp((char*) argv[1], "-bench-keywords") == 0)
+				benchKeywordLookup(atoll((char*) argv[2]));
+			else if (strcmp((char*) argv[1], "-bench-literals") == 0)
+				benchLiterals(atoll((char*) argv[2]));
+			else if (strcmp((char*) argv[1], "-bench-lexer") == 0)
+				benchLexer(atoll((char*) argv[2]));
+			else if (strcmp((char*) argv[1], "-bench-preprocess") == 0)
+				benchPreprocessor(atoll((char*) argv[2]));
+			else if (strcmp((char*) argv[1], "-bench-parse-parallel") == 0)
+				benchParallelParse(atoll((char*) argv[2]));
+			else if (strcmp((char*) argv[1], "-bench-codegen-parallel") == 0)
+				benchParallelCodegen(atoll((char*) argv[2]));
+			else if (strcmp((char*) argv[1], "-bench-struct-copy") == 0)
+				benchStructCopy(atoll((char*) argv[2]));
+			else if (strcmp((char*) argv[1], "-batch") == 0) {
+				vector<string> inputs;
+				for (int i = 2; i < argc; i++)
+					if (argv[i][0] == '@')
+						BatchCompiler::readResponseFile(argv[i] + 1, inputs);
+					else
+						inputs.push_back(argv[i]);
+				BatchCompiler batch(inputs, getenv("INCLUDE") ? getenv("INCLUDE") : "");
+				batch.run(max(thread::hardware_concurrency(), 1u));
+				batch.report(cout);
+			} else if (strcmp((char*) argv[1], "-table") == 0)
+			{
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
 				parser.parse();
 				parser.print();
+			} else if (strcmp((char*) argv[1], "-layout") == 0)
+			{
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.parse();
+				parser.printLayout();
+			} else if (strcmp((char*) argv[1], "-layout-packed") == 0) {
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.packAnonymousStructs();
+				parser.parse();
+				parser.printLayout();
 			} else if (strcmp((char*) argv[1], "-code") == 0){
-				Parser parser(Scanner((char*) argv[2]), CodeGenerator(asmOut));
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.parse();
+				parser.generateCode();
+				parser.optimize();
+				parser.fflush();
+			} else if (strcmp((char*) argv[1], "-emit-ir") == 0) {
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.parse();
+				parser.printIR();
+			} else if (strcmp((char*) argv[1], "-verify-ir") == 0) {
+				ifstream input((char*) argv[2]);
+				IRReader reader(input);
+				while (IRFunction* ir = reader.next())
+				{
+					ir->print(cout);
+					ir->verify();
+					delete ir;
+				}
+			} else if (strcmp((char*) argv[1], "-code-ir") == 0) {
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.generateThroughIR();
 				parser.parse();
 				parser.generateCode();
+				parser.optimize();
+				parser.fflush();
+			} else if (strcmp((char*) argv[1], "-code-packed") == 0) {
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.packAnonymousStructs();
+				parser.parse();
+				parser.generateCode();
+				parser.optimize();
+				parser.fflush();
+			} else if (strcmp((char*) argv[1], "-table-parallel") == 0) {
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.parseParallel(threadsCount);
+				parser.print();
+			} else if (strcmp((char*) argv[1], "-code-parallel") == 0) {
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
+				parser.parseParallel(threadsCount);
+				parser.generateCode(threadsCount);
+				parser.optimize(threadsCount);
+				parser.fflush();
 			} else {
-				Parser parser(Scanner((char*) argv[2]), CodeGenerator(asmOut));
+				Parser parser(Scanner((char*) argv[2], preprocessor), CodeGenerator(asmOut));
 				parser.parseExpression()->print();
 			}
 		}		
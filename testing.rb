@@ -1,22 +1,29 @@
 require 'fileutils'
 programm = ARGV[0]
 place = "d:/Works/C++/Compiler/"
-dirs = ["Tests/Lexer/", "Tests/Parser/", "Tests/Semantic/", "Tests/CodeGenerate/"]
-keys = {dirs[1] => "-e", dirs[2] => "-table", dirs[3] => "-code"}
+dirs = ["Tests/Lexer/", "Tests/Parser/", "Tests/Semantic/", "Tests/CodeGenerate/", "Tests/Relex/", "Tests/Preprocessor/", "Tests/Layout/", "Tests/LayoutPacked/", "Tests/IR/", "Tests/IRVerify/"]
+keys = {dirs[1] => "-e", dirs[2] => "-table", dirs[3] => "-code", dirs[4] => "-relex", dirs[5] => "-preprocess", dirs[6] => "-layout", dirs[7] => "-layout-packed", dirs[8] => "-emit-ir", dirs[9] => "-verify-ir"}
+# CodeGenerate also goes through the IR, NNN.ir.out where its output differs, and Semantic and
+# CodeGenerate parse on 4 threads against the same NNN.out; first, so the NNN.in.asm left are
+# the serial tree generator's
+extra = {dirs[2] => ["-table-parallel"], dirs[3] => ["-code-ir", "-code-parallel"]}
+runs = dirs.flat_map { |dir| (extra[dir] || []).map { |key| [dir, key] } + [[dir, keys[dir]]] }
 count, passed = 0, 0
 tmpfiles = []
-dirs.each do |dir|
+runs.each do |dir, key|
 	i = 1
 	index = sprintf("%03d", i)
 	while File.exists?(dir + "#{index}.in")
 		count += 1
 		filename = dir + "#{index}.in"
 		res = 
-			case keys[dir]
+			case key
 				when nil then %x["#{programm}", "#{filename}"]
-				when "-e", "-table" then %x["#{programm}", "#{keys[dir]}" "#{filename}"]
-				when "-code" then 
-					%x["#{programm}", "#{keys[dir]}" "#{filename}"]
+				when "-e", "-table", "-relex", "-preprocess", "-layout", "-layout-packed", "-emit-ir", "-verify-ir" then %x["#{programm}", "#{key}" "#{filename}"]
+				when "-table-parallel" then %x["#{programm}", "#{key}" "#{filename}" "4"]
+				when "-code", "-code-ir", "-code-parallel" then 
+					if key == "-code-parallel" then %x["#{programm}", "#{key}" "#{filename}" "4"]
+					else %x["#{programm}", "#{key}" "#{filename}"] end
 					mainDir = 'd:/works/c++/compiler/'
 					path = mainDir + filename + '.asm'
 					%x['ml', "#{path}"]
@@ -31,7 +38,9 @@ dirs.each do |dir|
 			end
 		#File.open(dir + "#{index}.out", "w"){|f| f.write res}
 		output = res.split(/\n/)
-		correct = IO.readlines(dir + "#{index}.out").map(&:chomp)
+		expected = dir + "#{index}.out"
+		expected = dir + "#{index}.ir.out" if key == "-code-ir" && File.exists?(dir + "#{index}.ir.out")
+		correct = IO.readlines(expected).map(&:chomp)
 		if (output - correct).empty?
 			passed += 1
 			#puts "Test #{filename} passed"